@@ -0,0 +1,918 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <tee_client_api.h>
+
+#include <fwu_ta.h>
+#include <fwu_client.h>
+#include <fwu_hash.h>
+
+static size_t fwu_shm_round(size_t size)
+{
+	return (size + (FWU_SHM_ALLOC_UNIT - 1)) & ~(size_t)(FWU_SHM_ALLOC_UNIT - 1);
+}
+
+/* Get a registered buffer of at least size bytes, except the buffer "exclude" */
+static struct fwu_shm *fwu_shm_get(struct fwu_client *client, size_t size, const struct fwu_shm *exclude)
+{
+	struct fwu_shm *slot = NULL;
+	struct fwu_shm *victim = NULL;
+	int i;
+
+	for (i = 0; i < FWU_SHM_POOL_MAX; i++)
+	{
+		struct fwu_shm *s = &client->pool[i];
+
+		if (s == exclude)
+			continue;
+
+		if (s->allocated && (s->shm.size >= size))
+		{
+			if ((NULL == slot) || (s->shm.size < slot->shm.size))
+				slot = s;
+		}
+		else if ((NULL == victim) || (!s->allocated) ||
+				 (victim->allocated && (s->shm.size < victim->shm.size)))
+		{
+			victim = s;
+		}
+	}
+
+	if (NULL != slot)
+		return slot;
+
+	if (NULL == victim)
+		return NULL;
+
+	/* Replace an unused or too small buffer. */
+	if (victim->allocated)
+	{
+		TEEC_ReleaseSharedMemory(&victim->shm);
+		victim->allocated = 0;
+	}
+
+	(void)memset(&victim->shm, 0, sizeof(victim->shm));
+	victim->shm.size = fwu_shm_round(size);
+	victim->shm.flags = TEEC_MEM_INPUT | TEEC_MEM_OUTPUT;
+	if (TEEC_SUCCESS != TEEC_AllocateSharedMemory(&client->ctx, &victim->shm))
+		return NULL;
+
+	victim->allocated = 1;
+
+	return victim;
+}
+
+static TEEC_Result fwu_read_package(int fd, uint8_t *buf, size_t size)
+{
+	size_t done = 0;
+	ssize_t n;
+
+	if (0 != lseek(fd, 0, SEEK_SET))
+		return TEEC_ERROR_GENERIC;
+
+	while (done < size)
+	{
+		n = read(fd, buf + done, size - done);
+		if (n < 0)
+		{
+			if (EINTR == errno)
+				continue;
+			return TEEC_ERROR_GENERIC;
+		}
+		if (0 == n)
+			return TEEC_ERROR_GENERIC;
+		done += (size_t)n;
+	}
+
+	return TEEC_SUCCESS;
+}
+
+/* Load the package to the top of a pool buffer and get the work size */
+static TEEC_Result fwu_load_and_calc(struct fwu_client *client, int fd, struct fwu_shm **slot, struct fwu_job_result *result)
+{
+	TEEC_Result res;
+	TEEC_Operation op;
+	struct stat st;
+
+	(void)memset(result, 0, sizeof(*result));
+	result->origin = TEEC_ORIGIN_API;
+
+	if ((0 != fstat(fd, &st)) || (0 == st.st_size) || (UINT32_MAX < (uint64_t)st.st_size))
+	{
+		result->res = TEEC_ERROR_BAD_PARAMETERS;
+		return result->res;
+	}
+	result->input_size = (uint32_t)st.st_size;
+
+	*slot = fwu_shm_get(client, result->input_size, NULL);
+	if (NULL == *slot)
+	{
+		result->res = TEEC_ERROR_OUT_OF_MEMORY;
+		return result->res;
+	}
+
+	res = fwu_read_package(fd, (*slot)->shm.buffer, result->input_size);
+	if (TEEC_SUCCESS != res)
+	{
+		result->res = res;
+		return res;
+	}
+
+	if (client->cancel)
+	{
+		result->res = TEEC_ERROR_CANCEL;
+		return result->res;
+	}
+
+	/* get size of output FIP */
+	(void)memset(&op, 0, sizeof(op));
+	op.paramTypes = (uint32_t)TEEC_PARAM_TYPES(TEEC_MEMREF_PARTIAL_INPUT, TEEC_VALUE_OUTPUT, TEEC_NONE, TEEC_NONE);
+	op.params[0].memref.parent = &(*slot)->shm;
+	op.params[0].memref.offset = 0;
+	op.params[0].memref.size = result->input_size;
+
+	res = TEEC_InvokeCommand(&client->sess, (uint32_t)FWU_CMD_CALC_WORK_SIZE, &op, &result->origin);
+	if (TEEC_SUCCESS == res)
+	{
+		result->work_size = op.params[1].value.a;
+		result->inplace_size = op.params[1].value.b;
+		if (0 == result->work_size)
+		{
+			res = TEEC_ERROR_BAD_FORMAT;
+			result->origin = TEEC_ORIGIN_API;
+		}
+	}
+	result->res = res;
+
+	return res;
+}
+
+TEEC_Result fwu_client_open(struct fwu_client *client, uint32_t *err_origin)
+{
+	TEEC_Result res;
+	TEEC_UUID uuid = FWU_TA_UUID;
+
+	(void)memset(client, 0, sizeof(*client));
+	*err_origin = TEEC_ORIGIN_API;
+
+	/* Initialize a context connecting us to the TEE */
+	res = TEEC_InitializeContext(NULL, &client->ctx);
+	if (TEEC_SUCCESS != res)
+		return res;
+
+	/* Open a session to the "fwu ta". */
+	res = TEEC_OpenSession(&client->ctx, &client->sess, &uuid,
+						   TEEC_LOGIN_PUBLIC, NULL, NULL, err_origin);
+	if (TEEC_SUCCESS != res)
+	{
+		TEEC_FinalizeContext(&client->ctx);
+		return res;
+	}
+
+	/* Progress page updated by the TA during the firmware update */
+	client->progress.shm.size = sizeof(struct fwu_progress);
+	client->progress.shm.flags = TEEC_MEM_INPUT | TEEC_MEM_OUTPUT;
+	if (TEEC_SUCCESS == TEEC_AllocateSharedMemory(&client->ctx, &client->progress.shm))
+	{
+		client->progress.allocated = 1;
+		(void)memset(client->progress.shm.buffer, 0, sizeof(struct fwu_progress));
+	}
+
+	return TEEC_SUCCESS;
+}
+
+void fwu_client_close(struct fwu_client *client)
+{
+	int i;
+
+	for (i = 0; i < FWU_SHM_POOL_MAX; i++)
+	{
+		if (client->pool[i].allocated)
+		{
+			TEEC_ReleaseSharedMemory(&client->pool[i].shm);
+			client->pool[i].allocated = 0;
+		}
+	}
+
+	if (client->progress.allocated)
+	{
+		TEEC_ReleaseSharedMemory(&client->progress.shm);
+		client->progress.allocated = 0;
+	}
+
+	TEEC_CloseSession(&client->sess);
+	TEEC_FinalizeContext(&client->ctx);
+}
+
+TEEC_Result fwu_client_validate(struct fwu_client *client, int fd, struct fwu_job_result *result)
+{
+	struct fwu_shm *slot;
+
+	return fwu_load_and_calc(client, fd, &slot, result);
+}
+
+TEEC_Result fwu_client_update(struct fwu_client *client, int fd, struct fwu_job_result *result)
+{
+	TEEC_Result res;
+	TEEC_Operation op;
+	struct fwu_shm *slot;
+	struct fwu_shm *out;
+	uint8_t *digests = NULL;
+	size_t digest_offset[FIP_DIR_ENTRY_MAX + 1];
+	uint32_t digest_count;
+
+	if (client->progress.allocated)
+		(void)memset(client->progress.shm.buffer, 0, sizeof(struct fwu_progress));
+
+	res = fwu_load_and_calc(client, fd, &slot, result);
+	if (TEEC_SUCCESS != res)
+		return res;
+
+	/* The TA checks the package against the digests instead of hashing all of it. */
+	if (0 != fwu_hash_package(slot->shm.buffer, result->input_size, client->digest_threads,
+								&digests, digest_offset, &digest_count))
+		digests = NULL;
+
+	(void)memset(&op, 0, sizeof(op));
+	if (result->inplace_size >= result->input_size)
+	{
+		if (slot->shm.size < result->inplace_size)
+		{
+			/* Move the package to a larger buffer. */
+			out = fwu_shm_get(client, result->inplace_size, slot);
+			if (NULL == out)
+			{
+				free(digests);
+				result->res = TEEC_ERROR_OUT_OF_MEMORY;
+				result->origin = TEEC_ORIGIN_API;
+				return result->res;
+			}
+			(void)memcpy(out->shm.buffer, slot->shm.buffer, result->input_size);
+			slot = out;
+		}
+
+		/* Move the input data to the tail of the single buffer. */
+		(void)memmove((uint8_t *)slot->shm.buffer + (result->inplace_size - result->input_size),
+					  slot->shm.buffer, result->input_size);
+
+		op.paramTypes = (uint32_t)TEEC_PARAM_TYPES(TEEC_VALUE_INPUT, TEEC_MEMREF_PARTIAL_INOUT, TEEC_NONE, TEEC_NONE);
+		op.params[0].value.a = result->inplace_size - result->input_size;
+		op.params[0].value.b = result->input_size;
+		op.params[1].memref.parent = &slot->shm;
+		op.params[1].memref.offset = 0;
+		op.params[1].memref.size = result->inplace_size;
+	}
+	else
+	{
+		out = fwu_shm_get(client, result->work_size, slot);
+		if (NULL == out)
+		{
+			free(digests);
+			result->res = TEEC_ERROR_OUT_OF_MEMORY;
+			result->origin = TEEC_ORIGIN_API;
+			return result->res;
+		}
+
+		op.paramTypes = (uint32_t)TEEC_PARAM_TYPES(TEEC_MEMREF_PARTIAL_INPUT, TEEC_MEMREF_PARTIAL_INOUT, TEEC_NONE, TEEC_NONE);
+		op.params[0].memref.parent = &slot->shm;
+		op.params[0].memref.offset = 0;
+		op.params[0].memref.size = result->input_size;
+		op.params[1].memref.parent = &out->shm;
+		op.params[1].memref.offset = 0;
+		op.params[1].memref.size = result->work_size;
+	}
+
+	if (client->progress.allocated)
+	{
+		op.paramTypes |= (uint32_t)TEEC_PARAM_TYPES(TEEC_NONE, TEEC_NONE, TEEC_MEMREF_PARTIAL_INOUT, TEEC_NONE);
+		op.params[2].memref.parent = &client->progress.shm;
+		op.params[2].memref.offset = 0;
+		op.params[2].memref.size = sizeof(struct fwu_progress);
+	}
+
+	if (NULL != digests)
+	{
+		op.paramTypes |= (uint32_t)TEEC_PARAM_TYPES(TEEC_NONE, TEEC_NONE, TEEC_NONE, TEEC_MEMREF_TEMP_INPUT);
+		op.params[3].tmpref.buffer = digests;
+		op.params[3].tmpref.size = digest_offset[digest_count];
+	}
+
+	/* Keep the operation in the client so that another thread can cancel it. */
+	client->op = op;
+	client->invoking = 1;
+	if (client->cancel)
+	{
+		res = TEEC_ERROR_CANCEL;
+		result->origin = TEEC_ORIGIN_API;
+	}
+	else
+	{
+		/* Update Fip data and save to SPI Flash*/
+		res = TEEC_InvokeCommand(&client->sess, (uint32_t)FWU_CMD_FIRMWARE_UPDATE, &client->op, &result->origin);
+	}
+	client->invoking = 0;
+	result->res = res;
+	free(digests);
+
+	return res;
+}
+
+struct fwu_section_job {
+	struct fwu_client *client;
+	struct fwu_shm *in;
+	struct fwu_shm *out;
+	struct fwu_section *section;
+	const uint8_t *digests;         /* Segment digests of the sections or NULL */
+	const size_t *digest_offset;
+	uint32_t count;
+	uint32_t next;
+	pthread_mutex_t lock;
+	TEEC_Result res;
+	uint32_t origin;
+};
+
+static void fwu_section_fail(struct fwu_section_job *job, TEEC_Result res, uint32_t origin)
+{
+	(void)pthread_mutex_lock(&job->lock);
+	if (TEEC_SUCCESS == job->res)
+	{
+		job->res = res;
+		job->origin = origin;
+	}
+	job->next = job->count;
+	(void)pthread_mutex_unlock(&job->lock);
+}
+
+/* Update the sections on its own session until no section is left */
+static void *fwu_section_worker(void *arg)
+{
+	struct fwu_section_job *job = (struct fwu_section_job *)arg;
+	TEEC_Session sess;
+	TEEC_Operation op;
+	TEEC_UUID uuid = FWU_TA_UUID;
+	TEEC_Result res;
+	uint32_t origin;
+	uint32_t index;
+
+	res = TEEC_OpenSession(&job->client->ctx, &sess, &uuid, TEEC_LOGIN_PUBLIC, NULL, NULL, &origin);
+	if (TEEC_SUCCESS != res)
+	{
+		fwu_section_fail(job, res, origin);
+		return NULL;
+	}
+
+	for (;;)
+	{
+		(void)pthread_mutex_lock(&job->lock);
+		index = job->next;
+		if (index < job->count)
+			job->next++;
+		(void)pthread_mutex_unlock(&job->lock);
+
+		if (index >= job->count)
+			break;
+
+		(void)memset(&op, 0, sizeof(op));
+		op.paramTypes = (uint32_t)TEEC_PARAM_TYPES(TEEC_MEMREF_PARTIAL_INPUT, TEEC_MEMREF_PARTIAL_INOUT, TEEC_VALUE_INPUT, TEEC_NONE);
+		op.params[0].memref.parent = &job->in->shm;
+		op.params[0].memref.offset = job->section[index].in_offset;
+		op.params[0].memref.size = job->section[index].in_size;
+		op.params[1].memref.parent = &job->out->shm;
+		op.params[1].memref.offset = job->section[index].out_offset;
+		op.params[1].memref.size = job->section[index].out_size;
+		op.params[2].value.a = index;
+
+		/* The sections are the FIPs of the directory in the same order. */
+		if (NULL != job->digests)
+		{
+			op.paramTypes |= (uint32_t)TEEC_PARAM_TYPES(TEEC_NONE, TEEC_NONE, TEEC_NONE, TEEC_MEMREF_TEMP_INPUT);
+			op.params[3].tmpref.buffer = (void *)(job->digests + job->digest_offset[index]);
+			op.params[3].tmpref.size = job->digest_offset[index + 1] - job->digest_offset[index];
+		}
+
+		res = TEEC_InvokeCommand(&sess, (uint32_t)FWU_CMD_UPDATE_SECTION, &op, &origin);
+		if (TEEC_SUCCESS != res)
+		{
+			fwu_section_fail(job, res, origin);
+			break;
+		}
+	}
+
+	TEEC_CloseSession(&sess);
+
+	return NULL;
+}
+
+TEEC_Result fwu_client_update_sections(struct fwu_client *client, int fd, unsigned int jobs, struct fwu_job_result *result)
+{
+	TEEC_Result res;
+	TEEC_Operation op;
+	struct fwu_section section[FWU_SECTION_MAX];
+	struct fwu_section_job job;
+	pthread_t thread[FWU_JOBS_MAX];
+	unsigned int started = 0;
+	unsigned int i;
+	uint8_t *digests = NULL;
+	size_t digest_offset[FIP_DIR_ENTRY_MAX + 1];
+	uint32_t digest_count = 0;
+
+	if ((0 == jobs) || (FWU_JOBS_MAX < jobs))
+		jobs = FWU_JOBS_MAX;
+
+	(void)memset(&job, 0, sizeof(job));
+	job.client = client;
+	job.section = section;
+
+	res = fwu_load_and_calc(client, fd, &job.in, result);
+	if (TEEC_SUCCESS != res)
+		return res;
+
+	/* Get the layout of the sections, this session owns the section update. */
+	(void)memset(&op, 0, sizeof(op));
+	op.paramTypes = (uint32_t)TEEC_PARAM_TYPES(TEEC_MEMREF_PARTIAL_INPUT, TEEC_MEMREF_TEMP_OUTPUT, TEEC_VALUE_OUTPUT, TEEC_NONE);
+	op.params[0].memref.parent = &job.in->shm;
+	op.params[0].memref.offset = 0;
+	op.params[0].memref.size = result->input_size;
+	op.params[1].tmpref.buffer = section;
+	op.params[1].tmpref.size = sizeof(section);
+
+	res = TEEC_InvokeCommand(&client->sess, (uint32_t)FWU_CMD_GET_SECTIONS, &op, &result->origin);
+	if (TEEC_SUCCESS != res)
+	{
+		result->res = res;
+		return res;
+	}
+	job.count = op.params[2].value.a;
+	result->work_size = op.params[2].value.b;
+
+	if (0 != fwu_hash_package(job.in->shm.buffer, result->input_size, client->digest_threads,
+								&digests, digest_offset, &digest_count))
+		digests = NULL;
+	if ((NULL != digests) && (digest_count == job.count))
+	{
+		job.digests = digests;
+		job.digest_offset = digest_offset;
+	}
+
+	job.out = fwu_shm_get(client, result->work_size, job.in);
+	if (NULL == job.out)
+	{
+		free(digests);
+		result->res = TEEC_ERROR_OUT_OF_MEMORY;
+		result->origin = TEEC_ORIGIN_API;
+		return result->res;
+	}
+
+	(void)pthread_mutex_init(&job.lock, NULL);
+	if (jobs > job.count)
+		jobs = job.count;
+
+	for (i = 0; i < jobs; i++)
+	{
+		if (0 != pthread_create(&thread[started], NULL, fwu_section_worker, &job))
+			break;
+		started++;
+	}
+	if (0 == started)
+		fwu_section_fail(&job, TEEC_ERROR_OUT_OF_MEMORY, TEEC_ORIGIN_API);
+
+	for (i = 0; i < started; i++)
+		(void)pthread_join(thread[i], NULL);
+	(void)pthread_mutex_destroy(&job.lock);
+	free(digests);
+
+	if (TEEC_SUCCESS != job.res)
+	{
+		result->res = job.res;
+		result->origin = job.origin;
+		return job.res;
+	}
+
+	/* Save all sections to SPI flash with a single write. */
+	(void)memset(&op, 0, sizeof(op));
+	op.paramTypes = (uint32_t)TEEC_PARAM_TYPES(TEEC_MEMREF_PARTIAL_INPUT, TEEC_NONE, TEEC_NONE, TEEC_NONE);
+	op.params[0].memref.parent = &job.out->shm;
+	op.params[0].memref.offset = 0;
+	op.params[0].memref.size = result->work_size;
+
+	res = TEEC_InvokeCommand(&client->sess, (uint32_t)FWU_CMD_COMMIT, &op, &result->origin);
+	result->res = res;
+
+	return res;
+}
+
+TEEC_Result fwu_client_update_sliced(struct fwu_client *client, int fd, uint32_t budget_ms, struct fwu_job_result *result)
+{
+	TEEC_Result res;
+	TEEC_Operation op;
+	struct fwu_shm *slot;
+	struct fwu_shm *out;
+
+	res = fwu_load_and_calc(client, fd, &slot, result);
+	if (TEEC_SUCCESS != res)
+		return res;
+
+	out = fwu_shm_get(client, result->work_size, slot);
+	if (NULL == out)
+	{
+		result->res = TEEC_ERROR_OUT_OF_MEMORY;
+		result->origin = TEEC_ORIGIN_API;
+		return result->res;
+	}
+
+	do
+	{
+		if (client->cancel)
+		{
+			res = TEEC_ERROR_CANCEL;
+			result->origin = TEEC_ORIGIN_API;
+			break;
+		}
+
+		(void)memset(&op, 0, sizeof(op));
+		op.paramTypes = (uint32_t)TEEC_PARAM_TYPES(TEEC_MEMREF_PARTIAL_INPUT, TEEC_MEMREF_PARTIAL_INOUT, TEEC_VALUE_INOUT, TEEC_NONE);
+		op.params[0].memref.parent = &slot->shm;
+		op.params[0].memref.offset = 0;
+		op.params[0].memref.size = result->input_size;
+		op.params[1].memref.parent = &out->shm;
+		op.params[1].memref.offset = 0;
+		op.params[1].memref.size = result->work_size;
+		op.params[2].value.a = budget_ms;
+
+		res = TEEC_InvokeCommand(&client->sess, (uint32_t)FWU_CMD_UPDATE_STEP, &op, &result->origin);
+	} while ((TEEC_SUCCESS == res) && (FWU_STEP_CONTINUE == op.params[2].value.a));
+
+	result->res = res;
+
+	return res;
+}
+
+TEEC_Result fwu_client_update_batch(struct fwu_client *client, const int *fds, unsigned int count, struct fwu_job_result *result)
+{
+	TEEC_Result res;
+	TEEC_Operation op;
+	struct fwu_job_result part;
+	struct fwu_shm *slot;
+	struct fwu_shm *out;
+	uint64_t total = 0;
+	uint64_t input = 0;
+	uint32_t sizes[FWU_BATCH_MAX];
+	unsigned int i;
+
+	(void)memset(result, 0, sizeof(*result));
+	result->origin = TEEC_ORIGIN_API;
+	if ((0 == count) || (FWU_BATCH_MAX < count))
+	{
+		result->res = TEEC_ERROR_BAD_PARAMETERS;
+		return result->res;
+	}
+
+	/* The output buffer holds all packages, so size it first. */
+	for (i = 0; i < count; i++)
+	{
+		res = fwu_load_and_calc(client, fds[i], &slot, &part);
+		if (TEEC_SUCCESS != res)
+		{
+			*result = part;
+			return res;
+		}
+		sizes[i] = part.input_size;
+		input += part.input_size;
+		total += part.work_size;
+	}
+
+	if (UINT32_MAX < total)
+	{
+		result->res = TEEC_ERROR_OUT_OF_MEMORY;
+		return result->res;
+	}
+	result->input_size = (uint32_t)input;
+	result->work_size = (uint32_t)total;
+
+	out = fwu_shm_get(client, result->work_size, NULL);
+	if (NULL == out)
+	{
+		result->res = TEEC_ERROR_OUT_OF_MEMORY;
+		return result->res;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		if (client->cancel)
+		{
+			result->res = TEEC_ERROR_CANCEL;
+			return result->res;
+		}
+
+		/* The output buffer must stay registered until the commit. */
+		slot = fwu_shm_get(client, sizes[i], out);
+		if (NULL == slot)
+		{
+			result->res = TEEC_ERROR_OUT_OF_MEMORY;
+			return result->res;
+		}
+
+		res = fwu_read_package(fds[i], slot->shm.buffer, sizes[i]);
+		if (TEEC_SUCCESS != res)
+		{
+			result->res = res;
+			return res;
+		}
+
+		(void)memset(&op, 0, sizeof(op));
+		op.paramTypes = (uint32_t)TEEC_PARAM_TYPES(TEEC_MEMREF_PARTIAL_INPUT, TEEC_MEMREF_PARTIAL_INOUT, TEEC_VALUE_INOUT, TEEC_NONE);
+		op.params[0].memref.parent = &slot->shm;
+		op.params[0].memref.offset = 0;
+		op.params[0].memref.size = sizes[i];
+		op.params[1].memref.parent = &out->shm;
+		op.params[1].memref.offset = 0;
+		op.params[1].memref.size = result->work_size;
+		op.params[2].value.a = i;
+
+		res = TEEC_InvokeCommand(&client->sess, (uint32_t)FWU_CMD_BATCH_ADD, &op, &result->origin);
+		if (TEEC_SUCCESS != res)
+		{
+			result->res = res;
+			return res;
+		}
+	}
+
+	(void)memset(&op, 0, sizeof(op));
+	op.paramTypes = (uint32_t)TEEC_PARAM_TYPES(TEEC_MEMREF_PARTIAL_INPUT, TEEC_VALUE_OUTPUT, TEEC_NONE, TEEC_NONE);
+	op.params[0].memref.parent = &out->shm;
+	op.params[0].memref.offset = 0;
+	op.params[0].memref.size = result->work_size;
+
+	res = TEEC_InvokeCommand(&client->sess, (uint32_t)FWU_CMD_BATCH_COMMIT, &op, &result->origin);
+	result->res = res;
+
+	return res;
+}
+
+void fwu_client_cancel(struct fwu_client *client)
+{
+	client->cancel = 1;
+	if (client->invoking)
+		TEEC_RequestCancellation(&client->op);
+}
+
+void fwu_client_progress(const struct fwu_client *client, struct fwu_progress *progress)
+{
+	if (client->progress.allocated)
+		(void)memcpy(progress, client->progress.shm.buffer, sizeof(struct fwu_progress));
+	else
+		(void)memset(progress, 0, sizeof(struct fwu_progress));
+}
+
+TEEC_Result fwu_client_mem_stats(struct fwu_client *client, struct fwu_mem_stats *stats, uint32_t *err_origin)
+{
+	TEEC_Result res;
+	TEEC_Operation op;
+
+	(void)memset(&op, 0, sizeof(op));
+	op.paramTypes = TEEC_PARAM_TYPES(TEEC_VALUE_OUTPUT, TEEC_VALUE_OUTPUT,
+									 TEEC_NONE, TEEC_NONE);
+
+	res = TEEC_InvokeCommand(&client->sess, FWU_CMD_GET_MEM_STATS, &op, err_origin);
+	if (TEEC_SUCCESS != res)
+		return res;
+
+	stats->arena_high = op.params[0].value.a;
+	stats->arena_size = op.params[0].value.b;
+	stats->stack_usage = op.params[1].value.a;
+	stats->stack_size = op.params[1].value.b;
+
+	return TEEC_SUCCESS;
+}
+
+TEEC_Result fwu_client_storage_info(struct fwu_client *client, struct fwu_storage_info *info, uint32_t *err_origin)
+{
+	TEEC_Result res;
+	TEEC_Operation op;
+
+	(void)memset(&op, 0, sizeof(op));
+	op.paramTypes = TEEC_PARAM_TYPES(TEEC_VALUE_OUTPUT, TEEC_VALUE_OUTPUT,
+									 TEEC_VALUE_OUTPUT, TEEC_NONE);
+
+	res = TEEC_InvokeCommand(&client->sess, FWU_CMD_GET_STORAGE_INFO, &op, err_origin);
+	if (TEEC_SUCCESS != res)
+		return res;
+
+	info->type = op.params[0].value.a;
+	info->capacity = op.params[0].value.b;
+	info->block_size = op.params[1].value.a;
+	info->erase_size = op.params[1].value.b;
+	info->max_transfer = op.params[2].value.a;
+
+	return TEEC_SUCCESS;
+}
+
+TEEC_Result fwu_client_list_components(struct fwu_client *client, int fd, struct fwu_component_stats *stats,
+									   uint32_t *fip_count, struct fwu_job_result *result)
+{
+	TEEC_Result res;
+	TEEC_Operation op;
+	struct fwu_shm *slot;
+	struct stat st;
+
+	(void)memset(result, 0, sizeof(*result));
+	result->origin = TEEC_ORIGIN_API;
+
+	if ((0 != fstat(fd, &st)) || (0 == st.st_size) || (UINT32_MAX < (uint64_t)st.st_size))
+	{
+		result->res = TEEC_ERROR_BAD_PARAMETERS;
+		return result->res;
+	}
+	result->input_size = (uint32_t)st.st_size;
+
+	slot = fwu_shm_get(client, result->input_size, NULL);
+	if (NULL == slot)
+	{
+		result->res = TEEC_ERROR_OUT_OF_MEMORY;
+		return result->res;
+	}
+
+	res = fwu_read_package(fd, slot->shm.buffer, result->input_size);
+	if (TEEC_SUCCESS != res)
+	{
+		result->res = res;
+		return res;
+	}
+
+	(void)memset(&op, 0, sizeof(op));
+	op.paramTypes = (uint32_t)TEEC_PARAM_TYPES(TEEC_MEMREF_PARTIAL_INPUT, TEEC_MEMREF_TEMP_OUTPUT, TEEC_VALUE_OUTPUT, TEEC_NONE);
+	op.params[0].memref.parent = &slot->shm;
+	op.params[0].memref.offset = 0;
+	op.params[0].memref.size = result->input_size;
+	op.params[1].tmpref.buffer = stats;
+	op.params[1].tmpref.size = sizeof(struct fwu_component_stats) * FWU_COMP_MAX;
+
+	res = TEEC_InvokeCommand(&client->sess, (uint32_t)FWU_CMD_LIST_COMPONENTS, &op, &result->origin);
+	if (TEEC_SUCCESS == res)
+		*fip_count = op.params[2].value.a;
+	result->res = res;
+
+	return res;
+}
+
+TEEC_Result fwu_client_component_stats(struct fwu_client *client, struct fwu_component_stats *stats, int reset, uint32_t *err_origin)
+{
+	TEEC_Operation op;
+
+	(void)memset(&op, 0, sizeof(op));
+	op.paramTypes = TEEC_PARAM_TYPES(TEEC_MEMREF_TEMP_OUTPUT, TEEC_VALUE_INOUT,
+									 TEEC_NONE, TEEC_NONE);
+	op.params[0].tmpref.buffer = stats;
+	op.params[0].tmpref.size = sizeof(struct fwu_component_stats) * FWU_COMP_MAX;
+	op.params[1].value.a = reset ? 1 : 0;
+
+	return TEEC_InvokeCommand(&client->sess, FWU_CMD_GET_COMPONENT_STATS, &op, err_origin);
+}
+
+TEEC_Result fwu_ring_open(struct fwu_client *client, struct fwu_ring *ring, uint32_t entries, size_t data_size)
+{
+	(void)memset(ring, 0, sizeof(*ring));
+
+	if ((0 == entries) || (FWU_RING_ENTRY_MAX < entries))
+		return TEEC_ERROR_BAD_PARAMETERS;
+
+	ring->data_offset = sizeof(struct fwu_ring_header) + (entries * sizeof(struct fwu_ring_desc));
+	ring->shm.size = ring->data_offset + data_size;
+	ring->shm.flags = TEEC_MEM_INPUT | TEEC_MEM_OUTPUT;
+	if (TEEC_SUCCESS != TEEC_AllocateSharedMemory(&client->ctx, &ring->shm))
+		return TEEC_ERROR_OUT_OF_MEMORY;
+
+	ring->allocated = 1;
+	(void)memset(ring->shm.buffer, 0, ring->shm.size);
+	ring->hdr = (struct fwu_ring_header *)ring->shm.buffer;
+	ring->desc = (struct fwu_ring_desc *)(ring->hdr + 1);
+	ring->hdr->magic = FWU_RING_MAGIC;
+	ring->hdr->entries = entries;
+
+	return TEEC_SUCCESS;
+}
+
+void fwu_ring_close(struct fwu_ring *ring)
+{
+	if (ring->allocated)
+	{
+		TEEC_ReleaseSharedMemory(&ring->shm);
+		ring->allocated = 0;
+	}
+}
+
+void *fwu_ring_data(struct fwu_ring *ring, size_t size, uint32_t *offset)
+{
+	size_t pos = ring->data_offset + ((ring->data_used + 7) & ~(size_t)7);
+
+	if ((ring->shm.size < pos) || ((ring->shm.size - pos) < size))
+		return NULL;
+
+	ring->data_used = (pos - ring->data_offset) + size;
+	*offset = (uint32_t)pos;
+
+	return (uint8_t *)ring->shm.buffer + pos;
+}
+
+struct fwu_ring_desc *fwu_ring_queue(struct fwu_ring *ring, uint32_t cmd, uint32_t param_types)
+{
+	struct fwu_ring_desc *desc;
+
+	if ((ring->hdr->tail - ring->hdr->head) >= ring->hdr->entries)
+		return NULL;
+
+	desc = &ring->desc[ring->hdr->tail % ring->hdr->entries];
+	(void)memset(desc, 0, sizeof(*desc));
+	desc->cmd = cmd;
+	desc->param_types = param_types;
+	ring->hdr->tail++;
+
+	return desc;
+}
+
+TEEC_Result fwu_ring_submit(struct fwu_client *client, struct fwu_ring *ring, uint32_t *done, uint32_t *err_origin)
+{
+	TEEC_Result res;
+	TEEC_Operation op;
+
+	(void)memset(&op, 0, sizeof(op));
+	op.paramTypes = TEEC_PARAM_TYPES(TEEC_MEMREF_WHOLE, TEEC_VALUE_OUTPUT,
+									 TEEC_NONE, TEEC_NONE);
+	op.params[0].memref.parent = &ring->shm;
+
+	res = TEEC_InvokeCommand(&client->sess, FWU_CMD_RING_SUBMIT, &op, err_origin);
+	if (TEEC_SUCCESS != res)
+		return res;
+
+	*done = op.params[1].value.a;
+	if (ring->hdr->head == ring->hdr->tail)
+		ring->data_used = 0;
+
+	return TEEC_SUCCESS;
+}
+
+TEEC_Result fwu_client_slot_info(struct fwu_client *client, struct fwu_slot_info *info, uint32_t *err_origin)
+{
+	TEEC_Result res;
+	TEEC_Operation op;
+
+	(void)memset(&op, 0, sizeof(op));
+	op.paramTypes = TEEC_PARAM_TYPES(TEEC_VALUE_OUTPUT, TEEC_VALUE_OUTPUT,
+									 TEEC_NONE, TEEC_NONE);
+
+	res = TEEC_InvokeCommand(&client->sess, FWU_CMD_GET_SLOT_INFO, &op, err_origin);
+	if (TEEC_SUCCESS != res)
+		return res;
+
+	info->slot = op.params[0].value.a;
+	info->sequence = op.params[0].value.b;
+	info->length = op.params[1].value.a;
+	info->slot_size = op.params[1].value.b;
+
+	return TEEC_SUCCESS;
+}
+
+size_t fwu_client_shm_size(const struct fwu_client *client)
+{
+	size_t size = 0;
+	int i;
+
+	for (i = 0; i < FWU_SHM_POOL_MAX; i++)
+	{
+		if (client->pool[i].allocated)
+			size += client->pool[i].shm.size;
+	}
+
+	return size;
+}
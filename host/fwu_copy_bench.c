@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * fwu_copy_bench - compare the fused copy and CRC-32 of the plain FIP data
+ * (ta/fwu_copy.c) with memcpy followed by a CRC-32 pass
+ *
+ * fwu_copy_bench [ROUNDS]
+ *
+ * Build it with the same CC and CFLAGS as the TA and run it on the board,
+ * on the Cortex-A53/A57 cores that run the TA. The cycles are counted with
+ * perf_event_open(), or derived from the time with --mhz MHZ.
+ */
+
+#include <err.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+#include <fwu_copy.h>
+
+/* Sizes of the data of a ToC entry */
+static const size_t bench_sizes[] = { 4096, 65536, 1024 * 1024, 8 * 1024 * 1024 };
+
+static int bench_cycles_fd = -1;
+static double bench_mhz;
+
+static void bench_cycles_open(void)
+{
+	struct perf_event_attr attr;
+
+	(void)memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CPU_CYCLES;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	bench_cycles_fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/* CPU cycles, or the time in ns * MHz / 1000 without the cycle counter */
+static uint64_t bench_cycles(void)
+{
+	struct timespec ts;
+	uint64_t count;
+
+	if ((0 <= bench_cycles_fd) && (sizeof(count) == read(bench_cycles_fd, &count, sizeof(count))))
+		return count;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)((((double)ts.tv_sec * 1e9) + (double)ts.tv_nsec) * bench_mhz / 1000.0);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int rounds = 16;
+	uint8_t *src, *dst;
+	uint64_t start, two_pass, fused;
+	uint32_t crc_a = 0, crc_b = 0;
+	size_t size;
+	unsigned int i, r;
+
+	if ((3 <= argc) && (0 == strcmp(argv[1], "--mhz")))
+	{
+		bench_mhz = strtod(argv[2], NULL);
+		argc -= 2;
+		argv += 2;
+	}
+	if (2 <= argc)
+		rounds = (unsigned int)strtoul(argv[1], NULL, 0);
+	if (0 == rounds)
+		errx(1, "usage: fwu_copy_bench [--mhz MHZ] [ROUNDS]");
+
+	if (0.0 == bench_mhz)
+	{
+		bench_cycles_open();
+		if (0 > bench_cycles_fd)
+			errx(1, "No cycle counter, give the CPU clock with --mhz MHZ");
+	}
+
+	size = bench_sizes[(sizeof(bench_sizes) / sizeof(bench_sizes[0])) - 1];
+	src = malloc(size);
+	dst = malloc(size);
+	if ((NULL == src) || (NULL == dst))
+		errx(1, "Out of memory");
+
+	for (i = 0; i < size; i++)
+		src[i] = (uint8_t)(i * 131);
+
+	printf("%10s %16s %16s\n", "size", "memcpy+crc B/c", "fused B/c");
+	for (i = 0; i < (sizeof(bench_sizes) / sizeof(bench_sizes[0])); i++)
+	{
+		size = bench_sizes[i];
+
+		start = bench_cycles();
+		for (r = 0; r < rounds; r++)
+		{
+			(void)memcpy(dst, src, size);
+			crc_a = fwu_crc32(dst, size, 0);
+		}
+		two_pass = bench_cycles() - start;
+
+		start = bench_cycles();
+		for (r = 0; r < rounds; r++)
+			crc_b = fwu_copy_crc32(dst, src, size, 0);
+		fused = bench_cycles() - start;
+
+		if (crc_a != crc_b)
+			errx(1, "CRC mismatch 0x%08x 0x%08x", crc_a, crc_b);
+
+		printf("%10zu %16.3f %16.3f\n", size,
+			   (double)size * rounds / (double)(two_pass ? two_pass : 1),
+			   (double)size * rounds / (double)(fused ? fused : 1));
+	}
+
+	free(src);
+	free(dst);
+
+	return 0;
+}
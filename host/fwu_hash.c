@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <rzg_firmware_image_package.h>
+#include <fwu_layout.h>
+#include <sha256.h>
+#include <fwu_hash.h>
+
+/* Number of segments a thread takes at a time */
+#define FWU_HASH_BATCH 8
+
+struct fwu_hash_seg {
+	const uint8_t *data;
+	size_t size;
+};
+
+struct fwu_hash_job {
+	const struct fwu_hash_seg *seg;
+	uint8_t *list;
+	size_t count;
+	size_t next;
+	pthread_mutex_t lock;
+};
+
+/* Hash the segments until no segment is left */
+static void *fwu_hash_worker(void *arg)
+{
+	struct fwu_hash_job *job = (struct fwu_hash_job *)arg;
+	size_t first, last;
+	size_t i;
+
+	for (;;)
+	{
+		(void)pthread_mutex_lock(&job->lock);
+		first = job->next;
+		last = first + FWU_HASH_BATCH;
+		if (last > job->count)
+			last = job->count;
+		job->next = last;
+		(void)pthread_mutex_unlock(&job->lock);
+
+		if (first >= job->count)
+			break;
+
+		for (i = first; i < last; i++)
+			sha256(job->seg[i].data, job->seg[i].size, job->list + (i * SHA256_DIGEST_SIZE));
+	}
+
+	return NULL;
+}
+
+/* Hash count segments on "threads" threads, including the calling thread */
+static void fwu_hash_run(const struct fwu_hash_seg *seg, size_t count, uint8_t *list, unsigned int threads)
+{
+	struct fwu_hash_job job;
+	pthread_t thread[FWU_HASH_THREADS_MAX];
+	unsigned int started = 0;
+	unsigned int i;
+	long cpus;
+
+	if (0 == threads)
+	{
+		cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = (0 < cpus) ? (unsigned int)cpus : 1;
+	}
+	if (FWU_HASH_THREADS_MAX < threads)
+		threads = FWU_HASH_THREADS_MAX;
+	if (((count + (FWU_HASH_BATCH - 1)) / FWU_HASH_BATCH) < threads)
+		threads = (unsigned int)((count + (FWU_HASH_BATCH - 1)) / FWU_HASH_BATCH);
+
+	(void)memset(&job, 0, sizeof(job));
+	job.seg = seg;
+	job.list = list;
+	job.count = count;
+	(void)pthread_mutex_init(&job.lock, NULL);
+
+	for (i = 1; i < threads; i++)
+	{
+		if (0 != pthread_create(&thread[started], NULL, fwu_hash_worker, &job))
+			break;
+		started++;
+	}
+
+	(void)fwu_hash_worker(&job);
+
+	for (i = 0; i < started; i++)
+		(void)pthread_join(thread[i], NULL);
+	(void)pthread_mutex_destroy(&job.lock);
+}
+
+/* Add the segments of size bytes at data to seg, returns the number of segments */
+static size_t fwu_hash_split(const uint8_t *data, size_t size, uint32_t shift, struct fwu_hash_seg *seg)
+{
+	size_t seg_size = (size_t)1 << shift;
+	size_t pos;
+	size_t n = 0;
+
+	for (pos = 0; pos < size; pos += seg_size)
+	{
+		seg[n].data = data + pos;
+		seg[n].size = ((size - pos) < seg_size) ? (size - pos) : seg_size;
+		n++;
+	}
+
+	return n;
+}
+
+int fwu_hash_segments(const uint8_t *data, size_t size, uint32_t shift, uint8_t *list, unsigned int threads)
+{
+	struct fwu_hash_seg *seg;
+	size_t count;
+
+	count = fwu_layout_segments((uint32_t)size, shift);
+	if (0 == count)
+		return 0;
+
+	seg = malloc(count * sizeof(*seg));
+	if (NULL == seg)
+		return -1;
+
+	(void)fwu_hash_split(data, size, shift, seg);
+	fwu_hash_run(seg, count, list, threads);
+	free(seg);
+
+	return 0;
+}
+
+int fwu_hash_package(const uint8_t *pkg, size_t size, unsigned int threads,
+					   uint8_t **list, size_t *offset, uint32_t *count)
+{
+	fip_dir_header_t dir;
+	fip_dir_entry_t entry;
+	struct fwu_hash_seg *seg;
+	uint32_t shift;
+	size_t segs = 0;
+	uint32_t i;
+
+	*list = NULL;
+	*count = 0;
+	offset[0] = 0;
+
+	if (sizeof(dir) > size)
+		return 0;
+
+	(void)memcpy(&dir, pkg, sizeof(dir));
+	if (TOC_HEADER_NAME_DIRECTORY != dir.toc.name)
+		return 0;
+
+	if ((0 == dir.count) || (FIP_DIR_ENTRY_MAX < dir.count) ||
+		((sizeof(dir) + (dir.count * sizeof(entry))) != dir.size) || (size < dir.size))
+		return -1;
+
+	shift = fwu_layout_segment_shift(&dir);
+	if (0 == shift)
+		return 0;
+	if ((FIP_DIR_SEGMENT_SHIFT_MIN > shift) || (FIP_DIR_SEGMENT_SHIFT_MAX < shift))
+		return -1;
+
+	for (i = 0; i < dir.count; i++)
+	{
+		(void)memcpy(&entry, pkg + sizeof(dir) + (i * sizeof(entry)), sizeof(entry));
+		if ((size < entry.offset) || ((size - entry.offset) < entry.size))
+			return -1;
+		segs += fwu_layout_segments(entry.size, shift);
+		offset[i + 1] = segs * SHA256_DIGEST_SIZE;
+	}
+
+	seg = malloc(segs * sizeof(*seg));
+	*list = malloc(segs * SHA256_DIGEST_SIZE);
+	if ((NULL == seg) || (NULL == *list))
+	{
+		free(seg);
+		free(*list);
+		*list = NULL;
+		return -1;
+	}
+
+	/* All segments of the package are shared by the threads. */
+	for (i = 0; i < dir.count; i++)
+	{
+		(void)memcpy(&entry, pkg + sizeof(dir) + (i * sizeof(entry)), sizeof(entry));
+		(void)fwu_hash_split(pkg + entry.offset, entry.size, shift, seg + (offset[i] / SHA256_DIGEST_SIZE));
+	}
+
+	fwu_hash_run(seg, segs, *list, threads);
+	free(seg);
+	*count = dir.count;
+
+	return 0;
+}
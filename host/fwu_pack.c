@@ -0,0 +1,440 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * fwu_pack - build update firmware packages
+ *
+ * fwu_pack -t TYPE [-a ALIGN] [-s SERIAL] [-e] -o OUTPUT NAME=FILE...
+ *   Build a FIP of type TYPE (plain, keyring, bootfw or nsbl2u) with one
+ *   ToC entry per NAME=FILE. "NAME=" gives an empty entry. With -a, the
+ *   data of a plain FIP are aligned to ALIGN bytes in the package, the TA
+ *   copies them as they are. -e marks the last FIP of a package. FIPs are concatenated into a package
+ *   with cat.
+ *
+ * fwu_pack [-a ALIGN] [-g SEGMENT] [-c] -o OUTPUT PACKAGE
+ *   Add the package directory: a FIP of type TOC_HEADER_NAME_DIRECTORY in
+ *   front of the package that lists the offset, type, size, output size and
+ *   SHA-256 digest of every FIP, so that the TA can locate the FIPs without
+ *   walking them. With -a, the TA aligns the data of the updated keyring and
+ *   re-encrypted FIPs to ALIGN bytes of the staging area. With -g, the digest
+ *   of a FIP is the SHA-256 of the digests of its SEGMENT-byte segments,
+ *   which fwu hashes on several threads. With -c, the flags of the ToC
+ *   entries of the plain FIPs are replaced with the CRC-32 of their data,
+ *   which the TA checks while it copies the data.
+ *
+ * This tool runs on the build machine and does not need the TEE.
+ */
+
+#include <err.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <rzg_firmware_image_package.h>
+#include <fwu_layout.h>
+#include <fwu_component.h>
+#include <sha256.h>
+#include <fwu_plan.h>
+#include <fwu_hash.h>
+#include <fwu_copy.h>
+
+/* Maximum number of ToC entries of a FIP built by this tool */
+#define PACK_ENTRY_MAX 32
+
+/* Alignment of the data in a FIP without -a */
+#define PACK_DATA_ALIGN 8
+
+struct pack_type {
+	const char *name;
+	uint32_t toc_name;
+};
+
+struct pack_uuid {
+	const char *name;
+	uuid_t uuid;
+};
+
+static const struct pack_type pack_types[] = {
+	{ "plain", TOC_HEADER_NAME_PLAIN },
+	{ "keyring", TOC_HEADER_NAME_KEYRING },
+	{ "bootfw", TOC_HEADER_NAME_BOOT_FW },
+	{ "nsbl2u", TOC_HEADER_NAME_NS_BL2U },
+};
+
+#define PACK_UUID(id, name, uuid) { name, uuid },
+
+static const struct pack_uuid pack_uuids[] = {
+	FWU_COMPONENTS(PACK_UUID)
+};
+
+static uint8_t *read_file(const char *path, size_t *size)
+{
+	FILE *fp;
+	uint8_t *buf;
+	long len;
+
+	fp = fopen(path, "rb");
+	if (NULL == fp)
+		err(1, "File access error %s", path);
+
+	if ((0 != fseek(fp, 0, SEEK_END)) || ((len = ftell(fp)) < 0) || (0 != fseek(fp, 0, SEEK_SET)))
+		errx(1, "Invalid file %s", path);
+
+	buf = malloc((0 == len) ? 1 : (size_t)len);
+	if (NULL == buf)
+		errx(1, "Out of memory");
+
+	if (fread(buf, 1, (size_t)len, fp) != (size_t)len)
+		err(1, "File read error %s", path);
+
+	(void)fclose(fp);
+	*size = (size_t)len;
+
+	return buf;
+}
+
+static void write_file(const char *path, const void *buf, size_t size)
+{
+	FILE *fp;
+
+	fp = fopen(path, "wb");
+	if (NULL == fp)
+		err(1, "File access error %s", path);
+
+	if (((0 != size) && (1 != fwrite(buf, size, 1, fp))) || (0 != fclose(fp)))
+		err(1, "File write error %s", path);
+}
+
+/* Digest of a FIP of the directory, see FIP_DIR_FLAGS_SEGMENT_MASK */
+static void pack_digest(const uint8_t *fip, uint32_t size, uint32_t shift, uint8_t *digest)
+{
+	uint8_t *list;
+	size_t list_size;
+
+	if (0 == shift)
+	{
+		sha256(fip, size, digest);
+		return;
+	}
+
+	list_size = (size_t)fwu_layout_segments(size, shift) * SHA256_DIGEST_SIZE;
+	list = malloc((0 == list_size) ? 1 : list_size);
+	if ((NULL == list) || (0 != fwu_hash_segments(fip, size, shift, list, 0)))
+		errx(1, "Out of memory");
+
+	sha256(list, list_size, digest);
+	free(list);
+}
+
+/* Store the CRC-32 of the data in the ToC entries of a plain FIP, see FIP_DIR_FLAGS_CRC */
+static void pack_plain_crc(uint8_t *fip, uint32_t size, uint32_t count)
+{
+	fip_toc_entry_t toc_e;
+	uint8_t *pos;
+	uint32_t i;
+
+	for (i = 0; i < count; i++)
+	{
+		pos = fip + sizeof(fip_toc_header_t) + (i * sizeof(toc_e));
+		(void)memcpy(&toc_e, pos, sizeof(toc_e));
+		if ((size < toc_e.offset_address) || ((size - toc_e.offset_address) < toc_e.size))
+			errx(1, "Invalid ToC entry %u of a plain FIP", i);
+
+		toc_e.flags = TOC_ENTRY_FLAGS_CRC_VALID | fwu_crc32(fip + toc_e.offset_address, toc_e.size, 0);
+		(void)memcpy(pos, &toc_e, sizeof(toc_e));
+	}
+}
+
+static int pack_directory(const char *input, const char *output, uint32_t shift, uint32_t align_shift, int crc)
+{
+	fip_dir_header_t dir;
+	fip_dir_entry_t entry[FIP_DIR_ENTRY_MAX];
+	fip_toc_header_t toc;
+	struct fwu_plan_fip fip;
+	struct fwu_plan_entry fip_entry[FWU_PLAN_FIP_ENTRY_MAX];
+	uint8_t *pkg;
+	size_t size, pos, top = 0;
+	uint32_t out_pos = 0;
+	uint32_t count = 0;
+	uint32_t i;
+	FILE *fp;
+
+	pkg = read_file(input, &size);
+
+	/* Replace the directory of a package that already has one. */
+	(void)memset(&toc, 0, sizeof(toc));
+	(void)memcpy(&toc, pkg, (size < sizeof(toc)) ? size : sizeof(toc));
+	if ((sizeof(dir) <= size) && (TOC_HEADER_NAME_DIRECTORY == toc.name))
+	{
+		(void)memcpy(&dir, pkg, sizeof(dir));
+		if (size < dir.size)
+			errx(1, "Invalid package directory");
+		top = dir.size;
+	}
+
+	for (pos = top; (pos + sizeof(fip_toc_header_t)) < size; pos += fip.size)
+	{
+		if (FIP_DIR_ENTRY_MAX <= count)
+			errx(1, "The number of FIPs exceeds %d", FIP_DIR_ENTRY_MAX);
+
+		(void)memcpy(&toc, pkg + pos, sizeof(toc));
+		if (0 != fwu_plan_fip(pkg + pos, size - pos, out_pos, 1U << align_shift, &fip, fip_entry,
+							  FWU_PLAN_FIP_ENTRY_MAX))
+			errx(1, "Invalid FIP at offset 0x%zx", pos);
+
+		if (crc && (TOC_HEADER_NAME_PLAIN == toc.name))
+			pack_plain_crc(pkg + pos, fip.size, fip.entry_count);
+
+		entry[count].name = toc.name;
+		entry[count].offset = (uint32_t)(pos - top);
+		entry[count].size = fip.size;
+		entry[count].out_size = fip.out_size;
+		out_pos += fip.out_size;
+		pack_digest(pkg + pos, fip.size, shift, entry[count].digest);
+		count++;
+
+		if (0 != ((toc.flags >> 32) & FIP_FLAGS_END_OF_FILE))
+		{
+			pos += fip.size;
+			break;
+		}
+	}
+
+	if (0 == count)
+		errx(1, "The package has no FIP");
+
+	(void)memset(&dir, 0, sizeof(dir));
+	dir.toc.name = TOC_HEADER_NAME_DIRECTORY;
+	dir.toc.flags = (uint64_t)((shift << FIP_DIR_FLAGS_SEGMENT_SHIFT) | align_shift) << 32;
+	if (crc)
+		dir.toc.flags |= (uint64_t)FIP_DIR_FLAGS_CRC << 32;
+	dir.count = count;
+	dir.size = sizeof(dir) + (count * sizeof(fip_dir_entry_t));
+	for (i = 0; i < count; i++)
+		entry[i].offset += dir.size;
+
+	fp = fopen(output, "wb");
+	if (NULL == fp)
+		err(1, "File access error %s", output);
+
+	if ((1 != fwrite(&dir, sizeof(dir), 1, fp)) ||
+		(count != fwrite(entry, sizeof(fip_dir_entry_t), count, fp)) ||
+		(1 != fwrite(pkg + top, pos - top, 1, fp)) ||
+		(0 != fclose(fp)))
+		err(1, "File write error %s", output);
+
+	for (i = 0; i < count; i++)
+		printf("FIP %u: name 0x%08x offset 0x%x size %u out %u\n", i, entry[i].name,
+			   entry[i].offset, entry[i].size, entry[i].out_size);
+
+	free(pkg);
+
+	return 0;
+}
+
+static int pack_fip(uint32_t toc_name, uint32_t align, uint32_t serial, int eof,
+					char *const specs[], int count, const char *output)
+{
+	fip_toc_header_t toc;
+	fip_toc_entry_t toc_e[PACK_ENTRY_MAX + 1];
+	uint8_t *data[PACK_ENTRY_MAX];
+	size_t size[PACK_ENTRY_MAX];
+	uint32_t data_align;
+	struct fwu_plan_fip info;
+	struct fwu_plan_entry entry[FWU_PLAN_FIP_ENTRY_MAX];
+	uint64_t pos;
+	uint8_t *fip;
+	char *file;
+	int i, j;
+
+	if (PACK_ENTRY_MAX < count)
+		errx(1, "The number of ToC entries exceeds %d", PACK_ENTRY_MAX);
+
+	/* The data of a plain FIP are written as they are in the package. */
+	data_align = (PACK_DATA_ALIGN < align) ? align : PACK_DATA_ALIGN;
+
+	(void)memset(toc_e, 0, sizeof(toc_e));
+	pos = sizeof(toc) + ((uint64_t)(count + 1) * sizeof(fip_toc_entry_t));
+	for (i = 0; i < count; i++)
+	{
+		file = strchr(specs[i], '=');
+		if (NULL == file)
+			errx(1, "Invalid entry %s, expected NAME=FILE", specs[i]);
+		*file++ = '\0';
+
+		for (j = 0; j < (int)(sizeof(pack_uuids) / sizeof(pack_uuids[0])); j++)
+		{
+			if (0 == strcmp(specs[i], pack_uuids[j].name))
+				break;
+		}
+		if ((int)(sizeof(pack_uuids) / sizeof(pack_uuids[0])) == j)
+			errx(1, "Unknown entry name %s", specs[i]);
+
+		if ('\0' == *file)
+		{
+			data[i] = NULL;
+			size[i] = 0;
+		}
+		else
+			data[i] = read_file(file, &size[i]);
+
+		if ((TOC_HEADER_NAME_KEYRING == toc_name) && (INPUT_KEYRING_SIZE != size[i]))
+			errx(1, "The keyring %s must be %d bytes", file, INPUT_KEYRING_SIZE);
+
+		pos = FIP_OUT_ALIGN_UP(pos, (uint64_t)data_align);
+		toc_e[i].uuid = pack_uuids[j].uuid;
+		toc_e[i].offset_address = pos;
+		toc_e[i].size = size[i];
+		pos += size[i];
+	}
+
+	/* A plain FIP is copied as it is, so it ends at the alignment as well. */
+	pos = FIP_OUT_ALIGN_UP(pos, (uint64_t)data_align);
+	if (UINT32_MAX < pos)
+		errx(1, "The FIP is too large");
+	toc_e[count].offset_address = pos;
+
+	(void)memset(&toc, 0, sizeof(toc));
+	toc.name = toc_name;
+	toc.serial_number = serial;
+	toc.flags = (uint64_t)(eof ? FIP_FLAGS_END_OF_FILE : 0) << 32;
+
+	fip = malloc((size_t)pos);
+	if (NULL == fip)
+		errx(1, "Out of memory");
+
+	/* The gaps are filled with the erased flash value. */
+	(void)memset(fip, FIP_OUT_PAD_BYTE, (size_t)pos);
+	(void)memcpy(fip, &toc, sizeof(toc));
+	(void)memcpy(fip + sizeof(toc), toc_e, (count + 1) * sizeof(fip_toc_entry_t));
+	for (i = 0; i < count; i++)
+	{
+		if (0 != size[i])
+			(void)memcpy(fip + toc_e[i].offset_address, data[i], size[i]);
+		free(data[i]);
+	}
+
+	if (0 != fwu_plan_fip(fip, (size_t)pos, 0, 1, &info, entry, FWU_PLAN_FIP_ENTRY_MAX))
+		errx(1, "Invalid FIP");
+
+	write_file(output, fip, (size_t)pos);
+	printf("FIP: name 0x%08x size %u out %u\n", toc_name, info.size, info.out_size);
+
+	free(fip);
+
+	return 0;
+}
+
+static void usage(void)
+{
+	(void)fprintf(stderr, "usage: fwu_pack -t {plain|keyring|bootfw|nsbl2u} [-a ALIGN] [-s SERIAL] [-e] -o {output FIP} NAME=FILE...\n");
+	(void)fprintf(stderr, "       fwu_pack [-a ALIGN] [-g SEGMENT] [-c] -o {output package} {update firmware package}\n");
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *output = NULL;
+	uint32_t toc_name = 0;
+	uint32_t align = 1;
+	uint32_t align_shift = 0;
+	uint32_t serial = 0;
+	uint32_t segment = 0;
+	uint32_t seg_shift = 0;
+	int crc = 0;
+	int eof = 0;
+	int opt;
+	int i;
+
+	while ((opt = getopt(argc, argv, "t:a:s:g:ceo:")) != -1)
+	{
+		switch (opt)
+		{
+		case 't':
+			for (i = 0; i < (int)(sizeof(pack_types) / sizeof(pack_types[0])); i++)
+			{
+				if (0 == strcmp(optarg, pack_types[i].name))
+					toc_name = pack_types[i].toc_name;
+			}
+			if (0 == toc_name)
+				errx(1, "Unknown FIP type %s", optarg);
+			break;
+		case 'a':
+			align = (uint32_t)strtoul(optarg, NULL, 0);
+			if ((0 == align) || (0 != (align & (align - 1))) ||
+				((1U << FIP_DIR_ALIGN_SHIFT_MAX) < align))
+				errx(1, "ALIGN must be a power of 2 up to %u", 1U << FIP_DIR_ALIGN_SHIFT_MAX);
+			align_shift = 0;
+			while ((1U << align_shift) < align)
+				align_shift++;
+			break;
+		case 's':
+			serial = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'g':
+			segment = (uint32_t)strtoul(optarg, NULL, 0);
+			for (seg_shift = FIP_DIR_SEGMENT_SHIFT_MIN; seg_shift <= FIP_DIR_SEGMENT_SHIFT_MAX; seg_shift++)
+			{
+				if ((1U << seg_shift) == segment)
+					break;
+			}
+			if (FIP_DIR_SEGMENT_SHIFT_MAX < seg_shift)
+				errx(1, "SEGMENT must be a power of 2 from %u to %u",
+					 1U << FIP_DIR_SEGMENT_SHIFT_MIN, 1U << FIP_DIR_SEGMENT_SHIFT_MAX);
+			break;
+		case 'c':
+			crc = 1;
+			break;
+		case 'e':
+			eof = 1;
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+
+	if (NULL == output)
+		usage();
+
+	if (0 != toc_name)
+	{
+		if ((optind == argc) || (0 != segment) || crc ||
+			((1 < align) && (TOC_HEADER_NAME_PLAIN != toc_name)))
+			usage();
+		return pack_fip(toc_name, align, serial, eof, &argv[optind], argc - optind, output);
+	}
+
+	if ((optind + 1) != argc)
+		usage();
+
+	return pack_directory(argv[optind], output, seg_shift, align_shift, crc);
+}
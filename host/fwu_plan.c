@@ -0,0 +1,341 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <err.h>
+#include <string.h>
+
+#include <rzg_firmware_image_package.h>
+#include <fwu_layout.h>
+#include <fwu_board.h>
+#include <fwu_component.h>
+#include <fwu_plan.h>
+
+#define FWU_PLAN_UUID(id, name, uuid) { uuid, FWU_COMP_##id },
+
+static const struct fwu_component_slot fwu_plan_components[] = {
+	FWU_COMPONENTS(FWU_PLAN_UUID)
+};
+
+/*
+ * Costs of the profiles of fwu_board.h: tsip_call_us, tsip_kb_per_s,
+ * copy_kb_per_s, erase_us, program_us. They are typical values of the flash
+ * data sheets and of TSIP measurements, compare them with the times of
+ * fwu --components on the board.
+ */
+#define FWU_PLAN_COST_GENERIC 2000, 16384, 262144, 400000, 800
+#define FWU_PLAN_COST_HIHOPE_RZG2 1500, 24576, 524288, 520000, 340
+
+#define FWU_PLAN_BOARD(id, name, spi_offset, spi_end, page_size, erase_size, write_chunk, tsip_batch, tsip_chunk) \
+	{ name, spi_offset, spi_end, page_size, erase_size, tsip_batch, FWU_PLAN_COST_##id },
+
+static const struct fwu_board_cost fwu_plan_boards[] = {
+	FWU_BOARD_PROFILES(FWU_PLAN_BOARD)
+};
+
+static const uuid_t uuid_null;
+
+static uint32_t fwu_plan_component(const uuid_t *uuid)
+{
+	size_t i;
+
+	for (i = 0; i < (sizeof(fwu_plan_components) / sizeof(fwu_plan_components[0])); i++)
+	{
+		if (0 == memcmp(&fwu_plan_components[i].uuid, uuid, sizeof(uuid_t)))
+			return fwu_plan_components[i].id;
+	}
+
+	return FWU_COMP_UNKNOWN;
+}
+
+int fwu_plan_fip(const uint8_t *fip, size_t avail, uint32_t out_offset, uint32_t align,
+				 struct fwu_plan_fip *info, struct fwu_plan_entry *entry, uint32_t entry_max)
+{
+	fip_toc_header_t toc;
+	fip_toc_entry_t toc_e;
+	uint32_t count = 0;
+	uint32_t pos, size;
+	uint32_t i;
+
+	(void)memset(info, 0, sizeof(*info));
+	info->out_offset = out_offset;
+	info->align = align;
+
+	if (sizeof(toc) > avail)
+	{
+		warnx("Loaded data doesn't match the FIP format");
+		return -1;
+	}
+	(void)memcpy(&toc, fip, sizeof(toc));
+	info->name = toc.name;
+
+	if ((TOC_HEADER_NAME_PLAIN != toc.name) && (TOC_HEADER_NAME_KEYRING != toc.name) &&
+		(TOC_HEADER_NAME_BOOT_FW != toc.name) && (TOC_HEADER_NAME_NS_BL2U != toc.name))
+	{
+		warnx("Unknown FIP name 0x%x", toc.name);
+		return -1;
+	}
+
+	for (;;)
+	{
+		if ((avail - sizeof(toc)) < ((count + 1) * sizeof(toc_e)))
+		{
+			warnx("FIP does not have the ToC terminator entry");
+			return -1;
+		}
+		(void)memcpy(&toc_e, fip + sizeof(toc) + (count * sizeof(toc_e)), sizeof(toc_e));
+
+		if (0 == memcmp(&toc_e.uuid, &uuid_null, sizeof(uuid_t)))
+			break;
+
+		if (entry_max <= count)
+		{
+			warnx("The number of ToC entries exceeds %u", entry_max);
+			return -1;
+		}
+
+		if ((TOC_HEADER_NAME_KEYRING == toc.name) && (INPUT_KEYRING_SIZE > toc_e.size) && (0 < toc_e.size))
+		{
+			warnx("Invalid input Keyring data size");
+			return -1;
+		}
+
+		/* As the default TA build, unknown components are accepted. */
+		entry[count].component = fwu_plan_component(&toc_e.uuid);
+
+		entry[count].size = toc_e.size;
+		entry[count].out_size = fwu_layout_entry_size(toc.name, toc_e.size, 0 == count);
+		count++;
+	}
+
+	if ((0 == toc_e.offset_address) || (avail < toc_e.offset_address))
+	{
+		warnx("Invalid FIP size");
+		return -1;
+	}
+	info->size = (uint32_t)toc_e.offset_address;
+	info->entry_count = count;
+
+	if (TOC_HEADER_NAME_PLAIN == toc.name)
+	{
+		info->out_size = info->size;
+		return 0;
+	}
+
+	/*
+	 * The data follow the ToC, as fip_reenc_out_size() of the TA lays them
+	 * out. The TA aligns the offsets in the staging area, which is aligned
+	 * to align, so the offsets in the output of the package are aligned.
+	 */
+	pos = out_offset + sizeof(toc) + ((count + 1) * sizeof(toc_e));
+	for (i = 0; i < count; i++)
+	{
+		size = entry[i].out_size;
+		if (0 != size)
+			pos = FIP_OUT_ALIGN_UP(pos, align) + size;
+	}
+	info->out_size = FIP_OUT_ALIGN_UP(pos, align) - out_offset;
+
+	return 0;
+}
+
+int fwu_plan_package(const uint8_t *pkg, size_t size, struct fwu_plan *plan)
+{
+	fip_dir_header_t dir;
+	fip_dir_entry_t dir_e;
+	fip_toc_header_t toc;
+	struct fwu_plan_fip *fip;
+	size_t pos = 0;
+	uint32_t headroom = 0;
+	uint32_t out_end;
+
+	(void)memset(plan, 0, sizeof(*plan));
+	plan->align = 1;
+
+	if ((0 == size) || (UINT32_MAX < size))
+	{
+		warnx("Invalid package size");
+		return -1;
+	}
+
+	/* The directory FIP is not written, the FIPs are checked against it. */
+	(void)memset(&dir, 0, sizeof(dir));
+	(void)memcpy(&dir, pkg, (size < sizeof(dir)) ? size : sizeof(dir));
+	if ((sizeof(fip_toc_header_t) <= size) && (TOC_HEADER_NAME_DIRECTORY == dir.toc.name))
+	{
+		if ((sizeof(dir) > size) || (0 == dir.count) || (FIP_DIR_ENTRY_MAX < dir.count) ||
+			((sizeof(dir) + (dir.count * sizeof(fip_dir_entry_t))) != dir.size) || (size < dir.size))
+		{
+			warnx("Invalid package directory");
+			return -1;
+		}
+		if (FIP_DIR_ALIGN_SHIFT_MAX < fwu_layout_align_shift(&dir))
+		{
+			warnx("Invalid FIP data alignment");
+			return -1;
+		}
+		plan->has_directory = 1;
+		plan->align = 1U << fwu_layout_align_shift(&dir);
+		pos = dir.size;
+	}
+
+	do
+	{
+		if ((pos + sizeof(fip_toc_header_t)) >= (size - 1))
+		{
+			warnx("Loaded data doesn't match the FIP format");
+			return -1;
+		}
+
+		if (FIP_DIR_ENTRY_MAX <= plan->fip_count)
+		{
+			warnx("The number of FIPs exceeds %d", FIP_DIR_ENTRY_MAX);
+			return -1;
+		}
+
+		fip = &plan->fip[plan->fip_count];
+		if (0 != fwu_plan_fip(pkg + pos, size - pos, plan->work_size, plan->align, fip,
+							  &plan->entry[plan->entry_count], FWU_PLAN_ENTRY_MAX - plan->entry_count))
+		{
+			warnx("Invalid FIP at offset 0x%zx", pos);
+			return -1;
+		}
+		fip->offset = (uint32_t)pos;
+		fip->first_entry = plan->entry_count;
+
+		if (plan->has_directory)
+		{
+			(void)memcpy(&dir_e, pkg + sizeof(dir) + (plan->fip_count * sizeof(dir_e)), sizeof(dir_e));
+			if ((dir.count <= plan->fip_count) || (dir_e.offset != fip->offset) || (dir_e.name != fip->name) ||
+				(dir_e.size != fip->size) || (dir_e.out_size != fip->out_size))
+			{
+				warnx("The package directory does not match the FIP at offset 0x%zx", pos);
+				return -1;
+			}
+		}
+
+		/* In-place layout, as fwu_scan_package() of the TA. */
+		if (TOC_HEADER_NAME_PLAIN == fip->name)
+			out_end = plan->work_size;
+		else
+			out_end = plan->work_size + fip->out_size;
+
+		if ((out_end > pos) && ((out_end - pos) > headroom))
+			headroom = out_end - (uint32_t)pos;
+
+		plan->work_size += fip->out_size;
+		plan->entry_count += fip->entry_count;
+		plan->fip_count++;
+		pos += fip->size;
+
+		(void)memcpy(&toc, pkg + fip->offset, sizeof(toc));
+		if (0 != ((toc.flags >> 32) & FIP_FLAGS_END_OF_FILE))
+			break;
+
+		if (plan->has_directory && (dir.count == plan->fip_count))
+			break;
+
+	} while (pos < (size - 1));
+
+	if (plan->work_size > (headroom + size))
+		headroom = plan->work_size - (uint32_t)size;
+
+	headroom = (headroom + (INPLACE_ALIGN - 1)) & ~(uint32_t)(INPLACE_ALIGN - 1);
+	plan->single_size = headroom + (uint32_t)size;
+
+	return 0;
+}
+
+const struct fwu_board_cost *fwu_plan_board(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < (sizeof(fwu_plan_boards) / sizeof(fwu_plan_boards[0])); i++)
+	{
+		if (0 == strcmp(fwu_plan_boards[i].name, name))
+			return &fwu_plan_boards[i];
+	}
+
+	return NULL;
+}
+
+const struct fwu_board_cost *fwu_plan_board_at(unsigned int index)
+{
+	if ((sizeof(fwu_plan_boards) / sizeof(fwu_plan_boards[0])) <= index)
+		return NULL;
+
+	return &fwu_plan_boards[index];
+}
+
+void fwu_plan_estimate(const struct fwu_plan *plan, const struct fwu_board_cost *board,
+					   struct fwu_plan_estimate *est)
+{
+	const struct fwu_plan_fip *fip;
+	uint64_t reenc_bytes = 0;
+	uint64_t copy_bytes = 0;
+	uint64_t pages;
+	uint32_t i, j;
+
+	(void)memset(est, 0, sizeof(*est));
+
+	for (i = 0; i < plan->fip_count; i++)
+	{
+		fip = &plan->fip[i];
+		switch (fip->name)
+		{
+		case TOC_HEADER_NAME_PLAIN:
+			copy_bytes += fip->size;
+			break;
+		case TOC_HEADER_NAME_KEYRING:
+			/* One TSIP call per keyring */
+			est->tsip_calls += fip->entry_count;
+			reenc_bytes += (uint64_t)fip->entry_count * INPUT_KEYRING_SIZE;
+			break;
+		default:
+			/* The entries are re-encrypted in batches of tsip_batch, empty ones included. */
+			est->tsip_calls += (fip->entry_count + board->tsip_batch - 1) / board->tsip_batch;
+			for (j = 0; j < fip->entry_count; j++)
+				reenc_bytes += plan->entry[fip->first_entry + j].size;
+			break;
+		}
+	}
+
+	est->footprint = FIP_OUT_ALIGN_UP(plan->work_size, board->erase_size);
+	est->sectors = est->footprint / board->erase_size;
+	if (CFG_FWU_AB)
+		est->capacity = FWU_SLOT_SIZE_OF(board->spi_offset, board->spi_end, board->erase_size);
+	else
+		est->capacity = board->spi_end - board->spi_offset;
+	est->fits = (est->footprint <= est->capacity);
+	pages = (plan->work_size + board->page_size - 1) / board->page_size;
+
+	est->reenc_ms = (uint32_t)((((uint64_t)est->tsip_calls * board->tsip_call_us) / 1000) +
+							   ((reenc_bytes * 1000) / ((uint64_t)board->tsip_kb_per_s * 1024)));
+	est->copy_ms = (uint32_t)((copy_bytes * 1000) / ((uint64_t)board->copy_kb_per_s * 1024));
+	est->erase_ms = (uint32_t)(((uint64_t)est->sectors * board->erase_us) / 1000);
+	est->program_ms = (uint32_t)((pages * board->program_us) / 1000);
+	est->total_ms = est->reenc_ms + est->copy_ms + est->erase_ms + est->program_ms;
+}
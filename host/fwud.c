@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+
+#include <err.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <tee_client_api.h>
+
+#include <fwu_ta.h>
+#include <fwu_client.h>
+#include <fwud_ipc.h>
+
+static volatile sig_atomic_t fwud_stop;
+
+static void fwud_signal(int sig)
+{
+	(void)sig;
+	fwud_stop = 1;
+}
+
+static void usage(void)
+{
+	(void)fprintf(stderr, "usage: fwud [-f] [-s socket]\n");
+	exit(1);
+}
+
+static int fwud_listen(const char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		err(1, "socket");
+
+	(void)memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path))
+		errx(1, "Socket path too long %s", path);
+	(void)strcpy(addr.sun_path, path);
+
+	(void)unlink(path);
+	if (0 != bind(fd, (struct sockaddr *)&addr, sizeof(addr)))
+		err(1, "bind %s", path);
+	/* Only root may update the firmware. */
+	if (0 != chmod(path, 0600))
+		err(1, "chmod %s", path);
+	if (0 != listen(fd, 4))
+		err(1, "listen %s", path);
+
+	return fd;
+}
+
+/* Receive a request and the attached package file descriptor */
+static int fwud_recv(int conn, struct fwud_request *req, int *pkg_fd)
+{
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	union {
+		char buf[CMSG_SPACE(sizeof(int))];
+		struct cmsghdr align;
+	} ctrl;
+	ssize_t n;
+
+	*pkg_fd = -1;
+	(void)memset(&msg, 0, sizeof(msg));
+	iov.iov_base = req;
+	iov.iov_len = sizeof(*req);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = ctrl.buf;
+	msg.msg_controllen = sizeof(ctrl.buf);
+
+	n = recvmsg(conn, &msg, MSG_CMSG_CLOEXEC);
+	if (n != (ssize_t)sizeof(*req))
+		return -1;
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if ((NULL != cmsg) && (SOL_SOCKET == cmsg->cmsg_level) && (SCM_RIGHTS == cmsg->cmsg_type) &&
+		(CMSG_LEN(sizeof(int)) == cmsg->cmsg_len))
+		(void)memcpy(pkg_fd, CMSG_DATA(cmsg), sizeof(int));
+
+	if (FWUD_MAGIC != req->magic)
+		return -1;
+
+	return 0;
+}
+
+static void fwud_job(struct fwu_client *client, int conn, struct fwud_stats *stats, time_t start)
+{
+	struct fwud_request req;
+	struct fwud_response rsp;
+	int pkg_fd;
+
+	if (0 != fwud_recv(conn, &req, &pkg_fd))
+	{
+		if (0 <= pkg_fd)
+			(void)close(pkg_fd);
+		return;
+	}
+
+	(void)memset(&rsp, 0, sizeof(rsp));
+	rsp.magic = FWUD_MAGIC;
+	rsp.job = req.job;
+	rsp.result.res = TEEC_ERROR_BAD_PARAMETERS;
+	rsp.result.origin = TEEC_ORIGIN_API;
+
+	switch (req.job)
+	{
+	case FWUD_JOB_UPDATE:
+		if (0 <= pkg_fd)
+			(void)fwu_client_update(client, pkg_fd, &rsp.result);
+		break;
+	case FWUD_JOB_VALIDATE:
+		if (0 <= pkg_fd)
+			(void)fwu_client_validate(client, pkg_fd, &rsp.result);
+		break;
+	case FWUD_JOB_STATS:
+		rsp.result.res = TEEC_SUCCESS;
+		break;
+	default:
+		break;
+	}
+
+	if (0 <= pkg_fd)
+		(void)close(pkg_fd);
+
+	if (FWUD_JOB_UPDATE == req.job)
+		fwu_client_progress(client, &rsp.progress);
+
+	if (FWUD_JOB_STATS != req.job)
+	{
+		stats->jobs++;
+		stats->bytes += rsp.result.input_size;
+		stats->last_res = rsp.result.res;
+		if (TEEC_SUCCESS != rsp.result.res)
+			stats->failures++;
+	}
+	stats->shm_size = fwu_client_shm_size(client);
+	stats->uptime = (uint32_t)(time(NULL) - start);
+	rsp.stats = *stats;
+
+	(void)send(conn, &rsp, sizeof(rsp), MSG_NOSIGNAL);
+}
+
+int main(int argc, char *argv[])
+{
+	TEEC_Result res;
+	struct fwu_client client;
+	struct fwud_stats stats;
+	struct sigaction sa;
+	const char *path = FWUD_SOCKET_PATH;
+	uint32_t err_origin;
+	int foreground = 0;
+	int listen_fd;
+	int conn;
+	int opt;
+	time_t start;
+
+	while ((opt = getopt(argc, argv, "fs:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'f':
+			foreground = 1;
+			break;
+		case 's':
+			path = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc)
+		usage();
+
+	/* Keep the context and the session to the "fwu ta" for all jobs. */
+	res = fwu_client_open(&client, &err_origin);
+	if (res != TEEC_SUCCESS)
+		errx(1, "fwu session open failed with code 0x%x origin 0x%x", res, err_origin);
+
+	listen_fd = fwud_listen(path);
+
+	if ((0 == foreground) && (0 != daemon(0, 0)))
+		err(1, "daemon");
+
+	(void)memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = fwud_signal;
+	(void)sigaction(SIGTERM, &sa, NULL);
+	(void)sigaction(SIGINT, &sa, NULL);
+	sa.sa_handler = SIG_IGN;
+	(void)sigaction(SIGPIPE, &sa, NULL);
+
+	(void)memset(&stats, 0, sizeof(stats));
+	start = time(NULL);
+
+	while (0 == fwud_stop)
+	{
+		conn = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+		if (conn < 0)
+		{
+			if (EINTR == errno)
+				continue;
+			warn("accept");
+			continue;
+		}
+
+		fwud_job(&client, conn, &stats, start);
+		(void)close(conn);
+
+		/* Reopen the session if the TA has been unloaded by a panic. */
+		if (TEEC_ERROR_TARGET_DEAD == stats.last_res)
+		{
+			fwu_client_close(&client);
+			res = fwu_client_open(&client, &err_origin);
+			if (res != TEEC_SUCCESS)
+				errx(1, "fwu session open failed with code 0x%x origin 0x%x", res, err_origin);
+			stats.last_res = TEEC_SUCCESS;
+		}
+	}
+
+	(void)close(listen_fd);
+	(void)unlink(path);
+	fwu_client_close(&client);
+
+	return 0;
+}
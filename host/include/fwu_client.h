@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef FWU_CLIENT_H
+#define FWU_CLIENT_H
+
+#include <stdint.h>
+#include <tee_client_api.h>
+
+#include <fwu_ta.h>
+#include <fwu_component.h>
+
+/* Number of shared memory buffers kept registered between jobs */
+#define FWU_SHM_POOL_MAX 2
+
+/* Maximum number of sessions for the section update */
+#define FWU_JOBS_MAX 8
+
+/* Maximum number of packages in a batch update */
+#define FWU_BATCH_MAX 8
+
+/* Granularity of the shared memory buffer allocation */
+#define FWU_SHM_ALLOC_UNIT (1024 * 1024)
+
+struct fwu_shm {
+	TEEC_SharedMemory shm;
+	int allocated;
+};
+
+struct fwu_client {
+	TEEC_Context ctx;
+	TEEC_Session sess;
+	struct fwu_shm pool[FWU_SHM_POOL_MAX];
+	struct fwu_shm progress;
+	TEEC_Operation op;
+	volatile int invoking;
+	volatile int cancel;
+	unsigned int digest_threads;    /* Threads hashing a segmented package, 0: one per CPU */
+};
+
+/*
+ * Command ring: descriptors queued by fwu_ring_queue() are executed by the
+ * TA with a single invoke of fwu_ring_submit()
+ */
+struct fwu_ring {
+	TEEC_SharedMemory shm;
+	struct fwu_ring_header *hdr;
+	struct fwu_ring_desc *desc;
+	size_t data_offset;     /* Data area of the memref parameters */
+	size_t data_used;
+	int allocated;
+};
+
+struct fwu_job_result {
+	uint32_t res;
+	uint32_t origin;
+	uint32_t input_size;
+	uint32_t work_size;
+	uint32_t inplace_size;
+};
+
+struct fwu_mem_stats {
+	uint32_t arena_high;
+	uint32_t arena_size;
+	uint32_t stack_usage;
+	uint32_t stack_size;
+};
+
+struct fwu_storage_info {
+	uint32_t type;
+	uint32_t capacity;
+	uint32_t block_size;
+	uint32_t erase_size;
+	uint32_t max_transfer;
+};
+
+struct fwu_slot_info {
+	uint32_t slot;          /* Active slot, FWU_SLOT_NONE if none */
+	uint32_t sequence;
+	uint32_t length;
+	uint32_t slot_size;
+};
+
+/* Initialize the TEE context and open a session to the fwu ta */
+TEEC_Result fwu_client_open(struct fwu_client *client, uint32_t *err_origin);
+
+/* Close the session, release the shared memory pool and the context */
+void fwu_client_close(struct fwu_client *client);
+
+/* Check the package in fd and calculate the work size */
+TEEC_Result fwu_client_validate(struct fwu_client *client, int fd, struct fwu_job_result *result);
+
+/* Update the firmware with the package in fd and save it to SPI flash */
+TEEC_Result fwu_client_update(struct fwu_client *client, int fd, struct fwu_job_result *result);
+
+/*
+ * Update the firmware section by section, on "jobs" sessions in parallel,
+ * and save all sections to SPI flash at once
+ */
+TEEC_Result fwu_client_update_sections(struct fwu_client *client, int fd, unsigned int jobs, struct fwu_job_result *result);
+
+/*
+ * Update the firmware in calls of at most budget_ms to the TA, so that the
+ * secure world returns to Linux regularly during the update
+ */
+TEEC_Result fwu_client_update_sliced(struct fwu_client *client, int fd, uint32_t budget_ms, struct fwu_job_result *result);
+
+/*
+ * Update the firmware with the packages in fds as one batch and save the
+ * combined output to the storage with a single write
+ */
+TEEC_Result fwu_client_update_batch(struct fwu_client *client, const int *fds, unsigned int count, struct fwu_job_result *result);
+
+/* Request the cancellation of the job running on another thread */
+void fwu_client_cancel(struct fwu_client *client);
+
+/* Get the progress of the last or running update job */
+void fwu_client_progress(const struct fwu_client *client, struct fwu_progress *progress);
+
+/* Get the memory usage of the fwu ta */
+TEEC_Result fwu_client_mem_stats(struct fwu_client *client, struct fwu_mem_stats *stats, uint32_t *err_origin);
+
+/* Get the storage backend of the update package */
+TEEC_Result fwu_client_storage_info(struct fwu_client *client, struct fwu_storage_info *info, uint32_t *err_origin);
+
+/*
+ * Get the components of the ToC entries of the package in fd without
+ * updating it, stats has FWU_COMP_MAX entries indexed by component ID
+ */
+TEEC_Result fwu_client_list_components(struct fwu_client *client, int fd, struct fwu_component_stats *stats,
+									   uint32_t *fip_count, struct fwu_job_result *result);
+
+/* Get the update statistics per component (FWU_COMP_MAX entries), optionally reset them */
+TEEC_Result fwu_client_component_stats(struct fwu_client *client, struct fwu_component_stats *stats, int reset, uint32_t *err_origin);
+
+/* Allocate a ring of "entries" descriptors and data_size bytes of memref data */
+TEEC_Result fwu_ring_open(struct fwu_client *client, struct fwu_ring *ring, uint32_t entries, size_t data_size);
+
+/* Release the ring */
+void fwu_ring_close(struct fwu_ring *ring);
+
+/*
+ * Reserve size bytes of the data area for a memref parameter, *offset is
+ * the value of param[].a. Returns NULL if the data area is full.
+ */
+void *fwu_ring_data(struct fwu_ring *ring, size_t size, uint32_t *offset);
+
+/* Queue a command, returns its descriptor or NULL if the ring is full */
+struct fwu_ring_desc *fwu_ring_queue(struct fwu_ring *ring, uint32_t cmd, uint32_t param_types);
+
+/*
+ * Execute the queued commands with one invoke, the results are in the
+ * descriptors. The data area is reused once all commands are executed.
+ */
+TEEC_Result fwu_ring_submit(struct fwu_client *client, struct fwu_ring *ring, uint32_t *done, uint32_t *err_origin);
+
+/* Get the active A/B staging slot, TEEC_ERROR_NOT_SUPPORTED without the slots */
+TEEC_Result fwu_client_slot_info(struct fwu_client *client, struct fwu_slot_info *info, uint32_t *err_origin);
+
+/* Total size of the registered shared memory buffers */
+size_t fwu_client_shm_size(const struct fwu_client *client);
+
+#endif /* FWU_CLIENT_H */
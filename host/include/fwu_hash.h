@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef FWU_HASH_H
+#define FWU_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <rzg_firmware_image_package.h>
+
+/*
+ * Segment digests of a package with a segmented directory, computed on
+ * several threads and passed to the TA with the package, so that the TA
+ * only spot-checks the segments instead of hashing the whole package.
+ */
+
+/* Maximum number of hashing threads */
+#define FWU_HASH_THREADS_MAX 16
+
+/*
+ * Hash the segments of size bytes at data into list on "threads" threads
+ * (0: one per CPU). Returns -1 if out of memory.
+ */
+int fwu_hash_segments(const uint8_t *data, size_t size, uint32_t shift, uint8_t *list, unsigned int threads);
+
+/*
+ * Get the segment digests of all FIPs of the package, in the order of the
+ * directory. offset[i] is the offset of the digests of FIP i in the list
+ * and offset[*count] the size of the list (FIP_DIR_ENTRY_MAX + 1 entries).
+ * *list is NULL if the package has no segmented directory, otherwise free()
+ * it after use. Returns -1 if the directory does not match the package.
+ */
+int fwu_hash_package(const uint8_t *pkg, size_t size, unsigned int threads,
+					   uint8_t **list, size_t *offset, uint32_t *count);
+
+#endif /* FWU_HASH_H */
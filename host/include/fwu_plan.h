@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef FWU_PLAN_H
+#define FWU_PLAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <rzg_firmware_image_package.h>
+
+/*
+ * Offline layout of an update package, computed in the normal world with the
+ * size rules of the TA (fwu_layout.h), without a TEE.
+ */
+
+/* Maximum number of ToC entries of a FIP */
+#define FWU_PLAN_FIP_ENTRY_MAX 64
+
+/* Maximum number of ToC entries of a package */
+#define FWU_PLAN_ENTRY_MAX 512
+
+struct fwu_plan_entry {
+	uint32_t component;     /* FWU_COMP_xxx */
+	uint32_t out_size;      /* Without the alignment padding */
+	uint64_t size;
+};
+
+struct fwu_plan_fip {
+	uint32_t name;          /* TOC_HEADER_NAME_xxx */
+	uint32_t offset;        /* Offset in the package */
+	uint32_t size;
+	uint32_t out_offset;    /* Offset in the work buffer */
+	uint32_t out_size;
+	uint32_t align;
+	uint32_t first_entry;   /* Index in fwu_plan.entry */
+	uint32_t entry_count;
+};
+
+struct fwu_plan {
+	struct fwu_plan_fip fip[FIP_DIR_ENTRY_MAX];
+	uint32_t fip_count;
+	struct fwu_plan_entry entry[FWU_PLAN_ENTRY_MAX];
+	uint32_t entry_count;
+	int has_directory;
+	uint32_t align;         /* Alignment of the updated FIP data, from the directory */
+	uint32_t work_size;     /* As FWU_CMD_CALC_WORK_SIZE */
+	uint32_t single_size;   /* Single buffer size of the in-place update */
+};
+
+/*
+ * Board geometry and costs of the update, the geometry is taken from
+ * FWU_BOARD_PROFILES of fwu_board.h in this order
+ */
+struct fwu_board_cost {
+	const char *name;
+	uint32_t spi_offset;        /* Staging area in SPI flash */
+	uint32_t spi_end;
+	uint32_t page_size;
+	uint32_t erase_size;
+	uint32_t tsip_batch;        /* Data re-encrypted by one TSIP call */
+	uint32_t tsip_call_us;      /* Fixed cost of a TSIP call */
+	uint32_t tsip_kb_per_s;     /* Re-encryption throughput */
+	uint32_t copy_kb_per_s;     /* Copy throughput of the plain FIPs */
+	uint32_t erase_us;          /* Erase of one sector */
+	uint32_t program_us;        /* Program of one page */
+};
+
+/* A/B staging slots of the TA (FWU_AB=y), the package must fit in a slot */
+#ifndef CFG_FWU_AB
+#define CFG_FWU_AB 0
+#endif
+
+struct fwu_plan_estimate {
+	uint32_t capacity;          /* Staging area or A/B slot size */
+	uint32_t footprint;         /* Erased size in the staging area */
+	uint32_t sectors;
+	int fits;
+	uint32_t tsip_calls;
+	uint32_t reenc_ms;
+	uint32_t copy_ms;
+	uint32_t erase_ms;
+	uint32_t program_ms;
+	uint32_t total_ms;
+};
+
+/*
+ * Get the layout of the FIP at fip that is written at out_offset of the
+ * output with the data aligned to align, entry receives at most entry_max
+ * ToC entries. Returns 0, or -1 with a warning if the FIP is invalid.
+ */
+int fwu_plan_fip(const uint8_t *fip, size_t avail, uint32_t out_offset, uint32_t align,
+				 struct fwu_plan_fip *info, struct fwu_plan_entry *entry, uint32_t entry_max);
+
+/* Get the layout of a package, returns 0, or -1 with a warning */
+int fwu_plan_package(const uint8_t *pkg, size_t size, struct fwu_plan *plan);
+
+/* Get the board profile by name, NULL if unknown */
+const struct fwu_board_cost *fwu_plan_board(const char *name);
+
+/* Get the board profile by index, NULL after the last one */
+const struct fwu_board_cost *fwu_plan_board_at(unsigned int index);
+
+/* Estimate the SPI footprint and the update time of a package on a board */
+void fwu_plan_estimate(const struct fwu_plan *plan, const struct fwu_board_cost *board,
+					   struct fwu_plan_estimate *est);
+
+#endif /* FWU_PLAN_H */
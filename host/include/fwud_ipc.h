@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef FWUD_IPC_H
+#define FWUD_IPC_H
+
+#include <stdint.h>
+
+#include <fwu_client.h>
+
+/* Unix socket of the fwu daemon */
+#define FWUD_SOCKET_PATH "/var/run/fwud.sock"
+
+#define FWUD_MAGIC (0x46575544U)
+
+/*
+ * Jobs accepted by the fwu daemon
+ * FWUD_JOB_UPDATE   - update firmware with the package (file descriptor attached)
+ * FWUD_JOB_VALIDATE - check the package and calculate the work size (file descriptor attached)
+ * FWUD_JOB_STATS    - get the statistics of the daemon
+ */
+#define FWUD_JOB_UPDATE 1
+#define FWUD_JOB_VALIDATE 2
+#define FWUD_JOB_STATS 3
+
+struct fwud_request {
+	uint32_t magic;
+	uint32_t job;
+};
+
+struct fwud_stats {
+	uint64_t jobs;
+	uint64_t failures;
+	uint64_t bytes;
+	uint64_t shm_size;
+	uint32_t uptime;
+	uint32_t last_res;
+};
+
+struct fwud_response {
+	uint32_t magic;
+	uint32_t job;
+	struct fwu_job_result result;
+	struct fwu_progress progress;
+	struct fwud_stats stats;
+};
+
+#endif /* FWUD_IPC_H */
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef LIBFWU_H
+#define LIBFWU_H
+
+#include <stdint.h>
+
+#include <fwu_ta.h>
+#include <fwu_client.h>
+
+/* Status of a firmware update operation */
+enum fwu_status {
+	FWU_OK = 0,
+	FWU_ERR_PARAM,      /* Invalid argument */
+	FWU_ERR_IO,         /* The package can not be read */
+	FWU_ERR_NOMEM,      /* Out of memory */
+	FWU_ERR_TEE,        /* TEE or TA session error */
+	FWU_ERR_PACKAGE,    /* The package is rejected by the TA */
+	FWU_ERR_FLASH,      /* SPI flash write error */
+	FWU_ERR_CANCELLED,  /* The operation has been cancelled */
+};
+
+struct fwu_error {
+	enum fwu_status status;
+	uint32_t res;       /* TEEC_Result */
+	uint32_t origin;    /* TEEC_ORIGIN_xxx */
+	uint32_t stage;     /* FWU_STAGE_xxx at the time of the error */
+};
+
+enum fwu_event_type {
+	FWU_EVENT_PROGRESS,
+	FWU_EVENT_DONE,
+};
+
+struct fwu_event {
+	enum fwu_event_type type;
+	struct fwu_progress progress;
+	struct fwu_error error;     /* FWU_EVENT_DONE only */
+};
+
+typedef void (*fwu_event_cb)(const struct fwu_event *event, void *arg);
+
+struct fwu_op;
+
+/*
+ * Start the firmware update with the package in fd on a worker thread.
+ * The client must not be used by anything else until fwu_op_wait() returns.
+ */
+enum fwu_status fwu_update_async(struct fwu_client *client, int fd, fwu_event_cb cb, void *arg, struct fwu_op **op);
+
+/* File descriptor which becomes readable when the progress changes and when the operation finishes */
+int fwu_op_fd(const struct fwu_op *op);
+
+/* Deliver the pending events to the callback, returns 1 once the operation finished */
+int fwu_op_poll(struct fwu_op *op);
+
+/* Request the cancellation, the operation finishes with FWU_ERR_CANCELLED */
+void fwu_op_cancel(struct fwu_op *op);
+
+/* Wait for the end of the operation and release it */
+enum fwu_status fwu_op_wait(struct fwu_op *op, struct fwu_error *error);
+
+/* Classify the result of a job */
+void fwu_error_from_result(const struct fwu_job_result *result, uint32_t stage, struct fwu_error *error);
+
+const char *fwu_strerror(enum fwu_status status);
+
+#endif /* LIBFWU_H */
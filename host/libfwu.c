@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <tee_client_api.h>
+
+#include <fwu_ta.h>
+#include <fwu_client.h>
+#include <libfwu.h>
+
+/* Interval at which the progress page of the TA is checked for changes */
+#define FWU_OP_WATCH_INTERVAL_MS 10
+
+struct fwu_op {
+	struct fwu_client *client;
+	int fd;
+	fwu_event_cb cb;
+	void *arg;
+	pthread_t thread;
+	pthread_t watcher;
+	int watching;
+	int pipe_fd[2];
+	volatile int finished;
+	int delivered;
+	struct fwu_job_result result;
+	struct fwu_progress last;
+};
+
+/* Make the fd readable, a full pipe is readable already */
+static void fwu_op_wake(struct fwu_op *op)
+{
+	char c = 0;
+
+	while ((write(op->pipe_fd[1], &c, 1) < 0) && (EINTR == errno))
+		;
+}
+
+static void *fwu_op_worker(void *arg)
+{
+	struct fwu_op *op = (struct fwu_op *)arg;
+
+	(void)fwu_client_update(op->client, op->fd, &op->result);
+
+	__atomic_store_n(&op->finished, 1, __ATOMIC_RELEASE);
+	fwu_op_wake(op);
+
+	return NULL;
+}
+
+/* The TA only updates the progress page, wake the fd when it changes. */
+static void *fwu_op_watcher(void *arg)
+{
+	struct fwu_op *op = (struct fwu_op *)arg;
+	const struct timespec interval = { 0, FWU_OP_WATCH_INTERVAL_MS * 1000000L };
+	struct fwu_progress last;
+	struct fwu_progress progress;
+
+	(void)memset(&last, 0, sizeof(last));
+	while (!__atomic_load_n(&op->finished, __ATOMIC_ACQUIRE))
+	{
+		fwu_client_progress(op->client, &progress);
+		if (0 != memcmp(&progress, &last, sizeof(last)))
+		{
+			last = progress;
+			fwu_op_wake(op);
+		}
+		(void)nanosleep(&interval, NULL);
+	}
+
+	return NULL;
+}
+
+enum fwu_status fwu_update_async(struct fwu_client *client, int fd, fwu_event_cb cb, void *arg, struct fwu_op **op)
+{
+	struct fwu_op *new_op;
+
+	if ((NULL == client) || (fd < 0) || (NULL == op))
+		return FWU_ERR_PARAM;
+
+	new_op = calloc(1, sizeof(*new_op));
+	if (NULL == new_op)
+		return FWU_ERR_NOMEM;
+
+	new_op->client = client;
+	new_op->fd = fd;
+	new_op->cb = cb;
+	new_op->arg = arg;
+
+	if (0 != pipe2(new_op->pipe_fd, O_CLOEXEC | O_NONBLOCK))
+	{
+		free(new_op);
+		return FWU_ERR_NOMEM;
+	}
+
+	client->cancel = 0;
+	if (0 != pthread_create(&new_op->thread, NULL, fwu_op_worker, new_op))
+	{
+		(void)close(new_op->pipe_fd[0]);
+		(void)close(new_op->pipe_fd[1]);
+		free(new_op);
+		return FWU_ERR_NOMEM;
+	}
+
+	/* Without the watcher, the fd only becomes readable at the end. */
+	new_op->watching = (0 == pthread_create(&new_op->watcher, NULL, fwu_op_watcher, new_op));
+
+	*op = new_op;
+
+	return FWU_OK;
+}
+
+int fwu_op_fd(const struct fwu_op *op)
+{
+	return op->pipe_fd[0];
+}
+
+int fwu_op_poll(struct fwu_op *op)
+{
+	struct fwu_event event;
+	char buf[64];
+	ssize_t len;
+	int finished;
+
+	if (op->delivered)
+		return 1;
+
+	/* Drain the wake-ups before the state is read, a later one keeps the fd readable. */
+	do
+		len = read(op->pipe_fd[0], buf, sizeof(buf));
+	while ((0 < len) || ((len < 0) && (EINTR == errno)));
+
+	finished = __atomic_load_n(&op->finished, __ATOMIC_ACQUIRE);
+
+	(void)memset(&event, 0, sizeof(event));
+	fwu_client_progress(op->client, &event.progress);
+
+	if (0 != memcmp(&event.progress, &op->last, sizeof(op->last)))
+	{
+		op->last = event.progress;
+		event.type = FWU_EVENT_PROGRESS;
+		if (NULL != op->cb)
+			op->cb(&event, op->arg);
+	}
+
+	if (!finished)
+		return 0;
+
+	event.type = FWU_EVENT_DONE;
+	fwu_error_from_result(&op->result, event.progress.stage, &event.error);
+	op->delivered = 1;
+	if (NULL != op->cb)
+		op->cb(&event, op->arg);
+
+	return 1;
+}
+
+void fwu_op_cancel(struct fwu_op *op)
+{
+	fwu_client_cancel(op->client);
+}
+
+enum fwu_status fwu_op_wait(struct fwu_op *op, struct fwu_error *error)
+{
+	struct fwu_error err;
+	struct fwu_progress progress;
+
+	(void)pthread_join(op->thread, NULL);
+	if (op->watching)
+		(void)pthread_join(op->watcher, NULL);
+	(void)fwu_op_poll(op);
+
+	fwu_client_progress(op->client, &progress);
+	fwu_error_from_result(&op->result, progress.stage, &err);
+	if (NULL != error)
+		*error = err;
+
+	(void)close(op->pipe_fd[0]);
+	(void)close(op->pipe_fd[1]);
+	free(op);
+
+	return err.status;
+}
+
+void fwu_error_from_result(const struct fwu_job_result *result, uint32_t stage, struct fwu_error *error)
+{
+	error->res = result->res;
+	error->origin = result->origin;
+	error->stage = stage;
+
+	if (TEEC_SUCCESS == result->res)
+		error->status = FWU_OK;
+	else if (TEEC_ERROR_CANCEL == result->res)
+		error->status = FWU_ERR_CANCELLED;
+	else if (TEEC_ERROR_BAD_PARAMETERS == result->res)
+		error->status = FWU_ERR_PARAM;
+	else if (TEEC_ERROR_OUT_OF_MEMORY == result->res)
+		error->status = FWU_ERR_NOMEM;
+	else if (TEEC_ORIGIN_API == result->origin)
+		error->status = (TEEC_ERROR_BAD_FORMAT == result->res) ? FWU_ERR_PACKAGE : FWU_ERR_IO;
+	else if (TEEC_ORIGIN_TRUSTED_APP != result->origin)
+		error->status = FWU_ERR_TEE;
+	else if (FWU_STAGE_WRITE == stage)
+		error->status = FWU_ERR_FLASH;
+	else
+		error->status = FWU_ERR_PACKAGE;
+}
+
+const char *fwu_strerror(enum fwu_status status)
+{
+	switch (status)
+	{
+	case FWU_OK:
+		return "success";
+	case FWU_ERR_PARAM:
+		return "invalid argument";
+	case FWU_ERR_IO:
+		return "package read error";
+	case FWU_ERR_NOMEM:
+		return "out of memory";
+	case FWU_ERR_TEE:
+		return "TEE communication error";
+	case FWU_ERR_PACKAGE:
+		return "invalid update package";
+	case FWU_ERR_FLASH:
+		return "SPI flash write error";
+	case FWU_ERR_CANCELLED:
+		return "cancelled";
+	default:
+		break;
+	}
+
+	return "unknown error";
+}
@@ -26,134 +26,776 @@
  */
 
 #include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/un.h>
 #include <tee_client_api.h>
 
 #include <fwu_ta.h>
+#include <fwu_client.h>
+#include <fwu_plan.h>
+#include <fwud_ipc.h>
+#include <libfwu.h>
 
-int main(int argc, char *argv[])
+/* Interval of the progress report */
+#define FWU_PROGRESS_INTERVAL_MS 200
+
+static volatile sig_atomic_t fwu_interrupted;
+
+#define FWU_COMPONENT_NAME(id, name, uuid) name,
+
+static const char *const fwu_component_names[FWU_COMP_MAX] = {
+	"unknown",
+	FWU_COMPONENTS(FWU_COMPONENT_NAME)
+};
+
+static const struct option fwu_options[] = {
+	{ "validate", no_argument, NULL, 'v' },
+	{ "stats", no_argument, NULL, 's' },
+	{ "jobs", required_argument, NULL, 'j' },
+	{ "slice", required_argument, NULL, 't' },
+	{ "mem", no_argument, NULL, 'm' },
+	{ "storage", no_argument, NULL, 'S' },
+	{ "list", no_argument, NULL, 'l' },
+	{ "components", no_argument, NULL, 'c' },
+	{ "inspect", no_argument, NULL, 'i' },
+	{ "plan", no_argument, NULL, 'p' },
+	{ "board", required_argument, NULL, 'b' },
+	{ "bench", required_argument, NULL, 'B' },
+	{ "slots", no_argument, NULL, 'A' },
+	{ NULL, 0, NULL, 0 }
+};
+
+static void fwu_signal(int sig)
+{
+	(void)sig;
+	fwu_interrupted = 1;
+}
+
+static void usage(void)
+{
+	(void)fprintf(stderr, "usage: fwu [--jobs N | --slice MS] {update firmware package}\n");
+	(void)fprintf(stderr, "       fwu {update firmware package} {update firmware package}...\n");
+	(void)fprintf(stderr, "       fwu --validate {update firmware package}\n");
+	(void)fprintf(stderr, "       fwu --stats\n");
+	(void)fprintf(stderr, "       fwu --mem\n");
+	(void)fprintf(stderr, "       fwu --storage\n");
+	(void)fprintf(stderr, "       fwu --list {update firmware package}\n");
+	(void)fprintf(stderr, "       fwu --components\n");
+	(void)fprintf(stderr, "       fwu --inspect {update firmware package}\n");
+	(void)fprintf(stderr, "       fwu --plan [--board NAME] {update firmware package}\n");
+	(void)fprintf(stderr, "       fwu --bench N\n");
+	(void)fprintf(stderr, "       fwu --slots\n");
+	exit(1);
+}
+
+/* Pass the job to the fwu daemon, returns -1 if the daemon is not running */
+static int fwud_submit(uint32_t job, int pkg_fd, struct fwud_response *rsp)
+{
+	struct sockaddr_un addr;
+	struct fwud_request req;
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	union {
+		char buf[CMSG_SPACE(sizeof(int))];
+		struct cmsghdr align;
+	} ctrl;
+	int fd;
+
+	fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+	if (fd < 0)
+		return -1;
+
+	(void)memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	(void)strncpy(addr.sun_path, FWUD_SOCKET_PATH, sizeof(addr.sun_path) - 1);
+	if (0 != connect(fd, (struct sockaddr *)&addr, sizeof(addr)))
+	{
+		(void)close(fd);
+		return -1;
+	}
+
+	req.magic = FWUD_MAGIC;
+	req.job = job;
+	(void)memset(&msg, 0, sizeof(msg));
+	iov.iov_base = &req;
+	iov.iov_len = sizeof(req);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	if (0 <= pkg_fd)
+	{
+		(void)memset(&ctrl, 0, sizeof(ctrl));
+		msg.msg_control = ctrl.buf;
+		msg.msg_controllen = sizeof(ctrl.buf);
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+		(void)memcpy(CMSG_DATA(cmsg), &pkg_fd, sizeof(int));
+	}
+
+	if ((sendmsg(fd, &msg, MSG_NOSIGNAL) != (ssize_t)sizeof(req)) ||
+		(recv(fd, rsp, sizeof(*rsp), 0) != (ssize_t)sizeof(*rsp)) ||
+		(FWUD_MAGIC != rsp->magic))
+		errx(1, "fwud communication error");
+
+	(void)close(fd);
+
+	return 0;
+}
+
+static void fwu_event(const struct fwu_event *event, void *arg)
 {
-	TEEC_Result res = (TEEC_Result)TEEC_SUCCESS;
-	TEEC_Context ctx;
-	TEEC_Session sess;
-	TEEC_Operation op;
-	TEEC_UUID uuid = FWU_TA_UUID;
+	const struct fwu_progress *p = &event->progress;
+
+	(void)arg;
+	if (FWU_EVENT_PROGRESS != event->type)
+		return;
+
+	if (FWU_STAGE_WRITE == p->stage)
+		(void)fprintf(stderr, "\rWriting to SPI flash: %u/%u bytes   ", p->written, p->output_done);
+	else if (FWU_STAGE_DONE == p->stage)
+		(void)fprintf(stderr, "\rWritten %u bytes to SPI flash.       \n", p->written);
+	else
+		(void)fprintf(stderr, "\rFIP %u: %u/%u bytes, %u bytes re-encrypted", p->fip_count,
+					  p->input_done, p->input_size, p->output_done);
+}
+
+/* Run the job in this process */
+static void fwu_local(uint32_t job, int pkg_fd, struct fwud_response *rsp)
+{
+	TEEC_Result res;
+	struct fwu_client client;
+	struct fwu_op *op;
+	struct fwu_error error;
+	struct sigaction sa;
+	struct pollfd pfd;
 	uint32_t err_origin;
+	int cancelled = 0;
 
-	FILE *fp_in = NULL;
-	size_t readSize;
-	size_t work_size;
-	uint8_t *input_buf = NULL;
-	uint8_t *output_buf = NULL;
-	struct stat st;
+	res = fwu_client_open(&client, &err_origin);
+	if (res != TEEC_SUCCESS)
+		errx(1, "fwu session open failed with code 0x%x origin 0x%x", res, err_origin);
+
+	(void)memset(rsp, 0, sizeof(*rsp));
+	rsp->magic = FWUD_MAGIC;
+	rsp->job = job;
+	if (FWUD_JOB_UPDATE != job)
+	{
+		(void)fwu_client_validate(&client, pkg_fd, &rsp->result);
+		fwu_client_close(&client);
+		return;
+	}
+
+	if (FWU_OK != fwu_update_async(&client, pkg_fd, fwu_event, NULL, &op))
+		errx(1, "Can not start the firmware update");
+
+	/* Ctrl-C cancels the update until the flash write starts. */
+	(void)memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = fwu_signal;
+	(void)sigaction(SIGINT, &sa, NULL);
+	(void)sigaction(SIGTERM, &sa, NULL);
 
-	if (argc != 2)
+	pfd.fd = fwu_op_fd(op);
+	pfd.events = POLLIN;
+	while (0 == fwu_op_poll(op))
 	{
-		res = TEEC_ERROR_GENERIC;
-		(void)printf("Error argc=%d\n", argc);
+		if (fwu_interrupted && !cancelled)
+		{
+			fwu_op_cancel(op);
+			cancelled = 1;
+		}
+		if ((poll(&pfd, 1, FWU_PROGRESS_INTERVAL_MS) < 0) && (EINTR != errno))
+			break;
 	}
 
-	/* Initialize a context connecting us to the TEE */
-	res = TEEC_InitializeContext(NULL, &ctx);
+	(void)fwu_op_wait(op, &error);
+	rsp->result.res = error.res;
+	rsp->result.origin = error.origin;
+	fwu_client_progress(&client, &rsp->progress);
+	fwu_client_close(&client);
+}
+
+/* Print the memory usage of the fwu ta */
+static int fwu_mem(void)
+{
+	TEEC_Result res;
+	struct fwu_client client;
+	struct fwu_mem_stats stats;
+	uint32_t err_origin;
+
+	res = fwu_client_open(&client, &err_origin);
+	if (res != TEEC_SUCCESS)
+		errx(1, "fwu session open failed with code 0x%x origin 0x%x", res, err_origin);
+
+	res = fwu_client_mem_stats(&client, &stats, &err_origin);
+	fwu_client_close(&client);
+	if (res != TEEC_SUCCESS)
+		errx(1, "Can not get the memory usage, code 0x%x origin 0x%x", res, err_origin);
+
+	printf("arena      : %u/%u bytes\n", stats.arena_high, stats.arena_size);
+	printf("stack      : %u/%u bytes\n", stats.stack_usage, stats.stack_size);
+
+	return 0;
+}
+
+/* Print the storage backend of the update package */
+static int fwu_storage(void)
+{
+	static const char *const names[] = { "SPI flash", "unknown", "file (REE FS)" };
+	TEEC_Result res;
+	struct fwu_client client;
+	struct fwu_storage_info info;
+	uint32_t err_origin;
+
+	res = fwu_client_open(&client, &err_origin);
 	if (res != TEEC_SUCCESS)
-		errx(1, "TEEC_InitializeContext failed with code 0x%x", res);
+		errx(1, "fwu session open failed with code 0x%x origin 0x%x", res, err_origin);
 
-	/* Open a session to the "fwu ta". */
-	res = TEEC_OpenSession(&ctx, &sess, &uuid,
-						   TEEC_LOGIN_PUBLIC, NULL, NULL, &err_origin);
+	res = fwu_client_storage_info(&client, &info, &err_origin);
+	fwu_client_close(&client);
 	if (res != TEEC_SUCCESS)
-		errx(1, "TEEC_Opensession failed with code 0x%x origin 0x%x",
-			 res, err_origin);
+		errx(1, "Can not get the storage information, code 0x%x origin 0x%x", res, err_origin);
 
-	/* Get the stat of the file. */
-	if (stat(argv[1], &st) != 0)
-		errx(1, "File access error %s\n", argv[1]);
+	printf("storage    : %s\n", (info.type < (sizeof(names) / sizeof(names[0]))) ? names[info.type] : "unknown");
+	printf("capacity   : %u bytes\n", info.capacity);
+	printf("block size : %u bytes\n", info.block_size);
+	printf("erase size : %u bytes\n", info.erase_size);
+	printf("transfer   : %u bytes\n", info.max_transfer);
 
-	/* Allocates a buffer. */
-	input_buf = malloc((size_t)st.st_size);
-	if (input_buf == NULL)
-		err(1, "Memory allocate error\n");
+	return 0;
+}
 
-	/* Input file */
-	fp_in = fopen(argv[1], "rb");
-	if (fp_in == NULL)
+static void fwu_print_components(const struct fwu_component_stats *stats, int with_time)
+{
+	unsigned int id;
+
+	printf("%-12s %8s %12s %12s%s\n", "component", "entries", "in bytes", "out bytes", with_time ? "   time (ms)" : "");
+	for (id = 0; id < FWU_COMP_MAX; id++)
 	{
-		errx(0, "fopen error in_file=%s\n", argv[1]);
-		goto err_end;
+		if (0 == stats[id].count)
+			continue;
+
+		printf("%-12s %8u %12llu %12llu", fwu_component_names[id], stats[id].count,
+			   (unsigned long long)stats[id].in_bytes, (unsigned long long)stats[id].out_bytes);
+		if (with_time)
+			printf(" %11u", stats[id].time_ms);
+		printf("\n");
 	}
+}
+
+/* Print the components of a package, the package is not updated */
+static int fwu_list(const char *path)
+{
+	TEEC_Result res;
+	struct fwu_client client;
+	struct fwu_component_stats stats[FWU_COMP_MAX];
+	struct fwu_job_result result;
+	uint32_t fip_count = 0;
+	uint32_t err_origin;
+	int pkg_fd;
+
+	pkg_fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (pkg_fd < 0)
+		err(1, "File access error %s", path);
+
+	res = fwu_client_open(&client, &err_origin);
+	if (res != TEEC_SUCCESS)
+		errx(1, "fwu session open failed with code 0x%x origin 0x%x", res, err_origin);
+
+	res = fwu_client_list_components(&client, pkg_fd, stats, &fip_count, &result);
+	fwu_client_close(&client);
+	(void)close(pkg_fd);
+	if (res != TEEC_SUCCESS)
+		errx(1, "Can not list the components, code 0x%x origin 0x%x", res, result.origin);
+
+	printf("FIPs       : %u\n", fip_count);
+	fwu_print_components(stats, 0);
+
+	return 0;
+}
+
+/* Print the update statistics per component of the fwu ta */
+static int fwu_components(void)
+{
+	TEEC_Result res;
+	struct fwu_client client;
+	struct fwu_component_stats stats[FWU_COMP_MAX];
+	uint32_t err_origin;
 
-	readSize = fread(input_buf, 1U, (size_t)st.st_size, fp_in);
-	if (readSize != st.st_size)
+	res = fwu_client_open(&client, &err_origin);
+	if (res != TEEC_SUCCESS)
+		errx(1, "fwu session open failed with code 0x%x origin 0x%x", res, err_origin);
+
+	res = fwu_client_component_stats(&client, stats, 0, &err_origin);
+	fwu_client_close(&client);
+	if (res != TEEC_SUCCESS)
+		errx(1, "Can not get the component statistics, code 0x%x origin 0x%x", res, err_origin);
+
+	fwu_print_components(stats, 1);
+
+	return 0;
+}
+
+static const char *fwu_fip_name(uint32_t name)
+{
+	switch (name)
 	{
-		errx(0, "File read error %ld\n", readSize);
-		goto err_end;
+	case TOC_HEADER_NAME_PLAIN:
+		return "plain";
+	case TOC_HEADER_NAME_KEYRING:
+		return "keyring";
+	case TOC_HEADER_NAME_BOOT_FW:
+		return "bootfw";
+	case TOC_HEADER_NAME_NS_BL2U:
+		return "nsbl2u";
+	default:
+		return "unknown";
 	}
+}
 
-	/* get size of output FIP */
-	(void)memset(&op, 0, sizeof(op));
-	op.paramTypes = (uint32_t)TEEC_PARAM_TYPES(TEEC_MEMREF_TEMP_INPUT, TEEC_VALUE_OUTPUT, TEEC_NONE, TEEC_NONE);
-	op.params[0].tmpref.buffer = (void *)input_buf;
-	op.params[0].tmpref.size = readSize;
+/* Get the layout of the package at path from a read-only mapping, without the TEE */
+static void fwu_plan_file(const char *path, struct fwu_plan *plan, size_t *size)
+{
+	struct stat st;
+	void *pkg;
+	int fd;
 
-	res = TEEC_InvokeCommand(&sess, (uint32_t)FWU_CMD_CALC_WORK_SIZE, &op, &err_origin);
-	if (res != TEEC_SUCCESS)
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		err(1, "File access error %s", path);
+
+	if ((0 != fstat(fd, &st)) || (0 == st.st_size))
+		errx(1, "Invalid package %s", path);
+	*size = (size_t)st.st_size;
+
+	pkg = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+	(void)close(fd);
+	if (MAP_FAILED == pkg)
+		err(1, "Can not map %s", path);
+
+	if (0 != fwu_plan_package(pkg, *size, plan))
+		errx(1, "Invalid package %s", path);
+
+	(void)munmap(pkg, *size);
+}
+
+/* Print the FIPs and the ToC entries of a package */
+static int fwu_inspect(const char *path)
+{
+	static struct fwu_plan plan;
+	const struct fwu_plan_fip *fip;
+	const struct fwu_plan_entry *entry;
+	size_t size;
+	uint32_t i, j;
+
+	fwu_plan_file(path, &plan, &size);
+
+	printf("package    : %zu bytes, %u FIPs%s\n", size, plan.fip_count, plan.has_directory ? ", directory" : "");
+	for (i = 0; i < plan.fip_count; i++)
+	{
+		fip = &plan.fip[i];
+		printf("FIP %-6u : %-7s offset 0x%08x size %10u out 0x%08x size %10u align %u\n", i, fwu_fip_name(fip->name),
+			   fip->offset, fip->size, fip->out_offset, fip->out_size, fip->align);
+		for (j = 0; j < fip->entry_count; j++)
+		{
+			entry = &plan.entry[fip->first_entry + j];
+			printf("  %-12s size %10llu out %10u\n", fwu_component_names[entry->component],
+				   (unsigned long long)entry->size, entry->out_size);
+		}
+	}
+	printf("work size  : %u bytes\n", plan.work_size);
+	printf("single     : %u bytes (in-place update)\n", plan.single_size);
+
+	return 0;
+}
+
+/* Print the SPI footprint and the estimated update time of a package */
+static int fwu_plan(const char *path, const char *board_name)
+{
+	static struct fwu_plan plan;
+	const struct fwu_board_cost *board;
+	struct fwu_plan_estimate est;
+	size_t size;
+	unsigned int i;
+
+	board = fwu_plan_board(board_name);
+	if (NULL == board)
 	{
-		errx(0, "TEEC_InvokeCommand failed with code 0x%x origin 0x%x",
-			 res, err_origin);
-		goto err_end;
+		(void)fprintf(stderr, "Unknown board %s, one of:", board_name);
+		for (i = 0; NULL != fwu_plan_board_at(i); i++)
+			(void)fprintf(stderr, " %s", fwu_plan_board_at(i)->name);
+		(void)fprintf(stderr, "\n");
+		return 1;
 	}
 
-	/* Allocates a output buffer. */
-	work_size = op.params[1].value.a;
-	if (0 == work_size)
+	fwu_plan_file(path, &plan, &size);
+	fwu_plan_estimate(&plan, board, &est);
+
+	printf("board      : %s\n", board->name);
+	printf("FIPs       : %u\n", plan.fip_count);
+	printf("work size  : %u bytes, single %u bytes\n", plan.work_size, plan.single_size);
+	printf("SPI window : 0x%08x-0x%08x (%u bytes)\n", board->spi_offset, board->spi_end,
+		   board->spi_end - board->spi_offset);
+	if (CFG_FWU_AB)
+		printf("A/B slot   : %u bytes\n", est.capacity);
+	printf("footprint  : %u bytes, %u sectors of %u bytes, %s\n", est.footprint, est.sectors, board->erase_size,
+		   est.fits ? "fits" : "does NOT fit");
+	printf("TSIP calls : %u\n", est.tsip_calls);
+	printf("estimate   : %u ms (re-encryption %u, copy %u, erase %u, program %u)\n", est.total_ms,
+		   est.reenc_ms, est.copy_ms, est.erase_ms, est.program_ms);
+
+	return est.fits ? 0 : 1;
+}
+
+/* Number of descriptors of the ring of fwu --bench */
+#define FWU_BENCH_RING_ENTRIES 64
+
+static uint64_t fwu_now_us(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((uint64_t)ts.tv_sec * 1000000) + ((uint64_t)ts.tv_nsec / 1000);
+}
+
+/* Compare FWU_CMD_GET_MEM_STATS invoked one by one and through the command ring */
+static int fwu_bench(unsigned int count)
+{
+	TEEC_Result res;
+	struct fwu_client client;
+	struct fwu_mem_stats stats;
+	struct fwu_ring ring;
+	struct fwu_ring_desc *desc;
+	uint64_t start, invoke_us, ring_us;
+	uint32_t err_origin;
+	uint32_t done;
+	unsigned int i, queued;
+	unsigned int submits = 0;
+
+	res = fwu_client_open(&client, &err_origin);
+	if (res != TEEC_SUCCESS)
+		errx(1, "fwu session open failed with code 0x%x origin 0x%x", res, err_origin);
+
+	res = fwu_ring_open(&client, &ring, FWU_BENCH_RING_ENTRIES, 0);
+	if (res != TEEC_SUCCESS)
+		errx(1, "Can not allocate the command ring, code 0x%x", res);
+
+	start = fwu_now_us();
+	for (i = 0; i < count; i++)
 	{
-		errx(0, "Invalid Update data\n");
-		goto err_end;
+		res = fwu_client_mem_stats(&client, &stats, &err_origin);
+		if (res != TEEC_SUCCESS)
+			errx(1, "FWU_CMD_GET_MEM_STATS failed with code 0x%x origin 0x%x", res, err_origin);
 	}
-	
-	output_buf = malloc(work_size);
-	if (output_buf == NULL)
+	invoke_us = fwu_now_us() - start;
+
+	start = fwu_now_us();
+	for (i = 0; i < count; i += queued)
 	{
-		err(0, "Memory allocate error\n");
-		goto err_end;
+		for (queued = 0; (queued < FWU_BENCH_RING_ENTRIES) && ((i + queued) < count); queued++)
+			(void)fwu_ring_queue(&ring, FWU_CMD_GET_MEM_STATS,
+								 TEEC_PARAM_TYPES(TEEC_VALUE_OUTPUT, TEEC_VALUE_OUTPUT, TEEC_NONE, TEEC_NONE));
+
+		res = fwu_ring_submit(&client, &ring, &done, &err_origin);
+		if ((res != TEEC_SUCCESS) || (done != queued))
+			errx(1, "FWU_CMD_RING_SUBMIT failed with code 0x%x origin 0x%x", res, err_origin);
+		submits++;
+
+		desc = &ring.desc[(ring.hdr->head - 1) % ring.hdr->entries];
+		if (TEEC_SUCCESS != desc->result)
+			errx(1, "FWU_CMD_GET_MEM_STATS failed in the ring with code 0x%x", desc->result);
 	}
+	ring_us = fwu_now_us() - start;
 
-	/* Update Fip data and save to SPI Flash*/
-	(void)memset(&op, 0, sizeof(op));
-	op.paramTypes = (uint32_t)TEEC_PARAM_TYPES(TEEC_MEMREF_TEMP_INPUT, TEEC_MEMREF_TEMP_INOUT, TEEC_NONE, TEEC_NONE);
-	op.params[0].tmpref.buffer = (void *)input_buf;
-	op.params[0].tmpref.size = readSize;
-	op.params[1].tmpref.buffer = (void *)output_buf;
-	op.params[1].tmpref.size = work_size;
+	fwu_ring_close(&ring);
+	fwu_client_close(&client);
+
+	printf("commands   : %u (FWU_CMD_GET_MEM_STATS)\n", count);
+	printf("invoke     : %llu us, %.1f us per command, %u invokes\n", (unsigned long long)invoke_us,
+		   (double)invoke_us / count, count);
+	printf("ring       : %llu us, %.1f us per command, %u invokes\n", (unsigned long long)ring_us,
+		   (double)ring_us / count, submits);
+	if (0 != ring_us)
+		printf("speedup    : %.2fx\n", (double)invoke_us / (double)ring_us);
+
+	return 0;
+}
+
+/* Print the active A/B staging slot */
+static int fwu_slots(void)
+{
+	TEEC_Result res;
+	struct fwu_client client;
+	struct fwu_slot_info info;
+	uint32_t err_origin;
+
+	res = fwu_client_open(&client, &err_origin);
+	if (res != TEEC_SUCCESS)
+		errx(1, "fwu session open failed with code 0x%x origin 0x%x", res, err_origin);
+
+	res = fwu_client_slot_info(&client, &info, &err_origin);
+	fwu_client_close(&client);
+	if (TEEC_ERROR_NOT_SUPPORTED == res)
+		errx(1, "The fwu ta is built without the A/B slots (FWU_AB=y)");
+	if (res != TEEC_SUCCESS)
+		errx(1, "Can not get the slot information, code 0x%x origin 0x%x", res, err_origin);
+
+	if (FWU_SLOT_NONE == info.slot)
+		printf("active     : none\n");
+	else
+		printf("active     : %c (sequence %u, %u bytes)\n", (0 == info.slot) ? 'A' : 'B', info.sequence, info.length);
+	printf("slot size  : %u bytes\n", info.slot_size);
+
+	return 0;
+}
+
+/* Update the FIP sections on several sessions, or in time slices, in this process */
+static void fwu_local_split(int pkg_fd, unsigned int jobs, uint32_t slice_ms, struct fwud_response *rsp)
+{
+	TEEC_Result res;
+	struct fwu_client client;
+	uint32_t err_origin;
+
+	res = fwu_client_open(&client, &err_origin);
+	if (res != TEEC_SUCCESS)
+		errx(1, "fwu session open failed with code 0x%x origin 0x%x", res, err_origin);
+
+	(void)memset(rsp, 0, sizeof(*rsp));
+	rsp->magic = FWUD_MAGIC;
+	rsp->job = FWUD_JOB_UPDATE;
+	if (0 != slice_ms)
+		(void)fwu_client_update_sliced(&client, pkg_fd, slice_ms, &rsp->result);
+	else
+		(void)fwu_client_update_sections(&client, pkg_fd, jobs, &rsp->result);
+
+	fwu_client_close(&client);
+}
+
+/* Update the firmware with several packages and save them with a single write */
+static void fwu_local_batch(const int *fds, unsigned int count, struct fwud_response *rsp)
+{
+	TEEC_Result res;
+	struct fwu_client client;
+	uint32_t err_origin;
 
-	res = TEEC_InvokeCommand(&sess, (uint32_t)FWU_CMD_FIRMWARE_UPDATE, &op, &err_origin);
+	res = fwu_client_open(&client, &err_origin);
 	if (res != TEEC_SUCCESS)
+		errx(1, "fwu session open failed with code 0x%x origin 0x%x", res, err_origin);
+
+	(void)memset(rsp, 0, sizeof(*rsp));
+	rsp->magic = FWUD_MAGIC;
+	rsp->job = FWUD_JOB_UPDATE;
+	(void)fwu_client_update_batch(&client, fds, count, &rsp->result);
+
+	fwu_client_close(&client);
+}
+
+int main(int argc, char *argv[])
+{
+	struct fwud_response rsp;
+	struct fwu_error error;
+	uint32_t job = FWUD_JOB_UPDATE;
+	unsigned int jobs = 1;
+	uint32_t slice_ms = 0;
+	int pkg_fds[FWU_BATCH_MAX];
+	unsigned int pkg_count = 0;
+	int pkg_fd = -1;
+	unsigned int i;
+	int mem = 0;
+	int storage = 0;
+	int list = 0;
+	int components = 0;
+	int inspect = 0;
+	int plan = 0;
+	const char *board = "generic";
+	unsigned int bench = 0;
+	int slots = 0;
+	int opt;
+
+	while ((opt = getopt_long(argc, argv, "", fwu_options, NULL)) != -1)
+	{
+		switch (opt)
+		{
+		case 'v':
+			job = FWUD_JOB_VALIDATE;
+			break;
+		case 's':
+			job = FWUD_JOB_STATS;
+			break;
+		case 'm':
+			mem = 1;
+			break;
+		case 'S':
+			storage = 1;
+			break;
+		case 'l':
+			list = 1;
+			break;
+		case 'c':
+			components = 1;
+			break;
+		case 'i':
+			inspect = 1;
+			break;
+		case 'p':
+			plan = 1;
+			break;
+		case 'b':
+			board = optarg;
+			break;
+		case 'A':
+			slots = 1;
+			break;
+		case 'B':
+			bench = (unsigned int)strtoul(optarg, NULL, 0);
+			if (0 == bench)
+				errx(1, "--bench needs at least 1 command");
+			break;
+		case 't':
+			slice_ms = (uint32_t)strtoul(optarg, NULL, 0);
+			if (0 == slice_ms)
+				errx(1, "--slice must be at least 1 ms");
+			break;
+		case 'j':
+			jobs = (unsigned int)strtoul(optarg, NULL, 0);
+			if ((0 == jobs) || (FWU_JOBS_MAX < jobs))
+				errx(1, "--jobs must be 1 to %d", FWU_JOBS_MAX);
+			break;
+		default:
+			usage();
+		}
+	}
+
+	if (mem)
+	{
+		if (optind != argc)
+			usage();
+		return fwu_mem();
+	}
+
+	if (storage)
+	{
+		if (optind != argc)
+			usage();
+		return fwu_storage();
+	}
+
+	if (components)
+	{
+		if (optind != argc)
+			usage();
+		return fwu_components();
+	}
+
+	if (slots)
+	{
+		if (optind != argc)
+			usage();
+		return fwu_slots();
+	}
+
+	if (0 != bench)
+	{
+		if (optind != argc)
+			usage();
+		return fwu_bench(bench);
+	}
+
+	if (inspect || plan)
 	{
-		errx(0, "TEEC_InvokeCommand failed with code 0x%x origin 0x%x",
-			 res, err_origin);
-		goto err_end;
+		if ((optind + 1) != argc)
+			usage();
+		return inspect ? fwu_inspect(argv[optind]) : fwu_plan(argv[optind], board);
 	}
 
-	/*
-	 * We're done with the TA, close the session and
-	 * destroy the context.
-	 */
-	TEEC_CloseSession(&sess);
-	TEEC_FinalizeContext(&ctx);
+	if (list)
+	{
+		if ((optind + 1) != argc)
+			usage();
+		return fwu_list(argv[optind]);
+	}
+
+	if (FWUD_JOB_STATS == job)
+	{
+		if (optind != argc)
+			usage();
+	}
+	else
+	{
+		pkg_count = (unsigned int)(argc - optind);
+		if ((0 == pkg_count) || (FWU_BATCH_MAX < pkg_count))
+			usage();
+		/* Several packages are only supported by the plain update. */
+		if ((1 < pkg_count) && ((FWUD_JOB_UPDATE != job) || (1 < jobs) || (0 != slice_ms)))
+			usage();
+	}
+
+	for (i = 0; i < pkg_count; i++)
+	{
+		pkg_fds[i] = open(argv[optind + (int)i], O_RDONLY | O_CLOEXEC);
+		if (pkg_fds[i] < 0)
+			err(1, "File access error %s", argv[optind + (int)i]);
+	}
+	if (0 != pkg_count)
+		pkg_fd = pkg_fds[0];
+
+	if (1 < pkg_count)
+		fwu_local_batch(pkg_fds, pkg_count, &rsp);
+	else if ((FWUD_JOB_UPDATE == job) && ((1 < jobs) || (0 != slice_ms)))
+		fwu_local_split(pkg_fd, jobs, slice_ms, &rsp);
+	else if (0 != fwud_submit(job, pkg_fd, &rsp))
+	{
+		if (FWUD_JOB_STATS == job)
+			errx(1, "fwud is not running");
+		fwu_local(job, pkg_fd, &rsp);
+	}
+
+	for (i = 0; i < pkg_count; i++)
+		(void)close(pkg_fds[i]);
+
+	if (FWUD_JOB_STATS == job)
+	{
+		printf("uptime     : %u s\n", rsp.stats.uptime);
+		printf("jobs       : %llu\n", (unsigned long long)rsp.stats.jobs);
+		printf("failures   : %llu\n", (unsigned long long)rsp.stats.failures);
+		printf("bytes      : %llu\n", (unsigned long long)rsp.stats.bytes);
+		printf("shm pool   : %llu\n", (unsigned long long)rsp.stats.shm_size);
+		printf("last result: 0x%x\n", rsp.stats.last_res);
+		return 0;
+	}
+
+	fwu_error_from_result(&rsp.result, rsp.progress.stage, &error);
+	if (FWU_OK != error.status)
+	{
+		warnx("%s (code 0x%x origin 0x%x)", fwu_strerror(error.status),
+			  error.res, error.origin);
+		return 1;
+	}
+
+	if (FWUD_JOB_VALIDATE == job)
+	{
+		printf("input size  : %u\n", rsp.result.input_size);
+		printf("work size   : %u\n", rsp.result.work_size);
+		printf("single size : %u\n", rsp.result.inplace_size);
+		return 0;
+	}
 
 	printf("We need to reset system to compele Firmware update process.\n");
 	printf("After the update is complete , please remove Update package \n");
 
-err_end:
-	if (NULL != fp_in)
-		(void)fclose(fp_in);
-	if (NULL != input_buf)
-		free(input_buf);
-	if (NULL != output_buf)
-		free(output_buf);
-
 	return 0;
 }
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <tee_internal_api.h>
+#include <string.h>
+
+#include "fwu_arena.h"
+#include "fwu_storage.h"
+#include "tsip_pta.h"
+
+#define FWU_ARENA_ROUND(size) (((size) + (FWU_ARENA_ALIGN - 1)) & ~(size_t)(FWU_ARENA_ALIGN - 1))
+
+struct fwu_pool {
+	size_t offset;          /* Offset of the pool in the arena */
+	size_t size;            /* Object size */
+	uint32_t capacity;      /* Number of objects */
+};
+
+#define FWU_POOL_PTA_DESC_OFFSET 0
+#define FWU_POOL_TOC_INDEX_OFFSET \
+	(FWU_POOL_PTA_DESC_OFFSET + FWU_ARENA_ROUND(sizeof(update_fw_t) * FWU_POOL_PTA_DESC_MAX))
+#define FWU_POOL_END \
+	(FWU_POOL_TOC_INDEX_OFFSET + FWU_ARENA_ROUND(sizeof(struct fwu_storage_seg) * FWU_POOL_TOC_INDEX_MAX))
+
+static const struct fwu_pool fwu_pools[FWU_POOL_COUNT] = {
+	[FWU_POOL_PTA_DESC] = { FWU_POOL_PTA_DESC_OFFSET, sizeof(update_fw_t), FWU_POOL_PTA_DESC_MAX },
+	[FWU_POOL_TOC_INDEX] = { FWU_POOL_TOC_INDEX_OFFSET, sizeof(struct fwu_storage_seg), FWU_POOL_TOC_INDEX_MAX },
+};
+
+static uint8_t fwu_arena_mem[FWU_ARENA_SIZE] __attribute__((aligned(FWU_ARENA_ALIGN)));
+static struct fwu_arena_pos fwu_arena_cur = { .used = FWU_POOL_END };
+static size_t fwu_arena_high;
+
+/* Bytes in use in the arena, the pools count by their objects */
+static size_t fwu_arena_usage(void)
+{
+	size_t usage = fwu_arena_cur.used - FWU_POOL_END;
+	uint32_t i;
+
+	for (i = 0; i < FWU_POOL_COUNT; i++)
+		usage += fwu_pools[i].size * fwu_arena_cur.pool_used[i];
+
+	return usage;
+}
+
+static void fwu_arena_update_high(void)
+{
+	size_t usage = fwu_arena_usage();
+
+	if (fwu_arena_high < usage)
+		fwu_arena_high = usage;
+}
+
+void fwu_arena_reset(void)
+{
+	COMPILE_TIME_ASSERT(FWU_POOL_END < FWU_ARENA_SIZE);
+
+	memset(&fwu_arena_cur, 0, sizeof(fwu_arena_cur));
+	fwu_arena_cur.used = FWU_POOL_END;
+}
+
+void fwu_arena_mark(struct fwu_arena_pos *pos)
+{
+	*pos = fwu_arena_cur;
+}
+
+void fwu_arena_release(const struct fwu_arena_pos *pos)
+{
+	uint32_t i;
+
+	if (pos->used < fwu_arena_cur.used)
+		fwu_arena_cur.used = pos->used;
+
+	for (i = 0; i < FWU_POOL_COUNT; i++)
+		if (pos->pool_used[i] < fwu_arena_cur.pool_used[i])
+			fwu_arena_cur.pool_used[i] = pos->pool_used[i];
+}
+
+void *fwu_arena_alloc(size_t size)
+{
+	void *ptr;
+
+	size = FWU_ARENA_ROUND(size);
+	if ((0 == size) || ((FWU_ARENA_SIZE - fwu_arena_cur.used) < size))
+	{
+		EMSG("The arena is exhausted (%zu + %zu bytes).\n", fwu_arena_cur.used, size);
+		return NULL;
+	}
+
+	ptr = &fwu_arena_mem[fwu_arena_cur.used];
+	memset(ptr, 0, size);
+
+	fwu_arena_cur.used += size;
+	fwu_arena_update_high();
+
+	return ptr;
+}
+
+void *fwu_pool_alloc(enum fwu_pool_id id, size_t size, uint32_t count)
+{
+	const struct fwu_pool *pool;
+	uint32_t *used;
+	void *ptr;
+
+	if ((FWU_POOL_COUNT <= (uint32_t)id) || (size != fwu_pools[id].size))
+		return NULL;
+
+	pool = &fwu_pools[id];
+	used = &fwu_arena_cur.pool_used[id];
+	if ((0 == count) || ((pool->capacity - *used) < count))
+	{
+		EMSG("Pool %u is exhausted (%u + %u objects).\n", (uint32_t)id, *used, count);
+		return NULL;
+	}
+
+	ptr = &fwu_arena_mem[pool->offset + (pool->size * *used)];
+	memset(ptr, 0, pool->size * count);
+
+	*used += count;
+	fwu_arena_update_high();
+
+	return ptr;
+}
+
+uint32_t fwu_arena_high_water(void)
+{
+	return (uint32_t)fwu_arena_high;
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <tee_internal_api.h>
+#include <string.h>
+
+#include "fwu_ta.h"
+#include "fwu_component.h"
+
+/* Generated by ta/Makefile from FWU_COMPONENTS */
+#include "fwu_component_table.h"
+
+/* Update statistics since the TA has been loaded, indexed by component ID */
+static struct fwu_component_stats fwu_component_stats[FWU_COMP_MAX];
+
+uint32_t fwu_component_id(const uuid_t *uuid)
+{
+	const struct fwu_component_slot *slot;
+
+	slot = &fwu_component_table[fwu_component_hash(uuid, FWU_COMPONENT_SEED) & (FWU_COMPONENT_TABLE_SIZE - 1)];
+	if ((FWU_COMP_UNKNOWN == slot->id) || (0 != memcmp(&slot->uuid, uuid, sizeof(uuid_t))))
+		return FWU_COMP_UNKNOWN;
+
+	return slot->id;
+}
+
+void fwu_component_account(const struct fwu_component_stats *fip_stats, uint32_t time_ms)
+{
+	uint64_t in_total = 0;
+	uint32_t id;
+
+	for (id = 0; id < FWU_COMP_MAX; id++)
+		in_total += fip_stats[id].in_bytes;
+
+	for (id = 0; id < FWU_COMP_MAX; id++)
+	{
+		if (0 == fip_stats[id].count)
+			continue;
+
+		fwu_component_stats[id].count += fip_stats[id].count;
+		fwu_component_stats[id].in_bytes += fip_stats[id].in_bytes;
+		fwu_component_stats[id].out_bytes += fip_stats[id].out_bytes;
+		/* The time of the FIP is shared out by the input size. */
+		if (0 != in_total)
+			fwu_component_stats[id].time_ms += (uint32_t)((time_ms * fip_stats[id].in_bytes) / in_total);
+	}
+}
+
+void fwu_component_get_stats(struct fwu_component_stats *stats, bool reset)
+{
+	memcpy(stats, fwu_component_stats, sizeof(fwu_component_stats));
+
+	if (reset)
+		memset(fwu_component_stats, 0, sizeof(fwu_component_stats));
+}
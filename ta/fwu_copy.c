@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+#if defined(__ARM_NEON) && defined(__ARM_FEATURE_CRC32)
+#include <arm_neon.h>
+#endif
+
+#include "fwu_copy.h"
+
+#if !defined(__ARM_FEATURE_CRC32)
+/* CRC-32 of the reflected polynomial 0xEDB88320, 4 bits at a time */
+static const uint32_t fwu_crc32_nibble[16] = {
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+	0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+	0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+static inline uint32_t fwu_crc32_byte(uint32_t c, uint8_t b)
+{
+	c ^= b;
+	c = (c >> 4) ^ fwu_crc32_nibble[c & 0xF];
+	return (c >> 4) ^ fwu_crc32_nibble[c & 0xF];
+}
+
+static inline uint32_t fwu_crc32_word(uint32_t c, uint64_t w)
+{
+	int i;
+
+	/* Little endian: the low byte is the first byte in memory. */
+	for (i = 0; i < 8; i++)
+		c = fwu_crc32_byte(c, (uint8_t)(w >> (8 * i)));
+
+	return c;
+}
+#else
+#define fwu_crc32_byte(c, b) __crc32b((c), (b))
+#define fwu_crc32_word(c, w) __crc32d((c), (w))
+#endif
+
+uint32_t fwu_copy_crc32(void *dst, const void *src, size_t size, uint32_t crc)
+{
+	uint8_t *d = (uint8_t *)dst;
+	const uint8_t *s = (const uint8_t *)src;
+	uint32_t c = ~crc;
+	uint64_t w;
+
+#if defined(__ARM_NEON) && defined(__ARM_FEATURE_CRC32)
+	/* 64 bytes per loop, all loads before the stores for the overlapping move. */
+	while (64 <= size)
+	{
+		uint8x16_t v0 = vld1q_u8(s);
+		uint8x16_t v1 = vld1q_u8(s + 16);
+		uint8x16_t v2 = vld1q_u8(s + 32);
+		uint8x16_t v3 = vld1q_u8(s + 48);
+
+		vst1q_u8(d, v0);
+		vst1q_u8(d + 16, v1);
+		vst1q_u8(d + 32, v2);
+		vst1q_u8(d + 48, v3);
+
+		c = __crc32d(c, vgetq_lane_u64(vreinterpretq_u64_u8(v0), 0));
+		c = __crc32d(c, vgetq_lane_u64(vreinterpretq_u64_u8(v0), 1));
+		c = __crc32d(c, vgetq_lane_u64(vreinterpretq_u64_u8(v1), 0));
+		c = __crc32d(c, vgetq_lane_u64(vreinterpretq_u64_u8(v1), 1));
+		c = __crc32d(c, vgetq_lane_u64(vreinterpretq_u64_u8(v2), 0));
+		c = __crc32d(c, vgetq_lane_u64(vreinterpretq_u64_u8(v2), 1));
+		c = __crc32d(c, vgetq_lane_u64(vreinterpretq_u64_u8(v3), 0));
+		c = __crc32d(c, vgetq_lane_u64(vreinterpretq_u64_u8(v3), 1));
+
+		s += 64;
+		d += 64;
+		size -= 64;
+	}
+#endif
+
+	while (8 <= size)
+	{
+		memcpy(&w, s, sizeof(w));
+		memcpy(d, &w, sizeof(w));
+		c = fwu_crc32_word(c, w);
+		s += 8;
+		d += 8;
+		size -= 8;
+	}
+
+	while (0 != size)
+	{
+		*d = *s;
+		c = fwu_crc32_byte(c, *s);
+		s++;
+		d++;
+		size--;
+	}
+
+	return ~c;
+}
+
+uint32_t fwu_crc32(const void *src, size_t size, uint32_t crc)
+{
+	const uint8_t *s = (const uint8_t *)src;
+	uint32_t c = ~crc;
+	uint64_t w;
+
+	while (8 <= size)
+	{
+		memcpy(&w, s, sizeof(w));
+		c = fwu_crc32_word(c, w);
+		s += 8;
+		size -= 8;
+	}
+
+	while (0 != size)
+	{
+		c = fwu_crc32_byte(c, *s);
+		s++;
+		size--;
+	}
+
+	return ~c;
+}
@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <tee_internal_api.h>
+#include <string.h>
+
+#include "rzg_firmware_image_package.h"
+#include "fwu_layout.h"
+#include "fwu_digest.h"
+
+/* Hash size bytes at data into hash with the reset operation op */
+static TEE_Result fwu_digest_hash(TEE_OperationHandle op, const void *data, uint32_t size, uint8_t *hash)
+{
+	TEE_Result res;
+	size_t hash_size = FIP_DIR_DIGEST_SIZE;
+
+	TEE_ResetOperation(op);
+	res = TEE_DigestDoFinal(op, data, size, hash, &hash_size);
+	if ((TEE_SUCCESS == res) && (FIP_DIR_DIGEST_SIZE != hash_size))
+		res = TEE_ERROR_GENERIC;
+
+	return res;
+}
+
+/* Size of the segment at offset, the last segment may be shorter */
+static uint32_t fwu_digest_seg_size(uint32_t size, uint32_t shift, uint32_t offset)
+{
+	if ((size - offset) < (1U << shift))
+		return size - offset;
+
+	return 1U << shift;
+}
+
+/* Hash the segment index of the FIP and compare it with the host digest */
+static TEE_Result fwu_digest_segment(TEE_OperationHandle op, const uint8_t *fip, uint32_t size, uint32_t shift,
+									 uint32_t index, const uint8_t *list)
+{
+	TEE_Result res;
+	uint8_t hash[FIP_DIR_DIGEST_SIZE];
+	uint32_t offset = index << shift;
+
+	res = fwu_digest_hash(op, fip + offset, fwu_digest_seg_size(size, shift, offset), hash);
+	if (TEE_SUCCESS != res)
+		return res;
+
+	if (0 != memcmp(hash, list + (index * FIP_DIR_DIGEST_SIZE), sizeof(hash)))
+	{
+		EMSG("The digest of segment %u does not match.\n", index);
+		return TEE_ERROR_SECURITY;
+	}
+
+	return TEE_SUCCESS;
+}
+
+TEE_Result fwu_digest_check(const void *fip, uint32_t size, const uint8_t *digest, uint32_t shift,
+							const uint8_t *list, uint32_t list_size)
+{
+	TEE_Result res;
+	TEE_OperationHandle op = TEE_HANDLE_NULL;
+	TEE_OperationHandle root = TEE_HANDLE_NULL;
+	uint8_t hash[FIP_DIR_DIGEST_SIZE];
+	uint32_t count, spot, pick;
+	size_t hash_size = sizeof(hash);
+	uint32_t i;
+
+	if (0 == shift)
+		count = 0;
+	else if ((FIP_DIR_SEGMENT_SHIFT_MIN > shift) || (FIP_DIR_SEGMENT_SHIFT_MAX < shift))
+		return TEE_ERROR_BAD_FORMAT;
+	else
+		count = fwu_layout_segments(size, shift);
+
+	/* The host digests must match the segments of the directory. */
+	if ((NULL != list) && ((0 == count) || ((count * FIP_DIR_DIGEST_SIZE) != list_size)))
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	res = TEE_AllocateOperation(&op, TEE_ALG_SHA256, TEE_MODE_DIGEST, 0);
+	if (TEE_SUCCESS != res)
+		return res;
+
+	if (0 == count)
+	{
+		res = fwu_digest_hash(op, fip, size, hash);
+	}
+	else
+	{
+		res = TEE_AllocateOperation(&root, TEE_ALG_SHA256, TEE_MODE_DIGEST, 0);
+		if (TEE_SUCCESS != res)
+		{
+			TEE_FreeOperation(op);
+			return res;
+		}
+
+		if (NULL != list)
+		{
+			TEE_DigestUpdate(root, list, list_size);
+		}
+		else
+		{
+			for (i = 0; (i < count) && (TEE_SUCCESS == res); i++)
+			{
+				res = fwu_digest_hash(op, (const uint8_t *)fip + (i << shift),
+									  fwu_digest_seg_size(size, shift, i << shift), hash);
+				if (TEE_SUCCESS == res)
+					TEE_DigestUpdate(root, hash, sizeof(hash));
+			}
+		}
+
+		if (TEE_SUCCESS == res)
+			res = TEE_DigestDoFinal(root, NULL, 0, hash, &hash_size);
+	}
+
+	if ((TEE_SUCCESS == res) && (0 != memcmp(hash, digest, sizeof(hash))))
+	{
+		EMSG("The FIP digest does not match the package directory.\n");
+		res = TEE_ERROR_SECURITY;
+	}
+
+	/* The list matches the directory, check the data against it. */
+	if ((TEE_SUCCESS == res) && (NULL != list))
+	{
+		spot = CFG_FWU_DIGEST_SPOT;
+		if ((0 == spot) || (count <= spot))
+		{
+			for (i = 0; (i < count) && (TEE_SUCCESS == res); i++)
+				res = fwu_digest_segment(op, fip, size, shift, i, list);
+		}
+		else
+		{
+			for (i = 0; (i < spot) && (TEE_SUCCESS == res); i++)
+			{
+				TEE_GenerateRandom(&pick, sizeof(pick));
+				res = fwu_digest_segment(op, fip, size, shift, pick % count, list);
+			}
+		}
+	}
+
+	if (TEE_HANDLE_NULL != root)
+		TEE_FreeOperation(root);
+	TEE_FreeOperation(op);
+
+	return res;
+}
+
+TEE_Result fwu_digest_sha256(const void *data, uint32_t size, uint8_t *digest)
+{
+	TEE_Result res;
+	TEE_OperationHandle op = TEE_HANDLE_NULL;
+
+	res = TEE_AllocateOperation(&op, TEE_ALG_SHA256, TEE_MODE_DIGEST, 0);
+	if (TEE_SUCCESS != res)
+		return res;
+
+	res = fwu_digest_hash(op, data, size, digest);
+	TEE_FreeOperation(op);
+
+	return res;
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <tee_internal_api.h>
+#include <string.h>
+
+#include "fwu_arena.h"
+#include "fwu_slot.h"
+
+/* Read-back buffer of the slot verification, taken from the arena */
+#define SLOT_VERIFY_CHUNK (1024)
+
+static struct fwu_slot_record fwu_slot_current;
+static uint32_t fwu_slot_meta;   /* Metadata sector of fwu_slot_current */
+static bool fwu_slot_loaded;
+
+static uint32_t fwu_slot_check(const struct fwu_slot_record *rec)
+{
+	const uint32_t *word = (const uint32_t *)rec;
+	uint32_t sum = 0;
+	size_t i;
+
+	for (i = 0; i < (offsetof(struct fwu_slot_record, check) / sizeof(uint32_t)); i++)
+		sum += word[i];
+
+	return ~sum;
+}
+
+static bool fwu_slot_valid(const struct fwu_slot_record *rec)
+{
+	return (FWU_SLOT_MAGIC == rec->magic) && (1 >= rec->slot) &&
+		   (FWU_SLOT_SIZE >= rec->length) && (fwu_slot_check(rec) == rec->check);
+}
+
+/* Read the records of both metadata sectors and keep the latest valid one */
+static TEE_Result fwu_slot_load(void)
+{
+	TEE_Result res;
+	struct fwu_slot_record rec;
+	uint32_t sector;
+
+	if (fwu_slot_loaded)
+		return TEE_SUCCESS;
+
+	memset(&fwu_slot_current, 0, sizeof(fwu_slot_current));
+	fwu_slot_current.slot = FWU_SLOT_NONE;
+	fwu_slot_meta = 1;
+
+	for (sector = 0; sector < 2; sector++)
+	{
+		res = fwu_storage_area_read(FWU_SLOT_META_OFFSET + (sector * FWU_BOARD_SPI_ERASE_SIZE),
+									&rec, sizeof(rec));
+		if (TEE_ERROR_NOT_SUPPORTED == res)
+			EMSG("The flash PTA does not support FLASH_CMD_READ_SPI, needed by the A/B slots.\n");
+		if (TEE_SUCCESS != res)
+			return res;
+
+		if (!fwu_slot_valid(&rec))
+			continue;
+
+		if ((FWU_SLOT_NONE == fwu_slot_current.slot) ||
+			((int32_t)(rec.sequence - fwu_slot_current.sequence) > 0))
+		{
+			fwu_slot_current = rec;
+			fwu_slot_meta = sector;
+		}
+	}
+
+	fwu_slot_loaded = true;
+
+	return TEE_SUCCESS;
+}
+
+TEE_Result fwu_slot_target(uint32_t *offset)
+{
+	TEE_Result res;
+
+	res = fwu_slot_load();
+	if (TEE_SUCCESS != res)
+		return res;
+
+	/* Without a record, slot 0 holds the image written before the A/B slots */
+	*offset = (1 == fwu_slot_current.slot) ? 0 : FWU_SLOT_SIZE;
+
+	return TEE_SUCCESS;
+}
+
+/* Compare the target slot with the written package */
+static TEE_Result fwu_slot_verify(uint32_t offset, const uint8_t *buf, uint32_t size)
+{
+	TEE_Result res;
+	struct fwu_arena_pos mark;
+	uint8_t *data;
+
+	fwu_arena_mark(&mark);
+	data = fwu_arena_alloc(SLOT_VERIFY_CHUNK);
+	if (NULL == data)
+		return TEE_ERROR_OUT_OF_MEMORY;
+
+	res = fwu_storage_area_compare(offset, buf, size, data, SLOT_VERIFY_CHUNK);
+
+	fwu_arena_release(&mark);
+
+	return res;
+}
+
+TEE_Result fwu_slot_activate(const void *buf, uint32_t size)
+{
+	TEE_Result res;
+	TEE_OperationHandle op = TEE_HANDLE_NULL;
+	struct fwu_slot_record rec;
+	size_t digest_size = sizeof(rec.digest);
+	struct fwu_arena_pos mark;
+	uint32_t offset, sector;
+	uint8_t *page;
+
+	res = fwu_slot_target(&offset);
+	if (TEE_SUCCESS != res)
+		return res;
+
+	res = fwu_slot_verify(offset, buf, size);
+	if (TEE_SUCCESS != res)
+		return res;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.magic = FWU_SLOT_MAGIC;
+	rec.sequence = fwu_slot_current.sequence + 1;
+	rec.slot = (0 == offset) ? 0 : 1;
+	rec.length = size;
+
+	res = TEE_AllocateOperation(&op, TEE_ALG_SHA256, TEE_MODE_DIGEST, 0);
+	if (TEE_SUCCESS != res)
+		return res;
+	res = TEE_DigestDoFinal(op, buf, size, rec.digest, &digest_size);
+	TEE_FreeOperation(op);
+	if (TEE_SUCCESS != res)
+		return res;
+
+	rec.check = fwu_slot_check(&rec);
+
+	/* One page in the other metadata sector, the current record stays valid until it is written. */
+	fwu_arena_mark(&mark);
+	page = fwu_arena_alloc(FWU_BOARD_SPI_PAGE_SIZE);
+	if (NULL == page)
+		return TEE_ERROR_OUT_OF_MEMORY;
+	memset(page, 0xFF, FWU_BOARD_SPI_PAGE_SIZE);
+	memcpy(page, &rec, sizeof(rec));
+
+	sector = (0 == fwu_slot_meta) ? 1 : 0;
+	res = fwu_storage_area_write(FWU_SLOT_META_OFFSET + (sector * FWU_BOARD_SPI_ERASE_SIZE),
+								 page, FWU_BOARD_SPI_PAGE_SIZE);
+	fwu_arena_release(&mark);
+	if (TEE_SUCCESS != res)
+	{
+		/* The record may be torn, read the metadata again next time. */
+		fwu_slot_loaded = false;
+		return res;
+	}
+
+	fwu_slot_current = rec;
+	fwu_slot_meta = sector;
+	DMSG("Slot %u is active (sequence %u)", rec.slot, rec.sequence);
+
+	return TEE_SUCCESS;
+}
+
+TEE_Result fwu_slot_info(uint32_t *slot, uint32_t *sequence, uint32_t *length)
+{
+	TEE_Result res;
+
+	res = fwu_slot_load();
+	if (TEE_SUCCESS != res)
+		return res;
+
+	*slot = fwu_slot_current.slot;
+	*sequence = fwu_slot_current.sequence;
+	*length = fwu_slot_current.length;
+
+	return TEE_SUCCESS;
+}
@@ -0,0 +1,702 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <tee_internal_api.h>
+#include <tee_internal_api_extensions.h>
+#include <string.h>
+
+#include "flash_pta.h"
+#include "fwu_storage.h"
+#include "fwu_board.h"
+#include "fwu_slot.h"
+
+/* Staging area of the update package in SPI flash */
+#define SPI_FWU_PACKAGE_OFFSET_ADDR FWU_BOARD_SPI_PACKAGE_OFFSET
+#define SPI_END_OFFSET_ADDR FWU_BOARD_SPI_END_OFFSET
+
+/* SPI geometry used if the flash PTA does not support FLASH_CMD_GET_INFO */
+#define SPI_DEFAULT_BLOCK_SIZE FWU_BOARD_SPI_PAGE_SIZE
+#define SPI_DEFAULT_ERASE_SIZE FWU_BOARD_SPI_ERASE_SIZE
+
+/* Staging object in the secure storage */
+#define STORAGE_OBJECT_ID "fwu_package"
+#define STORAGE_OBJECT_CAPACITY (SPI_END_OFFSET_ADDR - SPI_FWU_PACKAGE_OFFSET_ADDR)
+#define REE_BLOCK_SIZE (0x1000)
+#define REE_MAX_TRANSFER (0x100000)
+
+static const TEE_UUID flash_uuid = FLASH_UUID;
+static TEE_TASessionHandle flash_session = TEE_HANDLE_NULL;
+static uint32_t flash_erase_size = SPI_DEFAULT_ERASE_SIZE;
+static uint32_t *fwu_storage_written;
+
+static TEE_Result spi_open(struct fwu_storage_geometry *geo)
+{
+	TEE_Result res;
+	TEE_Param params[TEE_NUM_PARAMS] = {0};
+	uint32_t ret_origin = 0;
+
+	uint32_t param_types = TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_OUTPUT,
+										   TEE_PARAM_TYPE_VALUE_OUTPUT,
+										   TEE_PARAM_TYPE_NONE,
+										   TEE_PARAM_TYPE_NONE);
+
+	res = TEE_OpenTASession(&flash_uuid, 0, 0, NULL, &flash_session,
+							&ret_origin);
+	if (res != TEE_SUCCESS)
+		return res;
+
+	geo->capacity = SPI_END_OFFSET_ADDR - SPI_FWU_PACKAGE_OFFSET_ADDR;
+	geo->block_size = SPI_DEFAULT_BLOCK_SIZE;
+	geo->erase_size = SPI_DEFAULT_ERASE_SIZE;
+	geo->max_transfer = geo->capacity;
+
+	res = TEE_InvokeTACommand(flash_session, 0, FLASH_CMD_GET_INFO,
+							  param_types, params, &ret_origin);
+	if (TEE_SUCCESS == res)
+	{
+		if ((0 != params[0].value.a) && (0 != params[0].value.b) &&
+			(0 != params[1].value.a))
+		{
+			geo->block_size = params[0].value.a;
+			geo->erase_size = params[0].value.b;
+			if (geo->max_transfer > params[1].value.a)
+				geo->max_transfer = params[1].value.a;
+		}
+	}
+	else
+	{
+		/* Older flash PTA, keep the defaults. */
+		DMSG("FLASH_CMD_GET_INFO is not supported (0x%x)", res);
+	}
+	flash_erase_size = geo->erase_size;
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result spi_write(uint32_t offset, const void *buf, uint32_t size)
+{
+	TEE_Result res;
+	TEE_Param params[TEE_NUM_PARAMS] = {0};
+	uint32_t ret_origin = 0;
+
+	uint32_t param_types = TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT,
+										   TEE_PARAM_TYPE_MEMREF_INPUT,
+										   TEE_PARAM_TYPE_NONE,
+										   TEE_PARAM_TYPE_NONE);
+
+	params[0].value.a = SPI_FWU_PACKAGE_OFFSET_ADDR + offset;
+	params[1].memref.buffer = (void *)buf;
+	params[1].memref.size = size;
+
+	res = TEE_InvokeTACommand(flash_session, 0, FLASH_CMD_WRITE_SPI,
+							  param_types, params, &ret_origin);
+	if (res != TEE_SUCCESS)
+		EMSG("Failure when calling FLASH_CMD_WRITE_SPI");
+
+	return res;
+}
+
+static TEE_Result spi_erase(uint32_t offset, uint32_t size)
+{
+	TEE_Result res;
+	TEE_Param params[TEE_NUM_PARAMS] = {0};
+	uint32_t ret_origin = 0;
+
+	uint32_t param_types = TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT,
+										   TEE_PARAM_TYPE_NONE,
+										   TEE_PARAM_TYPE_NONE,
+										   TEE_PARAM_TYPE_NONE);
+
+	params[0].value.a = SPI_FWU_PACKAGE_OFFSET_ADDR + offset;
+	params[0].value.b = size;
+
+	res = TEE_InvokeTACommand(flash_session, 0, FLASH_CMD_ERASE_RANGE,
+							  param_types, params, &ret_origin);
+	if ((TEE_ERROR_NOT_IMPLEMENTED == res) || (TEE_ERROR_BAD_PARAMETERS == res))
+		res = TEE_ERROR_NOT_SUPPORTED;
+	else if (res != TEE_SUCCESS)
+		EMSG("Failure when calling FLASH_CMD_ERASE_RANGE");
+
+	return res;
+}
+
+static TEE_Result spi_program(uint32_t offset, const void *buf, uint32_t size)
+{
+	TEE_Result res;
+	TEE_Param params[TEE_NUM_PARAMS] = {0};
+	uint32_t ret_origin = 0;
+
+	uint32_t param_types = TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT,
+										   TEE_PARAM_TYPE_MEMREF_INPUT,
+										   TEE_PARAM_TYPE_NONE,
+										   TEE_PARAM_TYPE_NONE);
+
+	params[0].value.a = SPI_FWU_PACKAGE_OFFSET_ADDR + offset;
+	params[1].memref.buffer = (void *)buf;
+	params[1].memref.size = size;
+
+	res = TEE_InvokeTACommand(flash_session, 0, FLASH_CMD_PROGRAM_SPI,
+							  param_types, params, &ret_origin);
+	if ((TEE_ERROR_NOT_IMPLEMENTED == res) || (TEE_ERROR_BAD_PARAMETERS == res))
+	{
+		/* Older flash PTA, erase and write from a sector start, not to erase programmed data. */
+		DMSG("FLASH_CMD_PROGRAM_SPI is not supported (0x%x)", res);
+		if (0 != (offset % flash_erase_size))
+			return TEE_ERROR_NOT_SUPPORTED;
+		res = spi_write(offset, buf, size);
+	}
+	else if (res != TEE_SUCCESS)
+		EMSG("Failure when calling FLASH_CMD_PROGRAM_SPI");
+
+	return res;
+}
+
+static TEE_Result spi_read(uint32_t offset, void *buf, uint32_t size)
+{
+	TEE_Result res;
+	TEE_Param params[TEE_NUM_PARAMS] = {0};
+	uint32_t ret_origin = 0;
+
+	uint32_t param_types = TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT,
+										   TEE_PARAM_TYPE_MEMREF_OUTPUT,
+										   TEE_PARAM_TYPE_NONE,
+										   TEE_PARAM_TYPE_NONE);
+
+	params[0].value.a = SPI_FWU_PACKAGE_OFFSET_ADDR + offset;
+	params[1].memref.buffer = buf;
+	params[1].memref.size = size;
+
+	res = TEE_InvokeTACommand(flash_session, 0, FLASH_CMD_READ_SPI,
+							  param_types, params, &ret_origin);
+	if ((TEE_ERROR_NOT_IMPLEMENTED == res) || (TEE_ERROR_BAD_PARAMETERS == res))
+		res = TEE_ERROR_NOT_SUPPORTED;
+	else if (res != TEE_SUCCESS)
+		EMSG("Failure when calling FLASH_CMD_READ_SPI");
+
+	return res;
+}
+
+static TEE_Result spi_write_vec(const struct fwu_storage_seg *seg, uint32_t count,
+								void *const buf[2], const uint32_t buf_size[2], bool program)
+{
+	TEE_Result res;
+	TEE_Param params[TEE_NUM_PARAMS] = {0};
+	uint32_t ret_origin = 0;
+	struct flash_spi_seg vec[FWU_STORAGE_VEC_MAX];
+	uint32_t i;
+
+	uint32_t param_types = TEE_PARAM_TYPES(TEE_PARAM_TYPE_MEMREF_INPUT,
+										   TEE_PARAM_TYPE_MEMREF_INPUT,
+										   (NULL != buf[1]) ? TEE_PARAM_TYPE_MEMREF_INPUT : TEE_PARAM_TYPE_NONE,
+										   TEE_PARAM_TYPE_VALUE_INPUT);
+
+	COMPILE_TIME_ASSERT(FWU_STORAGE_VEC_MAX <= FLASH_SPI_VEC_MAX);
+
+	for (i = 0; i < count; i++)
+	{
+		vec[i].offset = SPI_FWU_PACKAGE_OFFSET_ADDR + seg[i].offset;
+		vec[i].buf = seg[i].buf;
+		vec[i].buf_offset = seg[i].buf_offset;
+		vec[i].size = seg[i].size;
+	}
+
+	params[0].memref.buffer = vec;
+	params[0].memref.size = count * sizeof(struct flash_spi_seg);
+	params[1].memref.buffer = buf[0];
+	params[1].memref.size = buf_size[0];
+	params[2].memref.buffer = buf[1];
+	params[2].memref.size = buf_size[1];
+	params[3].value.a = program ? FLASH_SPI_VEC_PROGRAM : 0;
+
+	res = TEE_InvokeTACommand(flash_session, 0, FLASH_CMD_WRITE_SPI_VEC,
+							  param_types, params, &ret_origin);
+	if ((TEE_ERROR_NOT_IMPLEMENTED == res) || (TEE_ERROR_BAD_PARAMETERS == res))
+		res = TEE_ERROR_NOT_SUPPORTED;
+	else if (res != TEE_SUCCESS)
+		EMSG("Failure when calling FLASH_CMD_WRITE_SPI_VEC");
+
+	return res;
+}
+
+static void spi_close(void)
+{
+	TEE_CloseTASession(flash_session);
+	flash_session = TEE_HANDLE_NULL;
+}
+
+static uint32_t object_storage_id;
+static TEE_ObjectHandle object_handle = TEE_HANDLE_NULL;   /* Open from the first write to close() */
+
+static TEE_Result object_open(uint32_t storage_id, uint32_t block_size, uint32_t max_transfer,
+							  struct fwu_storage_geometry *geo)
+{
+	object_storage_id = storage_id;
+
+	geo->capacity = STORAGE_OBJECT_CAPACITY;
+	geo->block_size = block_size;
+	geo->erase_size = block_size;
+	geo->max_transfer = max_transfer;
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result object_write(uint32_t offset, const void *buf, uint32_t size)
+{
+	TEE_Result res = TEE_SUCCESS;
+	uint32_t flags = TEE_DATA_FLAG_ACCESS_WRITE | TEE_DATA_FLAG_ACCESS_WRITE_META;
+
+	/* The object stays open for the other writes of the transfer. */
+	if (TEE_HANDLE_NULL == object_handle)
+	{
+		/* A write at the top of the staging area starts a new package. */
+		if (0 == offset)
+			res = TEE_CreatePersistentObject(object_storage_id, STORAGE_OBJECT_ID,
+											 strlen(STORAGE_OBJECT_ID), flags | TEE_DATA_FLAG_OVERWRITE,
+											 TEE_HANDLE_NULL, NULL, 0, &object_handle);
+		else
+			res = TEE_OpenPersistentObject(object_storage_id, STORAGE_OBJECT_ID,
+										   strlen(STORAGE_OBJECT_ID), flags, &object_handle);
+		if (TEE_SUCCESS != res)
+		{
+			EMSG("Can not open the staging object (0x%x)\n", res);
+			object_handle = TEE_HANDLE_NULL;
+			return res;
+		}
+	}
+
+	res = TEE_SeekObjectData(object_handle, (int32_t)offset, TEE_DATA_SEEK_SET);
+	if (TEE_SUCCESS == res)
+		res = TEE_WriteObjectData(object_handle, buf, size);
+	if (TEE_SUCCESS != res)
+		EMSG("Can not write the staging object (0x%x)\n", res);
+
+	return res;
+}
+
+static void object_close(void)
+{
+	if (TEE_HANDLE_NULL != object_handle)
+	{
+		TEE_CloseObject(object_handle);
+		object_handle = TEE_HANDLE_NULL;
+	}
+}
+
+static TEE_Result file_open(struct fwu_storage_geometry *geo)
+{
+	return object_open(TEE_STORAGE_PRIVATE_REE, REE_BLOCK_SIZE, REE_MAX_TRANSFER, geo);
+}
+
+static const struct fwu_storage_ops fwu_storage_backends[] = {
+	[FWU_STORAGE_SPI] = { FWU_STORAGE_SPI, "spi", spi_open, spi_write, spi_erase, spi_program, spi_read, spi_write_vec, spi_close },
+	[FWU_STORAGE_FILE] = { FWU_STORAGE_FILE, "file", file_open, object_write, NULL, NULL, NULL, NULL, object_close },
+};
+
+const struct fwu_storage_ops *fwu_storage_get(void)
+{
+	COMPILE_TIME_ASSERT(CFG_FWU_STORAGE < (sizeof(fwu_storage_backends) / sizeof(fwu_storage_backends[0])));
+
+	return &fwu_storage_backends[CFG_FWU_STORAGE];
+}
+
+TEE_Result fwu_storage_info(struct fwu_storage_geometry *geo)
+{
+	const struct fwu_storage_ops *storage = fwu_storage_get();
+	TEE_Result res;
+
+	res = storage->open(geo);
+	if (TEE_SUCCESS == res)
+		storage->close();
+
+#if CFG_FWU_AB
+	geo->capacity = FWU_SLOT_SIZE;
+#endif
+
+	return res;
+}
+
+/* Offset in the staging area of an access to the slot that is not active */
+static TEE_Result fwu_storage_slot_offset(uint32_t *offset, uint32_t size)
+{
+#if CFG_FWU_AB
+	TEE_Result res;
+	uint32_t base;
+
+	if ((FWU_SLOT_SIZE < *offset) || ((FWU_SLOT_SIZE - *offset) < size))
+	{
+		EMSG("The write data size exceeds the capacity of the slot");
+		return TEE_ERROR_GENERIC;
+	}
+
+	res = fwu_slot_target(&base);
+	if (TEE_SUCCESS != res)
+		return res;
+
+	*offset += base;
+#else
+	(void)offset;
+	(void)size;
+#endif
+
+	return TEE_SUCCESS;
+}
+
+enum fwu_storage_access {
+	FWU_STORAGE_WRITE,
+	FWU_STORAGE_PROGRAM,
+	FWU_STORAGE_READ,
+};
+
+static TEE_Result fwu_storage_transfer(uint32_t offset, void *buf, uint32_t size, enum fwu_storage_access access)
+{
+	const struct fwu_storage_ops *storage = fwu_storage_get();
+	struct fwu_storage_geometry geo;
+	uint8_t *data = buf;
+	uint32_t chunk, chunk_max;
+	uint32_t start, end;
+	TEE_Result res;
+
+	if ((FWU_STORAGE_READ == access) && (NULL == storage->read))
+		return TEE_ERROR_NOT_SUPPORTED;
+
+	res = storage->open(&geo);
+	if (TEE_SUCCESS != res)
+		return res;
+
+	if ((geo.capacity < offset) || ((geo.capacity - offset) < size))
+	{
+		EMSG("The data size exceeds the capacity of the %s storage", storage->name);
+		storage->close();
+		return TEE_ERROR_GENERIC;
+	}
+
+	/* The transfers end on erase boundaries, so that no sector is erased twice. */
+	chunk_max = fwu_storage_chunk_size(&geo, geo.max_transfer);
+	if (geo.max_transfer < chunk_max)
+	{
+		chunk_max = geo.max_transfer;
+
+		/* A transfer is smaller than a sector, erase the range once and program it. */
+		if ((FWU_STORAGE_READ != access) && (NULL != storage->erase))
+		{
+			if (NULL == storage->program)
+			{
+				EMSG("The %s storage can not write less than an erase sector", storage->name);
+				storage->close();
+				return TEE_ERROR_NOT_SUPPORTED;
+			}
+
+			if (FWU_STORAGE_WRITE == access)
+			{
+				start = offset - (offset % geo.erase_size);
+				end = offset + size;
+				if (0 != (end % geo.erase_size))
+					end += geo.erase_size - (end % geo.erase_size);
+
+				res = storage->erase(start, end - start);
+				if (TEE_SUCCESS != res)
+				{
+					storage->close();
+					return res;
+				}
+			}
+			access = FWU_STORAGE_PROGRAM;
+		}
+	}
+
+	while (0 < size)
+	{
+		chunk = chunk_max;
+		if ((geo.erase_size <= chunk) && (0 != (offset % geo.erase_size)))
+			chunk -= offset % geo.erase_size;
+		if (size < chunk)
+			chunk = size;
+
+		if (FWU_STORAGE_READ == access)
+			res = storage->read(offset, data, chunk);
+		else if ((FWU_STORAGE_PROGRAM == access) && (NULL != storage->program))
+			res = storage->program(offset, data, chunk);
+		else
+			res = storage->write(offset, data, chunk);
+		if (TEE_SUCCESS != res)
+			break;
+
+		if ((FWU_STORAGE_READ != access) && (NULL != fwu_storage_written))
+			*fwu_storage_written += chunk;
+
+		offset += chunk;
+		data += chunk;
+		size -= chunk;
+	}
+
+	storage->close();
+
+	return res;
+}
+
+TEE_Result fwu_storage_write(uint32_t offset, const void *buf, uint32_t size)
+{
+	TEE_Result res;
+
+	res = fwu_storage_slot_offset(&offset, size);
+	if (TEE_SUCCESS != res)
+		return res;
+
+	return fwu_storage_transfer(offset, (void *)buf, size, FWU_STORAGE_WRITE);
+}
+
+TEE_Result fwu_storage_program(uint32_t offset, const void *buf, uint32_t size)
+{
+	TEE_Result res;
+
+	res = fwu_storage_slot_offset(&offset, size);
+	if (TEE_SUCCESS != res)
+		return res;
+
+	return fwu_storage_transfer(offset, (void *)buf, size, FWU_STORAGE_PROGRAM);
+}
+
+/* Pass the segments to the backend in calls of FWU_STORAGE_VEC_MAX segments and max_transfer bytes */
+static TEE_Result fwu_storage_vec_batches(const struct fwu_storage_ops *storage, const struct fwu_storage_geometry *geo,
+										  const struct fwu_storage_seg *seg, uint32_t count,
+										  void *const buf[2], const uint32_t buf_size[2], bool program)
+{
+	TEE_Result res = TEE_SUCCESS;
+	struct fwu_storage_seg batch[FWU_STORAGE_VEC_MAX];
+	struct fwu_storage_seg cur;
+	uint32_t n = 0;
+	uint32_t total = 0;
+	uint32_t chunk;
+	uint32_t i = 0;
+
+	if (0 == count)
+		return TEE_SUCCESS;
+
+	cur = seg[0];
+	while (TEE_SUCCESS == res)
+	{
+		/* A segment larger than the rest of the call is split. */
+		chunk = cur.size;
+		if ((geo->max_transfer - total) < chunk)
+			chunk = geo->max_transfer - total;
+
+		if (0 != chunk)
+		{
+			batch[n] = cur;
+			batch[n].size = chunk;
+			res = fwu_storage_slot_offset(&batch[n].offset, chunk);
+			n++;
+			total += chunk;
+			cur.offset += chunk;
+			cur.buf_offset += chunk;
+			cur.size -= chunk;
+		}
+
+		if ((0 == cur.size) && (++i < count))
+			cur = seg[i];
+
+		if ((TEE_SUCCESS == res) && ((i == count) || (FWU_STORAGE_VEC_MAX == n) || (geo->max_transfer == total)))
+		{
+			res = storage->write_vec(batch, n, buf, buf_size, program);
+			if ((TEE_SUCCESS == res) && (NULL != fwu_storage_written))
+				*fwu_storage_written += total;
+			n = 0;
+			total = 0;
+			if (i == count)
+				break;
+		}
+	}
+
+	return res;
+}
+
+TEE_Result fwu_storage_write_vec(const struct fwu_storage_seg *seg, uint32_t count,
+								 void *const buf[2], const uint32_t buf_size[2], bool program)
+{
+	const struct fwu_storage_ops *storage = fwu_storage_get();
+	struct fwu_storage_geometry geo;
+	uint32_t start, end;
+	uint32_t total = 0;
+	uint32_t i;
+	TEE_Result res;
+
+	if ((NULL == storage->write_vec) || (0 == count))
+		return TEE_ERROR_NOT_SUPPORTED;
+
+	for (i = 0; i < count; i++)
+	{
+		if ((1 < seg[i].buf) || (NULL == buf[seg[i].buf]) || (0 == seg[i].size) ||
+			(buf_size[seg[i].buf] < seg[i].buf_offset) || ((buf_size[seg[i].buf] - seg[i].buf_offset) < seg[i].size) ||
+			((0 != i) && (seg[i].offset < (seg[i - 1].offset + seg[i - 1].size))))
+			return TEE_ERROR_BAD_PARAMETERS;
+		total += seg[i].size;
+	}
+
+	res = storage->open(&geo);
+	if (TEE_SUCCESS != res)
+		return res;
+
+	start = seg[0].offset;
+	end = seg[count - 1].offset + seg[count - 1].size;
+	if (geo.capacity < end)
+	{
+		EMSG("The data size exceeds the capacity of the %s storage", storage->name);
+		storage->close();
+		return TEE_ERROR_GENERIC;
+	}
+
+	/*
+	 * The backend merges the erase sectors of the segments of one call.
+	 * Over several calls, a sector split between two calls would be erased
+	 * twice, so the whole range is erased first.
+	 */
+	if ((!program) && ((FWU_STORAGE_VEC_MAX < count) || (geo.max_transfer < total)))
+	{
+		storage->close();
+		if (NULL == storage->erase)
+			return TEE_ERROR_NOT_SUPPORTED;
+
+		start -= start % geo.erase_size;
+		if (0 != (end % geo.erase_size))
+			end += geo.erase_size - (end % geo.erase_size);
+		if (geo.capacity < end)
+			end = geo.capacity;
+
+		res = fwu_storage_erase(start, end - start);
+		if (TEE_SUCCESS != res)
+			return res;
+
+		program = true;
+		res = storage->open(&geo);
+		if (TEE_SUCCESS != res)
+			return res;
+	}
+
+	res = fwu_storage_vec_batches(storage, &geo, seg, count, buf, buf_size, program);
+	storage->close();
+
+	return res;
+}
+
+TEE_Result fwu_storage_area_read(uint32_t offset, void *buf, uint32_t size)
+{
+	return fwu_storage_transfer(offset, buf, size, FWU_STORAGE_READ);
+}
+
+TEE_Result fwu_storage_area_write(uint32_t offset, const void *buf, uint32_t size)
+{
+	return fwu_storage_transfer(offset, (void *)buf, size, FWU_STORAGE_WRITE);
+}
+
+TEE_Result fwu_storage_area_compare(uint32_t offset, const void *buf, uint32_t size, void *tmp, uint32_t tmp_size)
+{
+	const struct fwu_storage_ops *storage = fwu_storage_get();
+	struct fwu_storage_geometry geo;
+	const uint8_t *data = buf;
+	uint32_t chunk, chunk_max;
+	TEE_Result res;
+
+	if (NULL == storage->read)
+		return TEE_ERROR_NOT_SUPPORTED;
+
+	res = storage->open(&geo);
+	if (TEE_SUCCESS != res)
+		return res;
+
+	if ((geo.capacity < offset) || ((geo.capacity - offset) < size))
+	{
+		EMSG("The data size exceeds the capacity of the %s storage", storage->name);
+		storage->close();
+		return TEE_ERROR_GENERIC;
+	}
+
+	chunk_max = (geo.max_transfer < tmp_size) ? geo.max_transfer : tmp_size;
+	while (0 < size)
+	{
+		chunk = (chunk_max < size) ? chunk_max : size;
+
+		res = storage->read(offset, tmp, chunk);
+		if (TEE_SUCCESS != res)
+			break;
+
+		if (0 != memcmp(tmp, data, chunk))
+		{
+			EMSG("The %s storage does not match the written data at 0x%x.\n", storage->name, offset);
+			res = TEE_ERROR_GENERIC;
+			break;
+		}
+
+		offset += chunk;
+		data += chunk;
+		size -= chunk;
+	}
+
+	storage->close();
+
+	return res;
+}
+
+TEE_Result fwu_storage_erase(uint32_t offset, uint32_t size)
+{
+	const struct fwu_storage_ops *storage = fwu_storage_get();
+	struct fwu_storage_geometry geo;
+	TEE_Result res;
+
+	if (NULL == storage->erase)
+		return TEE_ERROR_NOT_SUPPORTED;
+
+	res = fwu_storage_slot_offset(&offset, size);
+	if (TEE_SUCCESS != res)
+		return res;
+
+	res = storage->open(&geo);
+	if (TEE_SUCCESS != res)
+		return res;
+
+	if ((0 != (offset % geo.erase_size)) || (0 != (size % geo.erase_size)) ||
+		(geo.capacity < offset) || ((geo.capacity - offset) < size))
+		res = TEE_ERROR_BAD_PARAMETERS;
+	else
+		res = storage->erase(offset, size);
+
+	storage->close();
+
+	return res;
+}
+
+void fwu_storage_set_progress(uint32_t *written)
+{
+	fwu_storage_written = written;
+}
+
+uint32_t fwu_storage_chunk_size(const struct fwu_storage_geometry *geo, uint32_t size)
+{
+	if (size < geo->erase_size)
+		return geo->erase_size;
+
+	return size - (size % geo->erase_size);
+}
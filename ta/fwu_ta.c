@@ -33,8 +33,16 @@
 
 #include "fwu_ta.h"
 #include "rzg_firmware_image_package.h"
-#include "flash_pta.h"
 #include "tsip_pta.h"
+#include "fwu_arena.h"
+#include "fwu_storage.h"
+#include "fwu_board.h"
+#include "fwu_layout.h"
+#include "fwu_component.h"
+#include "fwu_slot.h"
+#include "fwu_digest.h"
+#include "fwu_copy.h"
+#include "user_ta_header_defines.h"
 
 /******************************************************************************/
 /* Macros                                                                     */
@@ -45,26 +53,93 @@
 #define FIP_FLAGS_END_OF_FILE (0x8000)
 #endif
 
-#define INPUT_KEYRING_SIZE (0x2B0)
-#define OUTPUT_KEYRING_SIZE (0x510)
+#define UPDATE_BOOT_DATA_MAX FWU_BOARD_TSIP_BATCH_MAX
 
-#define SPI_FWU_PACKAGE_OFFSET_ADDR (0x3000000)
-#define SPI_END_OFFSET_ADDR (0x4000000)
+/* Time-budgeted update (FWU_CMD_UPDATE_STEP) */
+#define STEP_BUDGET_DEFAULT_MS (100)
+#define STEP_WRITE_CHUNK_SIZE FWU_BOARD_WRITE_CHUNK_SIZE
 
-#define UPDATE_BOOT_DATA_MAX 16
+/* Plain data written from the input by FWU_CMD_FIRMWARE_UPDATE instead of copied */
+#define FWU_VEC_DATA_MAX (32)
+#define FWU_VEC_MIN_SIZE (4 * 1024)
 
 /******************************************************************************/
 /* Typedefs                                                                   */
 /******************************************************************************/
 /* Argument */
 
+/* Session context */
+/* Erase of the staging area ahead of the write */
+struct fwu_preerase {
+	bool enabled;
+	uint32_t erase_size;
+	uint32_t erased;             /* Bytes erased from the top of the staging area */
+	struct fwu_storage_geometry geo;
+};
+
+struct fwu_session {
+	uint32_t section_updates;   /* Number of sections updated by this session */
+
+	/* Cursor of the time-budgeted update */
+	uint32_t step_stage;        /* FWU_STAGE_xxx */
+	uint32_t step_in_size;
+	uint32_t step_out_size;
+	uint32_t step_load_pos;
+	uint32_t step_out_pos;
+	uint32_t step_written;
+	uint32_t step_chunk;         /* Write size from the storage geometry */
+	uint8_t (*step_digest)[FIP_DIR_DIGEST_SIZE];    /* SHA-256 of each write chunk of the output */
+	struct fwu_preerase step_erase;
+
+	/* Packages queued by FWU_CMD_BATCH_ADD */
+	uint32_t batch_count;
+	uint32_t batch_out_size;     /* Combined output size */
+	uint32_t batch_tail;         /* Offset of the last FIP header in the output */
+	fip_toc_header_t batch_tail_hdr;        /* Last FIP header of the output */
+	TEE_OperationHandle batch_digest;       /* SHA-256 of the output, END_OF_FILE cleared */
+};
+
+/*
+ * Plain data of FWU_CMD_FIRMWARE_UPDATE that is written to the storage
+ * from the input buffer (buf 0) instead of being copied to the work buffer
+ */
+struct fwu_vec {
+	uintptr_t in_addr;
+	uintptr_t out_addr;
+	uint32_t count;
+	struct fwu_storage_seg *seg;    /* FWU_VEC_DATA_MAX entries */
+};
+
+/* Place of the output of a FIP */
+struct fip_out_place {
+	uint32_t offset;            /* Offset of the FIP in the output of the package */
+	uint32_t align;             /* Alignment of the data, from the package directory */
+	bool crc;                   /* The plain ToC entries hold a CRC-32, from the package directory */
+};
+
+/* Section update shared by all sessions */
+struct fwu_txn {
+	struct fwu_session *owner;
+	uint32_t count;
+	uint32_t work_size;
+	uint32_t done;              /* Bitmap of the updated sections */
+	struct fwu_section section[FWU_SECTION_MAX];
+	bool has_digest;            /* The package has a directory */
+	uint32_t digest_shift;      /* Log2 of the digest segment size of the directory */
+	struct fip_out_place place; /* Alignment and CRC flag of the package, the offset is per section */
+	uint8_t digest[FWU_SECTION_MAX][FIP_DIR_DIGEST_SIZE];
+	uint8_t out_digest[FWU_SECTION_MAX][FIP_DIR_DIGEST_SIZE];  /* SHA-256 of the updated sections */
+};
+
 /******************************************************************************/
 /* Static Function Prototypes                                                 */
 /******************************************************************************/
 
-static uuid_t uuid_null;
+static const uuid_t uuid_null;
+static struct fwu_txn fwu_txn;
+static struct fwu_vec *fwu_vec;     /* Set while FWU_CMD_FIRMWARE_UPDATE updates the FIPs */
+static struct fwu_progress *fwu_progress_page;  /* Set while FWU_CMD_FIRMWARE_UPDATE runs */
 static const TEE_UUID tsip_uuid = TSIP_UUID;
-static const TEE_UUID flash_uuid = FLASH_UUID;
 
 /******************************************************************************/
 /* Global Variables                                                           */
@@ -103,7 +178,57 @@ static TEE_Result fip_plain_out_size(uintptr_t fip_load_addr, uintptr_t fip_load
 	return TEE_SUCCESS;
 }
 
-static TEE_Result fip_keyring_out_size(uintptr_t fip_load_addr, uintptr_t fip_load_max, uint32_t *load_size, uint32_t *out_size)
+/* Offset in the staging area of the output at pos from the top of the FIP */
+static uint32_t fip_out_staging_offset(const struct fip_out_place *place, uint32_t pos)
+{
+	return FWU_BOARD_SPI_PACKAGE_OFFSET + place->offset + pos;
+}
+
+/* Pad the output up to the alignment of its offset in the staging area */
+static TEE_Result fip_out_pad(uintptr_t fip_out_addr, uintptr_t fip_out_max, uintptr_t *data_addr,
+							  const struct fip_out_place *place)
+{
+	uint32_t pos = fip_out_staging_offset(place, *data_addr - fip_out_addr);
+	uintptr_t pad_end = *data_addr + (FIP_OUT_ALIGN_UP(pos, place->align) - pos);
+
+	if ((fip_out_max + 1) < pad_end)
+	{
+		EMSG("The copy data size exceeds the capacity of the temporary ram area.\n");
+		return TEE_ERROR_GENERIC;
+	}
+
+	memset((void *)*data_addr, FIP_OUT_PAD_BYTE, pad_end - *data_addr);
+	*data_addr = pad_end;
+
+	return TEE_SUCCESS;
+}
+
+/*
+ * Output size of a keyring or re-encrypted FIP. The data follow the ToC in
+ * the order of the entries and are aligned as fip_out_pad() does.
+ */
+static uint32_t fip_reenc_out_size(uint32_t fip_name, fip_toc_entry_t *toc_e_top, fip_toc_entry_t *toc_e_end,
+								   const struct fip_out_place *place)
+{
+	fip_toc_entry_t *toc_e;
+	uint32_t top, pos;
+	uint32_t data_size;
+
+	top = fip_out_staging_offset(place, 0);
+	pos = top + sizeof(fip_toc_header_t) + ((toc_e_end + 1) - toc_e_top) * sizeof(fip_toc_entry_t);
+
+	for (toc_e = toc_e_top; toc_e < toc_e_end; toc_e++)
+	{
+		data_size = fwu_layout_entry_size(fip_name, toc_e->size, toc_e == toc_e_top);
+		if (0 != data_size)
+			pos = FIP_OUT_ALIGN_UP(pos, place->align) + data_size;
+	}
+
+	return FIP_OUT_ALIGN_UP(pos, place->align) - top;
+}
+
+static TEE_Result fip_keyring_out_size(uintptr_t fip_load_addr, uintptr_t fip_load_max, const struct fip_out_place *place,
+									   uint32_t *load_size, uint32_t *out_size)
 {
 	fip_toc_entry_t *toc_e;
 	fip_toc_entry_t *toc_e_end = NULL;
@@ -127,9 +252,6 @@ static TEE_Result fip_keyring_out_size(uintptr_t fip_load_addr, uintptr_t fip_lo
 			return TEE_ERROR_GENERIC;
 		}
 
-		if (INPUT_KEYRING_SIZE <= toc_e->size)
-			*out_size += (OUTPUT_KEYRING_SIZE + sizeof(fip_toc_entry_t));
-
 		toc_e++;
 	}
 
@@ -140,12 +262,14 @@ static TEE_Result fip_keyring_out_size(uintptr_t fip_load_addr, uintptr_t fip_lo
 	}
 
 	*load_size = toc_e_end->offset_address;
-	*out_size += (sizeof(fip_toc_entry_t) + sizeof(fip_toc_header_t));
+	*out_size = fip_reenc_out_size(TOC_HEADER_NAME_KEYRING,
+								   (fip_toc_entry_t *)(fip_load_addr + sizeof(fip_toc_header_t)), toc_e_end, place);
 
 	return TEE_SUCCESS;
 }
 
-static TEE_Result fip_encdata_out_size(uintptr_t fip_load_addr, uintptr_t fip_load_max, uint32_t *load_size, uint32_t *out_size)
+static TEE_Result fip_encdata_out_size(uintptr_t fip_load_addr, uintptr_t fip_load_max, const struct fip_out_place *place,
+									   uint32_t *load_size, uint32_t *out_size)
 {
 	fip_toc_entry_t *toc_e;
 	fip_toc_entry_t *toc_e_top;
@@ -164,24 +288,6 @@ static TEE_Result fip_encdata_out_size(uintptr_t fip_load_addr, uintptr_t fip_lo
 			toc_e_end = toc_e;
 			break;
 		}
-
-		if (0 != toc_e->size)
-		{
-			if (toc_e == toc_e_top)
-			{
-				/*output_size = 8(Re-encrypted size) + input_size + 16(MAC size) + 48(boot header) */
-				*out_size += (sizeof(fip_toc_entry_t) + (toc_e->size + 72));
-			}
-			else
-			{
-				/*output_size = 8(Re-encrypted size) + input_size + 16(MAC size) */
-				*out_size += (sizeof(fip_toc_entry_t) + (toc_e->size + 24));
-			}
-		}
-		else
-		{
-			*out_size += sizeof(fip_toc_entry_t);
-		}
 		toc_e++;
 	}
 
@@ -192,37 +298,263 @@ static TEE_Result fip_encdata_out_size(uintptr_t fip_load_addr, uintptr_t fip_lo
 	}
 
 	*load_size = toc_e_end->offset_address;
-	*out_size += (sizeof(fip_toc_entry_t) + sizeof(fip_toc_header_t));
+	*out_size = fip_reenc_out_size(TOC_HEADER_NAME_BOOT_FW, toc_e_top, toc_e_end, place);
 
 	return TEE_SUCCESS;
 }
 
-static TEE_Result fwu_calc_work_size(uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
+/* Get the package directory at fip_load_addr, *dir is NULL if there is none */
+static TEE_Result fip_dir_get(uintptr_t fip_load_addr, uint32_t size, const fip_dir_header_t **dir)
+{
+	const fip_dir_header_t *hdr = (const fip_dir_header_t *)fip_load_addr;
+
+	*dir = NULL;
+	if ((sizeof(fip_toc_header_t) > size) || (TOC_HEADER_NAME_DIRECTORY != hdr->toc.name))
+		return TEE_SUCCESS;
+
+	if ((sizeof(fip_dir_header_t) > size) ||
+		(0 == hdr->count) || (FIP_DIR_ENTRY_MAX < hdr->count) ||
+		((sizeof(fip_dir_header_t) + (hdr->count * sizeof(fip_dir_entry_t))) != hdr->size) ||
+		(hdr->size > size))
+	{
+		EMSG("Invalid package directory\n");
+		return TEE_ERROR_GENERIC;
+	}
+
+	*dir = hdr;
+
+	return TEE_SUCCESS;
+}
+
+/*
+ * Alignment of the updated FIP data and CRC flag of the package at
+ * fip_load_addr, from its directory. The alignment must divide the offset of
+ * the staging area and of the slots, so that it does not depend on the slot
+ * the package is written to.
+ */
+static TEE_Result fip_out_layout(uintptr_t fip_load_addr, uint32_t size, struct fip_out_place *place)
 {
 	TEE_Result res;
-	uintptr_t fip_load_addr, fip_load_max;
-	uint32_t load_size, fip_name, fip_flags;
-	uint32_t fip_out_size;
+	const fip_dir_header_t *dir;
+	uint32_t shift = 0;
 
-	uint32_t exp_type = TEE_PARAM_TYPES(TEE_PARAM_TYPE_MEMREF_INPUT,
-										TEE_PARAM_TYPE_VALUE_OUTPUT,
-										TEE_PARAM_TYPE_NONE,
-										TEE_PARAM_TYPE_NONE);
+	res = fip_dir_get(fip_load_addr, size, &dir);
+	if (TEE_SUCCESS != res)
+		return res;
 
-	DMSG("has been called");
+	if (NULL != dir)
+		shift = fwu_layout_align_shift(dir);
 
-	if (type != exp_type)
+	if ((FIP_DIR_ALIGN_SHIFT_MAX < shift) ||
+		(0 != (FWU_BOARD_SPI_PACKAGE_OFFSET & ((1U << shift) - 1))) ||
+		(CFG_FWU_AB && (0 != (FWU_SLOT_SIZE & ((1U << shift) - 1)))))
+	{
+		EMSG("Invalid FIP data alignment\n");
+		return TEE_ERROR_GENERIC;
+	}
+
+	place->align = 1U << shift;
+	place->crc = (NULL != dir) && (0 != ((dir->toc.flags >> 32) & FIP_DIR_FLAGS_CRC));
+
+	return TEE_SUCCESS;
+}
+
+/* The directory FIP is only read by the TA, it has no output. */
+static TEE_Result fip_dir_skip(uintptr_t fip_load_addr, uintptr_t fip_load_max, uint32_t *load_size, uint32_t *out_size)
+{
+	TEE_Result res;
+	const fip_dir_header_t *dir;
+
+	res = fip_dir_get(fip_load_addr, (fip_load_max + 1) - fip_load_addr, &dir);
+	if (TEE_SUCCESS != res)
+		return res;
+
+	/* The directory describes the FIPs after it, there must be at least one. */
+	if ((0 != ((dir->toc.flags >> 32) & FIP_FLAGS_END_OF_FILE)) ||
+		((dir->size + sizeof(fip_toc_header_t)) >= ((fip_load_max + 1) - fip_load_addr)))
+	{
+		EMSG("The package directory is not followed by a FIP.\n");
+		return TEE_ERROR_GENERIC;
+	}
+
+	*load_size = dir->size;
+	*out_size = 0;
+
+	return TEE_SUCCESS;
+}
+
+/* Check the sizes of the FIP at offset, computed from its ToC, against the directory entry */
+static TEE_Result fip_dir_check(const fip_dir_header_t *dir, uint32_t index, uint32_t offset, uint32_t size,
+								uint32_t fip_name, uint32_t load_size, uint32_t out_size)
+{
+	const fip_dir_entry_t *dir_e = (const fip_dir_entry_t *)(dir + 1) + index;
+
+	if ((dir->count <= index) || (dir_e->offset != offset) || (dir_e->name != fip_name) ||
+		(dir_e->size != load_size) || (dir_e->out_size != out_size) || ((size - offset) < dir_e->size))
+	{
+		EMSG("The package directory does not match the package.\n");
+		return TEE_ERROR_GENERIC;
+	}
+
+	return TEE_SUCCESS;
+}
+
+/* Check all FIPs against the segmented directory with the segment digests computed by the host */
+static TEE_Result fip_dir_verify(uintptr_t fip_load_addr, uint32_t size, const uint8_t *list, uint32_t list_size)
+{
+	TEE_Result res;
+	const fip_dir_header_t *dir;
+	const fip_dir_entry_t *dir_e;
+	uint32_t shift, fip_list_size;
+	uint32_t pos = 0;
+	uint32_t i;
+
+	res = fip_dir_get(fip_load_addr, size, &dir);
+	if (TEE_SUCCESS != res)
+		return res;
+
+	if ((NULL == dir) || (0 == fwu_layout_segment_shift(dir)))
 	{
+		EMSG("The package has no segmented directory.\n");
 		return TEE_ERROR_BAD_PARAMETERS;
 	}
 
-	p[1].value.a = 0;
+	shift = fwu_layout_segment_shift(dir);
+	dir_e = (const fip_dir_entry_t *)(dir + 1);
+	for (i = 0; i < dir->count; i++)
+	{
+		if ((size < dir_e[i].offset) || ((size - dir_e[i].offset) < dir_e[i].size))
+		{
+			EMSG("The package directory does not match the package.\n");
+			return TEE_ERROR_GENERIC;
+		}
+
+		fip_list_size = fwu_layout_segments(dir_e[i].size, shift) * FIP_DIR_DIGEST_SIZE;
+		if ((list_size - pos) < fip_list_size)
+			return TEE_ERROR_BAD_PARAMETERS;
 
-	if (0 == p[0].memref.size)
+		res = fwu_digest_check((const void *)(fip_load_addr + dir_e[i].offset), dir_e[i].size,
+							   dir_e[i].digest, shift, list + pos, fip_list_size);
+		if (TEE_SUCCESS != res)
+			return res;
+
+		pos += fip_list_size;
+	}
+
+	return (list_size == pos) ? TEE_SUCCESS : TEE_ERROR_BAD_PARAMETERS;
+}
+
+static TEE_Result fip_calc_out_size(uint32_t fip_name, uintptr_t fip_load_addr, uintptr_t fip_load_max,
+									const struct fip_out_place *place, uint32_t *load_size, uint32_t *out_size)
+{
+	TEE_Result res;
+
+	switch (fip_name)
+	{
+		case TOC_HEADER_NAME_PLAIN:
+		{
+			res = fip_plain_out_size(fip_load_addr, fip_load_max, load_size, out_size);
+			break;
+		}
+		case TOC_HEADER_NAME_KEYRING:
+		{
+			res = fip_keyring_out_size(fip_load_addr, fip_load_max, place, load_size, out_size);
+			break;
+		}
+		case TOC_HEADER_NAME_BOOT_FW:
+		case TOC_HEADER_NAME_NS_BL2U:
+		{
+			res = fip_encdata_out_size(fip_load_addr, fip_load_max, place, load_size, out_size);
+			break;
+		}
+		case TOC_HEADER_NAME_DIRECTORY:
+		{
+			res = fip_dir_skip(fip_load_addr, fip_load_max, load_size, out_size);
+			break;
+		}
+		default:
+		{
+			res = TEE_ERROR_GENERIC;
+			EMSG("Unknown FIP name\n");
+			break;
+		}
+	}
+
+	return res;
+}
+
+/*
+ * Add the ToC entries of the FIP to stats (FWU_COMP_MAX entries) by component.
+ * With CFG_FWU_STRICT_COMPONENTS, unknown UUIDs are only accepted in plain
+ * FIPs, otherwise they are counted as FWU_COMP_UNKNOWN.
+ */
+static TEE_Result fip_components(uint32_t fip_name, uintptr_t fip_load_addr, uintptr_t fip_load_max, struct fwu_component_stats *stats)
+{
+	fip_toc_entry_t *toc_e;
+	fip_toc_entry_t *toc_e_top;
+	uint32_t id;
+
+	if (TOC_HEADER_NAME_DIRECTORY == fip_name)
 		return TEE_SUCCESS;
 
-	fip_load_addr = (uintptr_t)p[0].memref.buffer;
-	fip_load_max = fip_load_addr + p[0].memref.size - 1;
+	toc_e_top = (fip_toc_entry_t *)(fip_load_addr + sizeof(fip_toc_header_t));
+
+	for (toc_e = toc_e_top; (uintptr_t)(toc_e + 1) <= (fip_load_max + 1); toc_e++)
+	{
+		if (0 == memcmp(&toc_e->uuid, &uuid_null, sizeof(uuid_t)))
+			return TEE_SUCCESS;
+
+		id = fwu_component_id(&toc_e->uuid);
+		if (CFG_FWU_STRICT_COMPONENTS && (FWU_COMP_UNKNOWN == id) && (TOC_HEADER_NAME_PLAIN != fip_name))
+		{
+			EMSG("Unknown component in the ToC entry %u\n", (uint32_t)(toc_e - toc_e_top));
+			return TEE_ERROR_GENERIC;
+		}
+
+		stats[id].count++;
+		stats[id].in_bytes += toc_e->size;
+		stats[id].out_bytes += fwu_layout_entry_size(fip_name, toc_e->size, toc_e == toc_e_top);
+	}
+
+	EMSG("FIP does not have the ToC terminator entry.\n");
+	return TEE_ERROR_GENERIC;
+}
+
+static TEE_Result fwu_scan_package(uintptr_t fip_load_addr, uint32_t size, struct fwu_section *section, uint32_t *count, uint32_t *work_size, uint32_t *single_size)
+{
+	TEE_Result res;
+	uintptr_t fip_load_top = fip_load_addr;
+	uintptr_t fip_load_max;
+	uint32_t load_size, fip_name, fip_flags;
+	uint32_t fip_out_size;
+	uint32_t in_pos = 0;
+	uint32_t out_end;
+	uint32_t headroom = 0;
+	const fip_dir_header_t *dir;
+	uint32_t dir_index = 0;
+	struct fip_out_place place;
+
+	*count = 0;
+	*work_size = 0;
+	*single_size = 0;
+
+	if (0 == size)
+		return TEE_SUCCESS;
+
+	fip_load_max = fip_load_addr + size - 1;
+
+	/* With a directory, the sizes of each FIP must match its entry. */
+	res = fip_dir_get(fip_load_addr, size, &dir);
+	if (TEE_SUCCESS == res)
+		res = fip_out_layout(fip_load_addr, size, &place);
+	if (TEE_SUCCESS != res)
+		return res;
+
+	if (NULL != dir)
+	{
+		fip_load_addr += dir->size;
+		in_pos = dir->size;
+	}
 
 	do
 	{
@@ -236,34 +568,45 @@ static TEE_Result fwu_calc_work_size(uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
 		fip_name = ((fip_toc_header_t *)fip_load_addr)->name;
 		fip_flags = ((fip_toc_header_t *)fip_load_addr)->flags >> 32;
 
-		switch (fip_name)
+		place.offset = *work_size;
+		res = fip_calc_out_size(fip_name, fip_load_addr, fip_load_max, &place, &load_size, &fip_out_size);
+		if ((TEE_SUCCESS == res) && (NULL != dir))
+			res = fip_dir_check(dir, dir_index++, fip_load_addr - fip_load_top, size,
+								fip_name, load_size, fip_out_size);
+		if (TEE_SUCCESS == res)
 		{
-			case TOC_HEADER_NAME_PLAIN:
-			{
-				res = fip_plain_out_size(fip_load_addr, fip_load_max, &load_size, &fip_out_size);
-				break;
-			}
-			case TOC_HEADER_NAME_KEYRING:
-			{
-				res = fip_keyring_out_size(fip_load_addr, fip_load_max, &load_size, &fip_out_size);
-				break;
-			}
-			case TOC_HEADER_NAME_BOOT_FW:
-			case TOC_HEADER_NAME_NS_BL2U:
+			if (NULL != section)
 			{
-				res = fip_encdata_out_size(fip_load_addr, fip_load_max, &load_size, &fip_out_size);
-				break;
-			}
-			default:
-			{
-				res = TEE_ERROR_GENERIC;
-				EMSG("Unknown FIP name\n");
-				break;
+				if (FWU_SECTION_MAX <= *count)
+				{
+					EMSG("The number of FIPs exceeds %d.\n", FWU_SECTION_MAX);
+					res = TEE_ERROR_GENERIC;
+					break;
+				}
+
+				section[*count].name = fip_name;
+				section[*count].in_offset = fip_load_addr - fip_load_top;
+				section[*count].in_size = load_size;
+				section[*count].out_offset = *work_size;
+				section[*count].out_size = fip_out_size;
 			}
-		}
-		if (TEE_SUCCESS == res)
-		{
-			p[1].value.a += fip_out_size;
+			(*count)++;
+
+			/*
+			 * In-place layout: a plain FIP is moved as a whole, so its output
+			 * must only start at or before its input. The other FIPs read all
+			 * of their input while writing, so their output must end before it.
+			 */
+			if (TOC_HEADER_NAME_PLAIN == fip_name)
+				out_end = *work_size;
+			else
+				out_end = *work_size + fip_out_size;
+
+			if ((out_end > in_pos) && ((out_end - in_pos) > headroom))
+				headroom = out_end - in_pos;
+
+			*work_size += fip_out_size;
+			in_pos += load_size;
 			fip_load_addr += load_size;
 
 			if (0 != (fip_flags & FIP_FLAGS_END_OF_FILE))
@@ -271,10 +614,57 @@ static TEE_Result fwu_calc_work_size(uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
 				DMSG("The FIP platform flag END_OF_FILE has been detected.\n");
 				break;
 			}
+
+			if ((NULL != dir) && (dir->count == dir_index))
+				break;
 		}
 
 	} while ((TEE_SUCCESS == res) && (fip_load_addr < fip_load_max));
 
+	if ((TEE_SUCCESS == res) && (NULL != dir) && (dir->count != dir_index))
+	{
+		EMSG("The package directory does not match the package.\n");
+		res = TEE_ERROR_GENERIC;
+	}
+
+	if (TEE_SUCCESS == res)
+	{
+		/* The whole output must fit in the single buffer as well. */
+		if (*work_size > (headroom + size))
+			headroom = *work_size - size;
+
+		headroom = (headroom + (INPLACE_ALIGN - 1)) & ~(uint32_t)(INPLACE_ALIGN - 1);
+		*single_size = headroom + size;
+	}
+
+	return res;
+}
+
+static TEE_Result fwu_calc_work_size(uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
+{
+	TEE_Result res;
+	uint32_t count;
+
+	uint32_t exp_type = TEE_PARAM_TYPES(TEE_PARAM_TYPE_MEMREF_INPUT,
+										TEE_PARAM_TYPE_VALUE_OUTPUT,
+										TEE_PARAM_TYPE_NONE,
+										TEE_PARAM_TYPE_NONE);
+
+	DMSG("has been called");
+
+	if (type != exp_type)
+	{
+		return TEE_ERROR_BAD_PARAMETERS;
+	}
+
+	res = fwu_scan_package((uintptr_t)p[0].memref.buffer, p[0].memref.size, NULL, &count,
+						   &p[1].value.a, &p[1].value.b);
+	if (TEE_SUCCESS != res)
+	{
+		p[1].value.a = 0;
+		p[1].value.b = 0;
+	}
+
 	return res;
 }
 
@@ -336,7 +726,55 @@ static TEE_Result fip_copy_toc_hdr(uintptr_t fip_load_addr, uintptr_t fip_load_m
 	return TEE_SUCCESS;
 }
 
-static TEE_Result fip_plain_update(uintptr_t fip_load_addr, uint32_t *load_size, uintptr_t fip_out_addr, uint32_t *out_size)
+/* A plain ToC entry has a CRC-32 only in a package with FIP_DIR_FLAGS_CRC */
+static bool fip_plain_has_crc(const fip_toc_entry_t *toc_e, bool dir_crc)
+{
+	return dir_crc && (0 != (toc_e->flags & TOC_ENTRY_FLAGS_CRC_VALID));
+}
+
+/* Check the CRC-32 of the data of a plain ToC entry, if it has one */
+static TEE_Result fip_plain_crc_check(const fip_toc_entry_t *toc_e, bool dir_crc, uint32_t crc)
+{
+	if (fip_plain_has_crc(toc_e, dir_crc) &&
+		((uint32_t)(toc_e->flags & TOC_ENTRY_FLAGS_CRC_MASK) != crc))
+	{
+		EMSG("The CRC of the ToC entry data does not match.\n");
+		return TEE_ERROR_SECURITY;
+	}
+
+	return TEE_SUCCESS;
+}
+
+/* Write the plain data at data_addr from the input at load_addr, returns false to copy it */
+static bool fip_vec_add(uintptr_t data_addr, uintptr_t load_addr, uint64_t size)
+{
+	struct fwu_storage_seg *seg;
+	uint32_t offset;
+	uint32_t i;
+
+	if ((NULL == fwu_vec) || (FWU_VEC_DATA_MAX == fwu_vec->count) || (FWU_VEC_MIN_SIZE > size))
+		return false;
+
+	offset = data_addr - fwu_vec->out_addr;
+
+	for (i = 0; i < fwu_vec->count; i++)
+	{
+		seg = &fwu_vec->seg[i];
+		if ((offset < (seg->offset + seg->size)) && (seg->offset < (offset + size)))
+			return false;
+	}
+
+	seg = &fwu_vec->seg[fwu_vec->count++];
+	seg->offset = offset;
+	seg->buf = 0;
+	seg->buf_offset = load_addr - fwu_vec->in_addr;
+	seg->size = (uint32_t)size;
+
+	return true;
+}
+
+static TEE_Result fip_plain_update(uintptr_t fip_load_addr, uint32_t *load_size, uintptr_t fip_out_addr, uint32_t *out_size,
+								   bool crc)
 {
 	uintptr_t fip_load_max;
 	uintptr_t fip_out_max;
@@ -363,19 +801,162 @@ static TEE_Result fip_plain_update(uintptr_t fip_load_addr, uint32_t *load_size,
 			return TEE_ERROR_GENERIC;
 		}
 
-		/* Copy the data to the output area. */
-		memcpy((void *)data_addr, (void *)(fip_load_addr + toc_e->offset_address), toc_e->size);
-
-		toc_e++;
-	}
-
-	*load_size = toc_e_end->offset_address;
+		if (fip_vec_add(data_addr, fip_load_addr + toc_e->offset_address, toc_e->size))
+		{
+			/* Written from the input, only read it for the CRC. */
+			if (fip_plain_has_crc(toc_e, crc) &&
+				(TEE_SUCCESS != fip_plain_crc_check(toc_e, crc, fwu_crc32((void *)(fip_load_addr + toc_e->offset_address),
+																		  toc_e->size, 0))))
+				return TEE_ERROR_SECURITY;
+		}
+		else if (fip_plain_has_crc(toc_e, crc))
+		{
+			/* Copy the data to the output area and check it in the same pass. */
+			if (TEE_SUCCESS != fip_plain_crc_check(toc_e, crc, fwu_copy_crc32((void *)data_addr,
+								(void *)(fip_load_addr + toc_e->offset_address), toc_e->size, 0)))
+				return TEE_ERROR_SECURITY;
+		}
+		else
+		{
+			/* Copy the data to the output area. */
+			memcpy((void *)data_addr, (void *)(fip_load_addr + toc_e->offset_address), toc_e->size);
+		}
+
+		toc_e++;
+	}
+
+	*load_size = toc_e_end->offset_address;
 	*out_size = toc_e_end->offset_address;
 
 	return TEE_SUCCESS;
 }
 
-static TEE_Result fip_keyring_update(uintptr_t fip_load_addr, uint32_t *load_size, uintptr_t fip_out_addr, uint32_t *out_size)
+/*
+ * Move the FIP to fip_out_addr (at or before fip_load_addr) in ascending
+ * order, the data of the ToC entries with a CRC is checked while it is
+ * moved. Entries out of order are checked in the output after the move.
+ */
+static TEE_Result fip_plain_move_data(uintptr_t fip_load_addr, uintptr_t fip_out_addr, fip_toc_entry_t *toc_e_end, uint64_t fip_size,
+									  bool crc)
+{
+	fip_toc_entry_t *toc_e;
+	uint64_t pos;
+	bool has_crc = false;
+
+	for (toc_e = (fip_toc_entry_t *)(fip_load_addr + sizeof(fip_toc_header_t)); toc_e < toc_e_end; toc_e++)
+	{
+		if (fip_plain_has_crc(toc_e, crc))
+			has_crc = true;
+	}
+
+	if (!has_crc)
+	{
+		if (fip_out_addr != fip_load_addr)
+			TEE_MemMove((void *)fip_out_addr, (void *)fip_load_addr, fip_size);
+		return TEE_SUCCESS;
+	}
+
+	/* The ToC is moved first, the input ToC may be overwritten by the data. */
+	pos = (uintptr_t)(toc_e_end + 1) - fip_load_addr;
+	(void)fwu_copy_crc32((void *)fip_out_addr, (void *)fip_load_addr, pos, 0);
+	toc_e_end = (fip_toc_entry_t *)(fip_out_addr + ((uintptr_t)toc_e_end - fip_load_addr));
+
+	for (toc_e = (fip_toc_entry_t *)(fip_out_addr + sizeof(fip_toc_header_t)); toc_e < toc_e_end; toc_e++)
+	{
+		if ((fip_size < toc_e->offset_address) || ((fip_size - toc_e->offset_address) < toc_e->size))
+		{
+			EMSG("Data size exceeds FIP size.\n");
+			return TEE_ERROR_GENERIC;
+		}
+
+		if (toc_e->offset_address < pos)
+			continue;
+
+		(void)fwu_copy_crc32((void *)(fip_out_addr + pos), (void *)(fip_load_addr + pos), toc_e->offset_address - pos, 0);
+		if (TEE_SUCCESS != fip_plain_crc_check(toc_e, crc, fwu_copy_crc32((void *)(fip_out_addr + toc_e->offset_address),
+						(void *)(fip_load_addr + toc_e->offset_address), toc_e->size, 0)))
+			return TEE_ERROR_SECURITY;
+		pos = toc_e->offset_address + toc_e->size;
+	}
+	(void)fwu_copy_crc32((void *)(fip_out_addr + pos), (void *)(fip_load_addr + pos), fip_size - pos, 0);
+
+	/* Entries overlapping the previous ones are checked in the output. */
+	pos = (uintptr_t)(toc_e_end + 1) - fip_out_addr;
+	for (toc_e = (fip_toc_entry_t *)(fip_out_addr + sizeof(fip_toc_header_t)); toc_e < toc_e_end; toc_e++)
+	{
+		if (toc_e->offset_address < pos)
+		{
+			if (TEE_SUCCESS != fip_plain_crc_check(toc_e, crc, fwu_crc32((void *)(fip_out_addr + toc_e->offset_address),
+														toc_e->size, 0)))
+				return TEE_ERROR_SECURITY;
+		}
+		else
+		{
+			pos = toc_e->offset_address + toc_e->size;
+		}
+	}
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result fip_plain_move(uintptr_t fip_load_addr, uint32_t *load_size, uintptr_t fip_out_addr, uint32_t *out_size,
+								 bool crc)
+{
+	TEE_Result res;
+	uintptr_t fip_load_max;
+	fip_toc_entry_t *toc_e;
+	fip_toc_entry_t *toc_e_end = NULL;
+	uint64_t fip_size;
+
+	fip_load_max = (fip_load_addr + *load_size) - 1;
+
+	/* Get the address of the first TOC entry. */
+	toc_e = (fip_toc_entry_t *)(fip_load_addr + sizeof(fip_toc_header_t));
+
+	while ((uintptr_t)(toc_e + 1) < (fip_load_max + 1))
+	{
+		/* Find the ToC terminator entry. */
+		if (0 == memcmp(&toc_e->uuid, &uuid_null, sizeof(uuid_t)))
+		{
+			toc_e_end = toc_e;
+			break;
+		}
+
+		if ((fip_load_max + 1) < (fip_load_addr + toc_e->offset_address + toc_e->size))
+		{
+			EMSG("Data size exceeds FIP size.\n");
+			return TEE_ERROR_GENERIC;
+		}
+
+		toc_e++;
+	}
+
+	if (NULL == toc_e_end)
+	{
+		EMSG("FIP does not have the ToC terminator entry.\n");
+		return TEE_ERROR_GENERIC;
+	}
+
+	fip_size = toc_e_end->offset_address;
+	if ((fip_size < ((uintptr_t)(toc_e_end + 1) - fip_load_addr)) || (fip_size > *load_size) || (fip_size > *out_size))
+	{
+		EMSG("Invalid FIP size.\n");
+		return TEE_ERROR_GENERIC;
+	}
+
+	/* The output has the same layout as the input, move the FIP as a whole. */
+	res = fip_plain_move_data(fip_load_addr, fip_out_addr, toc_e_end, fip_size, crc);
+	if (TEE_SUCCESS != res)
+		return res;
+
+	*load_size = fip_size;
+	*out_size = fip_size;
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result fip_keyring_update(uintptr_t fip_load_addr, uint32_t *load_size, uintptr_t fip_out_addr, uint32_t *out_size,
+									 const struct fip_out_place *place)
 {
 	TEE_Result res_final = TEE_SUCCESS;
 	TEE_Result res = TEE_ERROR_GENERIC;
@@ -409,6 +990,12 @@ static TEE_Result fip_keyring_update(uintptr_t fip_load_addr, uint32_t *load_siz
 
 	while (toc_e < toc_e_end)
 	{
+		if (TEE_SUCCESS != fip_out_pad(fip_out_addr, fip_out_max, &data_addr, place))
+		{
+			res_final = TEE_ERROR_GENERIC;
+			break;
+		}
+
 		if ((fip_out_max + 1) < (data_addr + OUTPUT_KEYRING_SIZE))
 		{
 			EMSG("The copy data size exceeds the capacity of the temporary ram area.\n");
@@ -451,6 +1038,10 @@ static TEE_Result fip_keyring_update(uintptr_t fip_load_addr, uint32_t *load_siz
 		toc_e++;
 	}
 
+	if ((TEE_SUCCESS == res_final) &&
+		(TEE_SUCCESS != fip_out_pad(fip_out_addr, fip_out_max, &data_addr, place)))
+		res_final = TEE_ERROR_GENERIC;
+
 	*load_size = toc_e_end->offset_address;
 	toc_e_end->offset_address = data_addr - fip_out_addr;
 	*out_size = toc_e_end->offset_address;
@@ -460,7 +1051,133 @@ static TEE_Result fip_keyring_update(uintptr_t fip_load_addr, uint32_t *load_siz
 	return res_final;
 }
 
-static TEE_Result fip_encdata_update(uintptr_t fip_load_addr, uint32_t *load_size, uintptr_t fip_out_addr, uint32_t *out_size)
+/*
+ * Append the output of a chunked TSIP call to the re-encrypted data, *dst is
+ * the next byte of the data and dst_end its end.
+ */
+static TEE_Result fip_tsip_chunk_out(unsigned char **dst, const unsigned char *dst_end, size_t written)
+{
+	if ((size_t)(dst_end - *dst) < written)
+	{
+		EMSG("The TSIP output exceeds the re-encrypted data.\n");
+		return TEE_ERROR_GENERIC;
+	}
+
+	*dst += written;
+
+	return TEE_SUCCESS;
+}
+
+/*
+ * Re-encrypt the data one at a time with TSIP_CMD_UPDATE_FIRMWARE_INIT,
+ * _UPDATE and _FINAL, FWU_BOARD_TSIP_CHUNK_SIZE input bytes per call, so that
+ * no TSIP call covers a whole large data. The output is the same as the one of
+ * TSIP_CMD_UPDATE_FIRMWARE. Returns TEE_ERROR_NOT_SUPPORTED, with nothing
+ * re-encrypted, if the TSIP PTA has no chunked mode.
+ */
+static TEE_Result fip_encdata_chunked(TEE_TASessionHandle session, const update_fw_t *input_update_fw, const update_fw_t *output_update_fw)
+{
+	TEE_Result res = TEE_SUCCESS;
+	TEE_Param params[TEE_NUM_PARAMS];
+	uint32_t ret_origin = 0;
+	uint32_t param_types;
+	bool started = false;
+	uint32_t i;
+
+	for (i = 0; i < UPDATE_BOOT_DATA_MAX; i++)
+	{
+		const unsigned char *src = input_update_fw[i].data;
+		unsigned long left = input_update_fw[i].size;
+		unsigned char *dst = output_update_fw[i].data;
+		unsigned char *dst_end = dst + output_update_fw[i].size;
+
+		if (0 == left)
+			continue;
+
+		param_types = TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT,
+									  TEE_PARAM_TYPE_NONE,
+									  TEE_PARAM_TYPE_MEMREF_OUTPUT,
+									  TEE_PARAM_TYPE_NONE);
+		memset(&params, 0, sizeof(params));
+		params[0].value.a = i;
+		params[0].value.b = left;
+		params[2].memref.buffer = dst;
+		params[2].memref.size = dst_end - dst;
+
+		res = TEE_InvokeTACommand(session, 0, TSIP_CMD_UPDATE_FIRMWARE_INIT,
+								  param_types, params, &ret_origin);
+		if ((!started) &&
+			((TEE_ERROR_NOT_IMPLEMENTED == res) || (TEE_ERROR_BAD_PARAMETERS == res)))
+			return TEE_ERROR_NOT_SUPPORTED;
+
+		started = true;
+		if (TEE_SUCCESS == res)
+			res = fip_tsip_chunk_out(&dst, dst_end, params[2].memref.size);
+
+		while ((TEE_SUCCESS == res) && (0 < left))
+		{
+			unsigned long chunk = (FWU_BOARD_TSIP_CHUNK_SIZE < left) ? FWU_BOARD_TSIP_CHUNK_SIZE : left;
+
+			param_types = TEE_PARAM_TYPES(TEE_PARAM_TYPE_NONE,
+										  TEE_PARAM_TYPE_MEMREF_INPUT,
+										  TEE_PARAM_TYPE_MEMREF_OUTPUT,
+										  TEE_PARAM_TYPE_NONE);
+			memset(&params, 0, sizeof(params));
+			params[1].memref.buffer = (void *)src;
+			params[1].memref.size = chunk;
+			params[2].memref.buffer = dst;
+			params[2].memref.size = dst_end - dst;
+
+			res = TEE_InvokeTACommand(session, 0, TSIP_CMD_UPDATE_FIRMWARE_UPDATE,
+									  param_types, params, &ret_origin);
+			if (TEE_SUCCESS == res)
+				res = fip_tsip_chunk_out(&dst, dst_end, params[2].memref.size);
+
+			/* The FIP sets the exact sizes when it is done. */
+			if ((TEE_SUCCESS == res) && (NULL != fwu_progress_page))
+			{
+				fwu_progress_page->input_done += chunk;
+				fwu_progress_page->output_done += params[2].memref.size;
+			}
+
+			src += chunk;
+			left -= chunk;
+		}
+
+		if (TEE_SUCCESS == res)
+		{
+			param_types = TEE_PARAM_TYPES(TEE_PARAM_TYPE_NONE,
+										  TEE_PARAM_TYPE_NONE,
+										  TEE_PARAM_TYPE_MEMREF_OUTPUT,
+										  TEE_PARAM_TYPE_NONE);
+			memset(&params, 0, sizeof(params));
+			params[2].memref.buffer = dst;
+			params[2].memref.size = dst_end - dst;
+
+			res = TEE_InvokeTACommand(session, 0, TSIP_CMD_UPDATE_FIRMWARE_FINAL,
+									  param_types, params, &ret_origin);
+			if (TEE_SUCCESS == res)
+				res = fip_tsip_chunk_out(&dst, dst_end, params[2].memref.size);
+		}
+
+		if ((TEE_SUCCESS == res) && (dst != dst_end))
+		{
+			EMSG("The TSIP output is shorter than the re-encrypted data.\n");
+			res = TEE_ERROR_GENERIC;
+		}
+
+		if (TEE_SUCCESS != res)
+		{
+			EMSG("Failure when re-encrypting data %u in pieces", i);
+			return TEE_ERROR_GENERIC;
+		}
+	}
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result fip_encdata_reenc(uintptr_t fip_load_addr, uint32_t *load_size, uintptr_t fip_out_addr, uint32_t *out_size,
+									const struct fip_out_place *place)
 {
 	TEE_Result res_final = TEE_SUCCESS;
 	TEE_Result res = TEE_ERROR_GENERIC;
@@ -475,9 +1192,18 @@ static TEE_Result fip_encdata_update(uintptr_t fip_load_addr, uint32_t *load_siz
 	fip_toc_entry_t *toc_e_end;
 	uintptr_t data_addr;
 	uint32_t data_cnt;
+	bool chunked = false;
+
+	update_fw_t *input_update_fw;
+	update_fw_t *output_update_fw;
 
-	update_fw_t input_update_fw[UPDATE_BOOT_DATA_MAX] = {0};
-	update_fw_t output_update_fw[UPDATE_BOOT_DATA_MAX] = {0};
+	/* The PTA descriptors are too large for the TA stack. */
+	COMPILE_TIME_ASSERT((2 * UPDATE_BOOT_DATA_MAX) <= FWU_POOL_PTA_DESC_MAX);
+	COMPILE_TIME_ASSERT(sizeof(uint64_t) == REENC_SIZE_FIELD);
+	input_update_fw = FWU_POOL_NEW(FWU_POOL_PTA_DESC, update_fw_t, UPDATE_BOOT_DATA_MAX);
+	output_update_fw = FWU_POOL_NEW(FWU_POOL_PTA_DESC, update_fw_t, UPDATE_BOOT_DATA_MAX);
+	if ((NULL == input_update_fw) || (NULL == output_update_fw))
+		return TEE_ERROR_OUT_OF_MEMORY;
 
 	fip_load_max = (fip_load_addr + *load_size) - 1;
 	fip_out_max = (fip_out_addr + *out_size) - 1;
@@ -503,7 +1229,7 @@ static TEE_Result fip_encdata_update(uintptr_t fip_load_addr, uint32_t *load_siz
 
 		if (UPDATE_BOOT_DATA_MAX <= data_cnt)
 		{
-			EMSG("The number of data to be re-encrypted exceeds 16.\n");
+			EMSG("The number of data to be re-encrypted exceeds %d.\n", UPDATE_BOOT_DATA_MAX);
 			res_final = TEE_ERROR_GENERIC;
 			break;
 		}
@@ -511,9 +1237,15 @@ static TEE_Result fip_encdata_update(uintptr_t fip_load_addr, uint32_t *load_siz
 		if (0 != toc_e->size)
 		{
 			if (0 == data_cnt)
-				reenc_data_size = toc_e->size + 64;
+				reenc_data_size = toc_e->size + REENC_TSIP_FIRST;
 			else
-				reenc_data_size = toc_e->size + 16;
+				reenc_data_size = toc_e->size + REENC_TSIP_NEXT;
+
+			if (TEE_SUCCESS != fip_out_pad(fip_out_addr, fip_out_max, &data_addr, place))
+			{
+				res_final = TEE_ERROR_GENERIC;
+				break;
+			}
 
 			if ((fip_out_max + 1) < (data_addr + sizeof(reenc_data_size) + reenc_data_size))
 			{
@@ -527,6 +1259,8 @@ static TEE_Result fip_encdata_update(uintptr_t fip_load_addr, uint32_t *load_siz
 			output_update_fw[data_cnt].data = (unsigned char *)((uint64_t)data_addr + sizeof(reenc_data_size));
 			output_update_fw[data_cnt].size = reenc_data_size;
 			*(uint64_t *)data_addr = reenc_data_size;
+			if (FWU_BOARD_TSIP_CHUNK_SIZE < toc_e->size)
+				chunked = true;
 
 			/* Update the TOC entry for the re-encrypted firmware. */
 			toc_e->size = reenc_data_size + sizeof(reenc_data_size);
@@ -538,27 +1272,45 @@ static TEE_Result fip_encdata_update(uintptr_t fip_load_addr, uint32_t *load_siz
 		toc_e++;
 	}
 
+	if ((TEE_SUCCESS == res_final) &&
+		(TEE_SUCCESS != fip_out_pad(fip_out_addr, fip_out_max, &data_addr, place)))
+		res_final = TEE_ERROR_GENERIC;
+
+	/* Large data in pieces, if the TSIP PTA supports it */
+	res = TEE_ERROR_NOT_SUPPORTED;
+	if ((TEE_SUCCESS == res_final) && chunked)
+	{
+		res = fip_encdata_chunked(session, input_update_fw, output_update_fw);
+		if (TEE_ERROR_NOT_SUPPORTED == res)
+			DMSG("No chunked re-encryption, all data in one call");
+		else if (TEE_SUCCESS != res)
+			res_final = TEE_ERROR_GENERIC;
+	}
+
 	/* Update the firmware and copy to the output area via pseudo TA*/
-	param_types = TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT,
-								  TEE_PARAM_TYPE_MEMREF_INPUT,
-								  TEE_PARAM_TYPE_MEMREF_INOUT,
-								  TEE_PARAM_TYPE_NONE);
-	memset(&params, 0, sizeof(params));
+	if ((TEE_SUCCESS == res_final) && (TEE_ERROR_NOT_SUPPORTED == res))
+	{
+		param_types = TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT,
+									  TEE_PARAM_TYPE_MEMREF_INPUT,
+									  TEE_PARAM_TYPE_MEMREF_INOUT,
+									  TEE_PARAM_TYPE_NONE);
+		memset(&params, 0, sizeof(params));
 
-	params[0].value.a = UPDATE_BOOT_DATA_MAX;
+		params[0].value.a = UPDATE_BOOT_DATA_MAX;
 
-	params[1].memref.buffer = &input_update_fw;
-	params[1].memref.size = sizeof(input_update_fw);
+		params[1].memref.buffer = input_update_fw;
+		params[1].memref.size = sizeof(update_fw_t) * UPDATE_BOOT_DATA_MAX;
 
-	params[2].memref.buffer = &output_update_fw;
-	params[2].memref.size = sizeof(output_update_fw);
+		params[2].memref.buffer = output_update_fw;
+		params[2].memref.size = sizeof(update_fw_t) * UPDATE_BOOT_DATA_MAX;
 
-	res = TEE_InvokeTACommand(session, 0, TSIP_CMD_UPDATE_FIRMWARE,
-							  param_types, params, &ret_origin);
-	if (res != TEE_SUCCESS)
-	{
-		EMSG("Failure when calling TSIP_CMD_UPDATE_FIRMWARE");
-		res_final = TEE_ERROR_GENERIC;
+		res = TEE_InvokeTACommand(session, 0, TSIP_CMD_UPDATE_FIRMWARE,
+								  param_types, params, &ret_origin);
+		if (res != TEE_SUCCESS)
+		{
+			EMSG("Failure when calling TSIP_CMD_UPDATE_FIRMWARE");
+			res_final = TEE_ERROR_GENERIC;
+		}
 	}
 
 	TEE_CloseTASession(session);
@@ -570,120 +1322,418 @@ static TEE_Result fip_encdata_update(uintptr_t fip_load_addr, uint32_t *load_siz
 	return res_final;
 }
 
-static TEE_Result fip_write_fw(uintptr_t write_buff, uint32_t write_size)
+static TEE_Result fip_encdata_update(uintptr_t fip_load_addr, uint32_t *load_size, uintptr_t fip_out_addr, uint32_t *out_size,
+									 const struct fip_out_place *place)
 {
-	TEE_Result res = TEE_ERROR_GENERIC;
-	TEE_TASessionHandle session = TEE_HANDLE_NULL;
-	TEE_Param params[TEE_NUM_PARAMS] = {0};
-	uint32_t ret_origin = 0;
-
-	uint32_t param_types = TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT,
-										   TEE_PARAM_TYPE_MEMREF_INPUT,
-										   TEE_PARAM_TYPE_NONE,
-										   TEE_PARAM_TYPE_NONE);
-
-	if (SPI_END_OFFSET_ADDR < (write_size + SPI_FWU_PACKAGE_OFFSET_ADDR))
-	{
-		EMSG("The write data size exceeds the capacity of Flash Memory");
-		return TEE_ERROR_GENERIC;
-	}
+	TEE_Result res;
+	struct fwu_arena_pos mark;
 
-	res = TEE_OpenTASession(&flash_uuid, 0, 0, NULL, &session,
-							&ret_origin);
+	/* The descriptors are only needed for one FIP. */
+	fwu_arena_mark(&mark);
+	res = fip_encdata_reenc(fip_load_addr, load_size, fip_out_addr, out_size, place);
+	fwu_arena_release(&mark);
 
-	if (res != TEE_SUCCESS)
-		return res;
+	return res;
+}
 
-	params[0].value.a = SPI_FWU_PACKAGE_OFFSET_ADDR;
-	params[1].memref.buffer = (void *)write_buff;
-	params[1].memref.size = write_size;
+static TEE_Result fip_write_fw(uint32_t write_offset, uintptr_t write_buff, uint32_t write_size)
+{
+	return fwu_storage_write(write_offset, (const void *)write_buff, write_size);
+}
 
-	res = TEE_InvokeTACommand(session, 0, FLASH_CMD_WRITE_SPI,
-							  param_types, params, &ret_origin);
-	if (res != TEE_SUCCESS)
-		EMSG("Failure when calling FLASH_CMD_WRITE_SPI");
+static uint32_t fwu_elapsed_ms(const TEE_Time *start)
+{
+	TEE_Time now;
 
-	TEE_CloseTASession(session);
+	TEE_GetSystemTime(&now);
 
-	return res;
+	return ((now.seconds - start->seconds) * 1000) + now.millis - start->millis;
 }
 
-static TEE_Result fwu_firmware_update(uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
+static TEE_Result fip_update(uint32_t fip_name, uintptr_t fip_load_addr, uint32_t *load_size, uintptr_t fip_out_addr, uint32_t *out_size,
+							 const struct fip_out_place *place, bool inplace)
 {
 	TEE_Result res;
+	struct fwu_arena_pos mark;
+	struct fwu_component_stats *fip_stats;
+	TEE_Time start;
 
-	uintptr_t fip_load_addr, fip_load_max;
-	uintptr_t fip_out_addr, fip_out_max;
-	uint32_t load_size, out_size;
-	uint32_t fip_name, fip_flags;
-	uint32_t write_size;
-	uintptr_t write_buff;
+	/* The entries are read before the update, which may overwrite them. */
+	fwu_arena_mark(&mark);
+	fip_stats = FWU_ARENA_NEW(struct fwu_component_stats, FWU_COMP_MAX);
+	if (NULL == fip_stats)
+		return TEE_ERROR_OUT_OF_MEMORY;
 
-	uint32_t exp_type = TEE_PARAM_TYPES(TEE_PARAM_TYPE_MEMREF_INPUT,
-										TEE_PARAM_TYPE_MEMREF_INOUT,
-										TEE_PARAM_TYPE_NONE,
-										TEE_PARAM_TYPE_NONE);
+	res = fip_components(fip_name, fip_load_addr, fip_load_addr + *load_size - 1, fip_stats);
+	if (TEE_SUCCESS != res)
+	{
+		fwu_arena_release(&mark);
+		return res;
+	}
 
-	DMSG("has been called");
+	TEE_GetSystemTime(&start);
 
-	if (type != exp_type)
+	switch (fip_name)
 	{
-		EMSG("expect 1 output values as argument");
-		return TEE_ERROR_BAD_PARAMETERS;
+	case TOC_HEADER_NAME_PLAIN:
+	{
+		if (inplace)
+			res = fip_plain_move(fip_load_addr, load_size, fip_out_addr, out_size, place->crc);
+		else
+			res = fip_plain_update(fip_load_addr, load_size, fip_out_addr, out_size, place->crc);
+		break;
+	}
+	case TOC_HEADER_NAME_KEYRING:
+	{
+		res = fip_keyring_update(fip_load_addr, load_size, fip_out_addr, out_size, place);
+		break;
+	}
+	case TOC_HEADER_NAME_BOOT_FW:
+	case TOC_HEADER_NAME_NS_BL2U:
+	{
+		res = fip_encdata_update(fip_load_addr, load_size, fip_out_addr, out_size, place);
+		break;
+	}
+	case TOC_HEADER_NAME_DIRECTORY:
+	{
+		res = fip_dir_skip(fip_load_addr, fip_load_addr + *load_size - 1, load_size, out_size);
+		break;
+	}
+	default:
+	{
+		res = TEE_ERROR_GENERIC;
+		EMSG("Unknown FIP name\n");
+		break;
+	}
 	}
 
-	if ((0 == p[0].memref.size) || (0 == p[1].memref.size))
-		return TEE_ERROR_BAD_PARAMETERS;
+	if (TEE_SUCCESS == res)
+		fwu_component_account(fip_stats, fwu_elapsed_ms(&start));
 
-	fip_load_addr = (uintptr_t)p[0].memref.buffer;
-	fip_load_max = fip_load_addr + p[0].memref.size - 1;
-	fip_out_addr = (uintptr_t)p[1].memref.buffer;
-	fip_out_max = fip_out_addr + p[1].memref.size - 1;
+	fwu_arena_release(&mark);
 
-	do
+	return res;
+}
+
+/*
+ * Erase the staging area up to the end of the next output, so that the erase
+ * is spread between the TSIP batches and the final write only programs.
+ */
+static void fwu_preerase(struct fwu_preerase *pe, uint32_t end)
+{
+	TEE_Result res;
+	uint32_t size;
+
+	if ((!pe->enabled) || (end <= pe->erased))
+		return;
+
+	if (0 == pe->erase_size)
 	{
-		if ((fip_load_addr + sizeof(fip_toc_header_t)) >= fip_load_max)
+		if (TEE_SUCCESS != fwu_storage_info(&pe->geo))
 		{
-			EMSG("Loaded data doesn't match the FIP format\n");
-			res = TEE_ERROR_GENERIC;
-			break;
+			pe->enabled = false;
+			return;
 		}
+		pe->erase_size = pe->geo.erase_size;
+	}
 
-		fip_name = ((fip_toc_header_t *)fip_load_addr)->name;
-		fip_flags = ((fip_toc_header_t *)fip_load_addr)->flags >> 32;
-		load_size = (fip_load_max + 1) - fip_load_addr;
-		out_size = (fip_out_max + 1) - fip_out_addr;
+	size = end - pe->erased;
+	if (0 != (size % pe->erase_size))
+		size += pe->erase_size - (size % pe->erase_size);
+	if ((pe->geo.capacity - pe->erased) < size)
+		size = pe->geo.capacity - pe->erased;
+	if (0 == size)
+		return;
 
-		switch (fip_name)
-		{
-		case TOC_HEADER_NAME_PLAIN:
-		{
-			res = fip_plain_update(fip_load_addr, &load_size, fip_out_addr, &out_size);
-			break;
+	res = fwu_storage_erase(pe->erased, size);
+	if (TEE_SUCCESS != res)
+	{
+		/* The write erases the area by itself. */
+		DMSG("Pre-erase is not available (0x%x)", res);
+		pe->enabled = false;
+		return;
+	}
+
+	pe->erased += size;
+}
+
+/*
+ * Erase for the FIP at fip_load_addr that is written at place. A FIP whose
+ * data is cut short fails its update, so the pre-erase stops before it.
+ */
+static void fwu_preerase_fip(struct fwu_preerase *pe, uint32_t fip_name, uintptr_t fip_load_addr,
+							 uintptr_t fip_load_max, const struct fip_out_place *place)
+{
+	uint32_t load_size, out_size;
+
+	if (!pe->enabled)
+		return;
+
+	if ((TEE_SUCCESS != fip_calc_out_size(fip_name, fip_load_addr, fip_load_max, place, &load_size, &out_size)) ||
+		(load_size > ((fip_load_max + 1) - fip_load_addr)))
+	{
+		pe->enabled = false;
+		return;
+	}
+
+	fwu_preerase(pe, place->offset + out_size);
+}
+
+/*
+ * Pre-erase only for a package whose FIP headers and sizes are all valid,
+ * so that a malformed package fails before the staging area is erased.
+ * res, count and work_size are the result of fwu_scan_package().
+ */
+static bool fwu_preerase_allowed(TEE_Result res, uint32_t count, uint32_t work_size, uint32_t out_size)
+{
+	return (TEE_SUCCESS == res) && (0 != count) && (work_size <= out_size);
+}
+
+static TEE_Result fwu_preerase_write(struct fwu_preerase *pe, uint32_t offset, uintptr_t buff, uint32_t size)
+{
+	if (pe->enabled && ((offset + size) <= pe->erased))
+		return fwu_storage_program(offset, (const void *)buff, size);
+
+	return fip_write_fw(offset, buff, size);
+}
+
+/*
+ * Write the output with the plain data of vec taken from the input buffer,
+ * or copy the plain data and write the work buffer if the storage can not
+ * write segments
+ */
+static TEE_Result fwu_vec_write(struct fwu_preerase *pe, struct fwu_vec *vec, uint32_t in_size, uint32_t write_size)
+{
+	TEE_Result res;
+	struct fwu_storage_seg *list;
+	struct fwu_storage_seg tmp;
+	void *buf[2] = { (void *)vec->in_addr, (void *)vec->out_addr };
+	uint32_t buf_size[2] = { in_size, write_size };
+	uint32_t count = 0;
+	uint32_t pos = 0;
+	uint32_t i, j;
+
+	/* Sort the plain data by output offset, the work buffer fills the gaps. */
+	for (i = 1; i < vec->count; i++)
+	{
+		tmp = vec->seg[i];
+		for (j = i; (0 < j) && (vec->seg[j - 1].offset > tmp.offset); j--)
+			vec->seg[j] = vec->seg[j - 1];
+		vec->seg[j] = tmp;
+	}
+
+	list = FWU_POOL_NEW(FWU_POOL_TOC_INDEX, struct fwu_storage_seg, (2 * vec->count) + 1);
+	if (NULL != list)
+	{
+		for (i = 0; i < vec->count; i++)
+		{
+			if (vec->seg[i].offset > pos)
+			{
+				list[count].offset = pos;
+				list[count].buf = 1;
+				list[count].buf_offset = pos;
+				list[count].size = vec->seg[i].offset - pos;
+				count++;
+			}
+			list[count++] = vec->seg[i];
+			pos = vec->seg[i].offset + vec->seg[i].size;
 		}
-		case TOC_HEADER_NAME_KEYRING:
+		if (write_size > pos)
 		{
-			res = fip_keyring_update(fip_load_addr, &load_size, fip_out_addr, &out_size);
-			break;
+			list[count].offset = pos;
+			list[count].buf = 1;
+			list[count].buf_offset = pos;
+			list[count].size = write_size - pos;
+			count++;
 		}
-		case TOC_HEADER_NAME_BOOT_FW:
-		case TOC_HEADER_NAME_NS_BL2U:
+
+		res = fwu_storage_write_vec(list, count, buf, buf_size, pe->enabled && (write_size <= pe->erased));
+		if (TEE_ERROR_NOT_SUPPORTED != res)
+			return res;
+	}
+
+	DMSG("The storage can not write segments, copy the plain data");
+	for (i = 0; i < vec->count; i++)
+		memcpy((void *)(vec->out_addr + vec->seg[i].offset), (void *)(vec->in_addr + vec->seg[i].buf_offset),
+			   vec->seg[i].size);
+
+	return fwu_preerase_write(pe, 0, vec->out_addr, write_size);
+}
+
+static TEE_Result fwu_firmware_update(uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
+{
+	TEE_Result res;
+
+	uintptr_t fip_load_addr, fip_load_max, fip_load_top;
+	uintptr_t fip_out_addr, fip_out_max;
+	uint32_t load_size, out_size;
+	uint32_t fip_name, fip_flags;
+	uint32_t write_size;
+	uintptr_t write_buff;
+	uint32_t count, work_size, single_size;
+	bool inplace;
+	struct fwu_progress *progress = NULL;
+	struct fwu_preerase preerase = { .enabled = false };
+	struct fwu_vec *vec = NULL;
+	const uint8_t *digests = NULL;
+	uint32_t digests_size = 0;
+	struct fip_out_place place;
+
+	uint32_t exp_type = TEE_PARAM_TYPES(TEE_PARAM_TYPE_MEMREF_INPUT,
+										TEE_PARAM_TYPE_MEMREF_INOUT,
+										TEE_PARAM_TYPE_NONE,
+										TEE_PARAM_TYPE_NONE);
+	uint32_t exp_type_inplace = TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT,
+												TEE_PARAM_TYPE_MEMREF_INOUT,
+												TEE_PARAM_TYPE_NONE,
+												TEE_PARAM_TYPE_NONE);
+
+	DMSG("has been called");
+
+	/* param[2] is the optional progress page. */
+	if (TEE_PARAM_TYPE_MEMREF_INOUT == TEE_PARAM_TYPE_GET(type, 2))
+	{
+		if (sizeof(struct fwu_progress) > p[2].memref.size)
+			return TEE_ERROR_BAD_PARAMETERS;
+
+		progress = (struct fwu_progress *)p[2].memref.buffer;
+		type &= ~TEE_PARAM_TYPES(TEE_PARAM_TYPE_NONE, TEE_PARAM_TYPE_NONE, 0xF, TEE_PARAM_TYPE_NONE);
+	}
+
+	/* param[3] is the optional list of the segment digests of the package. */
+	if (TEE_PARAM_TYPE_MEMREF_INPUT == TEE_PARAM_TYPE_GET(type, 3))
+	{
+		digests = (const uint8_t *)p[3].memref.buffer;
+		digests_size = p[3].memref.size;
+		type &= ~TEE_PARAM_TYPES(TEE_PARAM_TYPE_NONE, TEE_PARAM_TYPE_NONE, TEE_PARAM_TYPE_NONE, 0xF);
+	}
+
+	if (type == exp_type)
+	{
+		inplace = false;
+		if ((0 == p[0].memref.size) || (0 == p[1].memref.size))
+			return TEE_ERROR_BAD_PARAMETERS;
+
+		fip_load_addr = (uintptr_t)p[0].memref.buffer;
+		fip_load_max = fip_load_addr + p[0].memref.size - 1;
+	}
+	else if (type == exp_type_inplace)
+	{
+		inplace = true;
+		/* The input data must be inside of the work buffer. */
+		if ((0 == p[0].value.b) || (p[1].memref.size < p[0].value.b) ||
+			((p[1].memref.size - p[0].value.b) < p[0].value.a))
+			return TEE_ERROR_BAD_PARAMETERS;
+
+		fip_load_addr = (uintptr_t)p[1].memref.buffer + p[0].value.a;
+		fip_load_max = fip_load_addr + p[0].value.b - 1;
+	}
+	else
+	{
+		EMSG("expect 1 output values as argument");
+		return TEE_ERROR_BAD_PARAMETERS;
+	}
+
+	fip_out_addr = (uintptr_t)p[1].memref.buffer;
+	fip_out_max = fip_out_addr + p[1].memref.size - 1;
+
+	if (NULL != progress)
+	{
+		memset(progress, 0, sizeof(struct fwu_progress));
+		progress->stage = FWU_STAGE_UPDATE;
+		progress->input_size = (fip_load_max + 1) - fip_load_addr;
+	}
+
+	/* The whole input is checked before the in-place output overwrites it. */
+	if (NULL != digests)
+	{
+		res = fip_dir_verify(fip_load_addr, (fip_load_max + 1) - fip_load_addr, digests, digests_size);
+		if (TEE_SUCCESS != res)
+			return res;
+	}
+
+	res = fip_out_layout(fip_load_addr, (fip_load_max + 1) - fip_load_addr, &place);
+	if (TEE_SUCCESS != res)
+		return res;
+
+	res = fwu_scan_package(fip_load_addr, (fip_load_max + 1) - fip_load_addr, NULL, &count, &work_size, &single_size);
+	preerase.enabled = fwu_preerase_allowed(res, count, work_size, (fip_out_max + 1) - fip_out_addr);
+
+	/*
+	 * With separate buffers, the plain data is written from the input.
+	 * The A/B slots are verified from the contiguous output.
+	 */
+	if ((!inplace) && (!CFG_FWU_AB) && (NULL != fwu_storage_get()->write_vec))
+	{
+		COMPILE_TIME_ASSERT(((3 * FWU_VEC_DATA_MAX) + 1) <= FWU_POOL_TOC_INDEX_MAX);
+		vec = FWU_ARENA_NEW(struct fwu_vec, 1);
+		if (NULL != vec)
+		{
+			vec->in_addr = fip_load_addr;
+			vec->out_addr = fip_out_addr;
+			vec->seg = FWU_POOL_NEW(FWU_POOL_TOC_INDEX, struct fwu_storage_seg, FWU_VEC_DATA_MAX);
+			if (NULL == vec->seg)
+				vec = NULL;
+		}
+	}
+	fwu_vec = vec;
+	fwu_progress_page = progress;
+	fip_load_top = fip_load_addr;
+
+	/* The update can be cancelled between FIPs. */
+	TEE_UnmaskCancellation();
+
+	do
+	{
+		if (TEE_GetCancellationFlag())
 		{
-			res = fip_encdata_update(fip_load_addr, &load_size, fip_out_addr, &out_size);
+			EMSG("The firmware update has been cancelled.\n");
+			res = TEE_ERROR_CANCEL;
 			break;
 		}
-		default:
+
+		if ((fip_load_addr + sizeof(fip_toc_header_t)) >= fip_load_max)
 		{
+			EMSG("Loaded data doesn't match the FIP format\n");
 			res = TEE_ERROR_GENERIC;
-			EMSG("Unknown FIP name\n");
 			break;
 		}
+
+		fip_name = ((fip_toc_header_t *)fip_load_addr)->name;
+		fip_flags = ((fip_toc_header_t *)fip_load_addr)->flags >> 32;
+		load_size = (fip_load_max + 1) - fip_load_addr;
+		out_size = (fip_out_max + 1) - fip_out_addr;
+
+		if (inplace)
+		{
+			/* The output must never overtake the unread input. */
+			if (fip_out_addr > fip_load_addr)
+			{
+				EMSG("The output area overlaps the input data.\n");
+				res = TEE_ERROR_GENERIC;
+				break;
+			}
+
+			if (TOC_HEADER_NAME_PLAIN != fip_name)
+				out_size = fip_load_addr - fip_out_addr;
 		}
+
+		place.offset = fip_out_addr - (uintptr_t)p[1].memref.buffer;
+		fwu_preerase_fip(&preerase, fip_name, fip_load_addr, fip_load_max, &place);
+
+		res = fip_update(fip_name, fip_load_addr, &load_size, fip_out_addr, &out_size, &place, inplace);
 		if (TEE_SUCCESS == res)
 		{
 			fip_load_addr += load_size;
 			fip_out_addr += out_size;
 
+			if (NULL != progress)
+			{
+				progress->fip_count++;
+				progress->input_done = fip_load_addr - fip_load_top;
+				progress->output_done = fip_out_addr - (uintptr_t)p[1].memref.buffer;
+			}
+
 			if (0 != (fip_flags & FIP_FLAGS_END_OF_FILE))
 			{
 				DMSG("The FIP platform flag END_OF_FILE has been detected.\n");
@@ -693,62 +1743,1037 @@ static TEE_Result fwu_firmware_update(uint32_t type, TEE_Param p[TEE_NUM_PARAMS]
 
 	} while ((TEE_SUCCESS == res) && (fip_load_addr < fip_load_max));
 
+	fwu_vec = NULL;
+	fwu_progress_page = NULL;
+
+	/* The flash write must not be interrupted. */
+	TEE_MaskCancellation();
+
 	if (TEE_SUCCESS != res)
 		return res;
 
 	write_buff = (uintptr_t)p[1].memref.buffer;
 	write_size = fip_out_addr - write_buff;
-	res = fip_write_fw(write_buff, write_size);
+
+	/* The written size grows with each transfer to the flash. */
+	if (NULL != progress)
+	{
+		progress->stage = FWU_STAGE_WRITE;
+		fwu_storage_set_progress(&progress->written);
+	}
+
+	if ((NULL != vec) && (0 != vec->count))
+		res = fwu_vec_write(&preerase, vec, p[0].memref.size, write_size);
+	else
+		res = fwu_preerase_write(&preerase, 0, write_buff, write_size);
+	fwu_storage_set_progress(NULL);
+	if (res == (TEE_Result)TEE_SUCCESS)
+		res = fwu_slot_activate((const void *)write_buff, write_size);
 	if (res != (TEE_Result)TEE_SUCCESS)
 	{
 		EMSG("fip_write error\n");
 		return res;
 	}
 
+	if (NULL != progress)
+	{
+		progress->written = write_size;
+		progress->stage = FWU_STAGE_DONE;
+	}
+
 	return TEE_SUCCESS;
 }
 
-/*
- * Trusted Application Entry Points
- */
-
-TEE_Result TA_CreateEntryPoint(void)
+static TEE_Result fwu_get_sections(struct fwu_session *sess, uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
 {
+	TEE_Result res;
+	uint32_t single_size;
+	const fip_dir_header_t *dir;
+	const fip_dir_entry_t *dir_e;
+	uint32_t i;
+
+	uint32_t exp_type = TEE_PARAM_TYPES(TEE_PARAM_TYPE_MEMREF_INPUT,
+										TEE_PARAM_TYPE_MEMREF_OUTPUT,
+										TEE_PARAM_TYPE_VALUE_OUTPUT,
+										TEE_PARAM_TYPE_NONE);
+
 	DMSG("has been called");
+
+	if (type != exp_type)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	if ((NULL != fwu_txn.owner) && (sess != fwu_txn.owner))
+	{
+		EMSG("The section update is owned by another session.\n");
+		return TEE_ERROR_BUSY;
+	}
+
+	if (sizeof(fwu_txn.section) > p[1].memref.size)
+	{
+		p[1].memref.size = sizeof(fwu_txn.section);
+		return TEE_ERROR_SHORT_BUFFER;
+	}
+
+	memset(&fwu_txn, 0, sizeof(fwu_txn));
+	res = fwu_scan_package((uintptr_t)p[0].memref.buffer, p[0].memref.size, fwu_txn.section,
+						   &fwu_txn.count, &fwu_txn.work_size, &single_size);
+	if (TEE_SUCCESS == res)
+		res = fip_out_layout((uintptr_t)p[0].memref.buffer, p[0].memref.size, &fwu_txn.place);
+	if ((TEE_SUCCESS != res) || (0 == fwu_txn.count))
+	{
+		memset(&fwu_txn, 0, sizeof(fwu_txn));
+		return TEE_ERROR_GENERIC;
+	}
+
+	/* The digests of the directory are checked by FWU_CMD_UPDATE_SECTION. */
+	if ((TEE_SUCCESS == fip_dir_get((uintptr_t)p[0].memref.buffer, p[0].memref.size, &dir)) && (NULL != dir))
+	{
+		dir_e = (const fip_dir_entry_t *)(dir + 1);
+		for (i = 0; i < fwu_txn.count; i++)
+			memcpy(fwu_txn.digest[i], dir_e[i].digest, FIP_DIR_DIGEST_SIZE);
+		fwu_txn.has_digest = true;
+		fwu_txn.digest_shift = fwu_layout_segment_shift(dir);
+	}
+
+	fwu_txn.owner = sess;
+	memcpy(p[1].memref.buffer, fwu_txn.section, fwu_txn.count * sizeof(struct fwu_section));
+	p[1].memref.size = fwu_txn.count * sizeof(struct fwu_section);
+	p[2].value.a = fwu_txn.count;
+	p[2].value.b = fwu_txn.work_size;
+
 	return TEE_SUCCESS;
 }
 
-void TA_DestroyEntryPoint(void)
+static TEE_Result fwu_update_section(struct fwu_session *sess, uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
 {
+	TEE_Result res;
+	struct fwu_section *section;
+	uint32_t index;
+	uint32_t load_size, out_size;
+	const uint8_t *digests = NULL;
+	uint32_t digests_size = 0;
+	struct fip_out_place place;
+
+	uint32_t exp_type = TEE_PARAM_TYPES(TEE_PARAM_TYPE_MEMREF_INPUT,
+										TEE_PARAM_TYPE_MEMREF_INOUT,
+										TEE_PARAM_TYPE_VALUE_INPUT,
+										TEE_PARAM_TYPE_NONE);
+
 	DMSG("has been called");
+
+	/* param[3] is the optional list of the segment digests of the section. */
+	if (TEE_PARAM_TYPE_MEMREF_INPUT == TEE_PARAM_TYPE_GET(type, 3))
+	{
+		digests = (const uint8_t *)p[3].memref.buffer;
+		digests_size = p[3].memref.size;
+		type &= ~TEE_PARAM_TYPES(TEE_PARAM_TYPE_NONE, TEE_PARAM_TYPE_NONE, TEE_PARAM_TYPE_NONE, 0xF);
+	}
+
+	if (type != exp_type)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	index = p[2].value.a;
+	if ((NULL == fwu_txn.owner) || (fwu_txn.count <= index) || (0 != (fwu_txn.done & (1U << index))))
+		return TEE_ERROR_BAD_STATE;
+
+	section = &fwu_txn.section[index];
+	if ((section->in_size != p[0].memref.size) || (section->out_size > p[1].memref.size) ||
+		(section->name != ((fip_toc_header_t *)p[0].memref.buffer)->name))
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	if ((NULL != digests) && !fwu_txn.has_digest)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	if (fwu_txn.has_digest)
+	{
+		res = fwu_digest_check(p[0].memref.buffer, section->in_size, fwu_txn.digest[index],
+							   fwu_txn.digest_shift, digests, digests_size);
+		if (TEE_SUCCESS != res)
+			return res;
+	}
+
+	load_size = section->in_size;
+	out_size = section->out_size;
+	place = fwu_txn.place;
+	place.offset = section->out_offset;
+	res = fip_update(section->name, (uintptr_t)p[0].memref.buffer, &load_size,
+					 (uintptr_t)p[1].memref.buffer, &out_size, &place, false);
+	if (TEE_SUCCESS != res)
+		return res;
+
+	/* The section must match the layout of FWU_CMD_GET_SECTIONS. */
+	if ((section->in_size != load_size) || (section->out_size != out_size))
+	{
+		EMSG("The section size does not match the package.\n");
+		return TEE_ERROR_GENERIC;
+	}
+
+	/* FWU_CMD_COMMIT checks that the work buffer still holds this output. */
+	res = fwu_digest_sha256(p[1].memref.buffer, out_size, fwu_txn.out_digest[index]);
+	if (TEE_SUCCESS != res)
+		return res;
+
+	fwu_txn.done |= (1U << index);
+	sess->section_updates++;
+
+	return TEE_SUCCESS;
 }
 
-TEE_Result TA_OpenSessionEntryPoint(uint32_t paramTypes __unused,
-									TEE_Param __unused pParams[TEE_NUM_PARAMS], void **sessionContext __unused)
+static TEE_Result fwu_commit(struct fwu_session *sess, uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
 {
+	TEE_Result res;
+	const struct fwu_section *section;
+	uint8_t digest[FIP_DIR_DIGEST_SIZE];
+	uint32_t i;
+
+	uint32_t exp_type = TEE_PARAM_TYPES(TEE_PARAM_TYPE_MEMREF_INPUT,
+										TEE_PARAM_TYPE_NONE,
+										TEE_PARAM_TYPE_NONE,
+										TEE_PARAM_TYPE_NONE);
+
 	DMSG("has been called");
 
-	memset(&uuid_null, 0, sizeof(uuid_t));
+	if (type != exp_type)
+		return TEE_ERROR_BAD_PARAMETERS;
 
-	return TEE_SUCCESS;
+	if (sess != fwu_txn.owner)
+		return TEE_ERROR_BAD_STATE;
+
+	if (((1U << fwu_txn.count) - 1) != fwu_txn.done)
+	{
+		EMSG("Not all sections have been updated.\n");
+		return TEE_ERROR_BAD_STATE;
+	}
+
+	if (fwu_txn.work_size > p[0].memref.size)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	/* The sections cover the work buffer, each must be the output of FWU_CMD_UPDATE_SECTION. */
+	for (i = 0; i < fwu_txn.count; i++)
+	{
+		section = &fwu_txn.section[i];
+		res = fwu_digest_sha256((const uint8_t *)p[0].memref.buffer + section->out_offset,
+								section->out_size, digest);
+		if (TEE_SUCCESS != res)
+			return res;
+
+		if (0 != memcmp(digest, fwu_txn.out_digest[i], sizeof(digest)))
+		{
+			EMSG("Section %u has changed since its update.\n", i);
+			return TEE_ERROR_SECURITY;
+		}
+	}
+
+	res = fip_write_fw(0, (uintptr_t)p[0].memref.buffer, fwu_txn.work_size);
+	if (res == (TEE_Result)TEE_SUCCESS)
+		res = fwu_slot_activate(p[0].memref.buffer, fwu_txn.work_size);
+	if (res != (TEE_Result)TEE_SUCCESS)
+		EMSG("fip_write error\n");
+
+	memset(&fwu_txn, 0, sizeof(fwu_txn));
+
+	return res;
 }
 
-void TA_CloseSessionEntryPoint(void *sessionContext __unused)
+static void fwu_step_reset(struct fwu_session *sess)
 {
-	DMSG("has been called");
+	sess->step_stage = FWU_STAGE_IDLE;
+	sess->step_in_size = 0;
+	sess->step_out_size = 0;
+	sess->step_load_pos = 0;
+	sess->step_out_pos = 0;
+	sess->step_written = 0;
+	sess->step_chunk = 0;
+	TEE_Free(sess->step_digest);
+	sess->step_digest = NULL;
+	memset(&sess->step_erase, 0, sizeof(sess->step_erase));
 }
 
-TEE_Result TA_InvokeCommandEntryPoint(void *sessionContext __unused, uint32_t commandID,
-									  uint32_t ptypes, TEE_Param params[TEE_NUM_PARAMS])
+/*
+ * Hash the write chunks of the output at the end of the update stage, the
+ * write stage checks each chunk against its digest before it is written.
+ */
+static TEE_Result fwu_step_digest(struct fwu_session *sess, const uint8_t *out)
 {
-	switch (commandID)
+	TEE_Result res;
+	struct fwu_storage_geometry geo;
+	uint32_t count;
+	uint32_t size;
+	uint32_t i;
+
+	if (0 == sess->step_out_pos)
 	{
-	case FWU_CMD_CALC_WORK_SIZE:
-		return fwu_calc_work_size(ptypes, params);
-	case FWU_CMD_FIRMWARE_UPDATE:
-		return fwu_firmware_update(ptypes, params);
-	default:
-		break;
+		EMSG("The package has no output.\n");
+		return TEE_ERROR_BAD_FORMAT;
 	}
-	return TEE_ERROR_NOT_IMPLEMENTED;
-}
\ No newline at end of file
+
+	res = fwu_storage_info(&geo);
+	if (TEE_SUCCESS != res)
+		return res;
+	sess->step_chunk = fwu_storage_chunk_size(&geo, STEP_WRITE_CHUNK_SIZE);
+
+	count = ((sess->step_out_pos - 1) / sess->step_chunk) + 1;
+	sess->step_digest = TEE_Malloc(count * FIP_DIR_DIGEST_SIZE, TEE_MALLOC_FILL_ZERO);
+	if (NULL == sess->step_digest)
+		return TEE_ERROR_OUT_OF_MEMORY;
+
+	for (i = 0; (i < count) && (TEE_SUCCESS == res); i++)
+	{
+		size = sess->step_out_pos - (i * sess->step_chunk);
+		if (sess->step_chunk < size)
+			size = sess->step_chunk;
+		res = fwu_digest_sha256(out + (i * sess->step_chunk), size, sess->step_digest[i]);
+	}
+
+	return res;
+}
+
+static TEE_Result fwu_update_step(struct fwu_session *sess, uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
+{
+	TEE_Result res = TEE_SUCCESS;
+	TEE_Time start;
+	uintptr_t fip_load_addr, fip_out_addr;
+	uint32_t load_size, out_size;
+	uint32_t fip_name, fip_flags;
+	uint32_t budget;
+	uint32_t count, work_size, single_size;
+	uint8_t digest[FIP_DIR_DIGEST_SIZE];
+	struct fip_out_place place;
+
+	uint32_t exp_type = TEE_PARAM_TYPES(TEE_PARAM_TYPE_MEMREF_INPUT,
+										TEE_PARAM_TYPE_MEMREF_INOUT,
+										TEE_PARAM_TYPE_VALUE_INOUT,
+										TEE_PARAM_TYPE_NONE);
+
+	DMSG("has been called");
+
+	if (type != exp_type)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	TEE_GetSystemTime(&start);
+	budget = (0 != p[2].value.a) ? p[2].value.a : STEP_BUDGET_DEFAULT_MS;
+
+	if (FWU_STAGE_IDLE == sess->step_stage)
+	{
+		if ((0 == p[0].memref.size) || (0 == p[1].memref.size))
+			return TEE_ERROR_BAD_PARAMETERS;
+
+		sess->step_stage = FWU_STAGE_UPDATE;
+		sess->step_in_size = p[0].memref.size;
+		sess->step_out_size = p[1].memref.size;
+		res = fwu_scan_package((uintptr_t)p[0].memref.buffer, p[0].memref.size, NULL, &count, &work_size,
+							   &single_size);
+		sess->step_erase.enabled = fwu_preerase_allowed(res, count, work_size, p[1].memref.size);
+		res = TEE_SUCCESS;
+	}
+	else if ((sess->step_in_size != p[0].memref.size) || (sess->step_out_size != p[1].memref.size))
+	{
+		EMSG("The buffers do not match the running update.\n");
+		fwu_step_reset(sess);
+		return TEE_ERROR_BAD_STATE;
+	}
+
+	while ((TEE_SUCCESS == res) && (FWU_STAGE_DONE != sess->step_stage))
+	{
+		if (FWU_STAGE_UPDATE == sess->step_stage)
+		{
+			/* Update one FIP, the TSIP batch of a FIP can not be split. */
+			if ((sess->step_load_pos + sizeof(fip_toc_header_t)) >= (sess->step_in_size - 1))
+			{
+				EMSG("Loaded data doesn't match the FIP format\n");
+				res = TEE_ERROR_GENERIC;
+				break;
+			}
+
+			fip_load_addr = (uintptr_t)p[0].memref.buffer + sess->step_load_pos;
+			fip_out_addr = (uintptr_t)p[1].memref.buffer + sess->step_out_pos;
+			fip_name = ((fip_toc_header_t *)fip_load_addr)->name;
+			fip_flags = ((fip_toc_header_t *)fip_load_addr)->flags >> 32;
+			load_size = sess->step_in_size - sess->step_load_pos;
+			out_size = sess->step_out_size - sess->step_out_pos;
+
+			res = fip_out_layout((uintptr_t)p[0].memref.buffer, sess->step_in_size, &place);
+			if (TEE_SUCCESS != res)
+				break;
+			place.offset = sess->step_out_pos;
+
+			fwu_preerase_fip(&sess->step_erase, fip_name, fip_load_addr,
+							 (uintptr_t)p[0].memref.buffer + sess->step_in_size - 1, &place);
+
+			res = fip_update(fip_name, fip_load_addr, &load_size, fip_out_addr, &out_size, &place, false);
+			if (TEE_SUCCESS != res)
+				break;
+
+			sess->step_load_pos += load_size;
+			sess->step_out_pos += out_size;
+
+			if ((0 != (fip_flags & FIP_FLAGS_END_OF_FILE)) ||
+				(sess->step_load_pos >= (sess->step_in_size - 1)))
+			{
+				res = fwu_step_digest(sess, p[1].memref.buffer);
+				if (TEE_SUCCESS != res)
+					break;
+				sess->step_stage = FWU_STAGE_WRITE;
+			}
+		}
+		else
+		{
+			/* Write one chunk, aligned to the erase sectors. */
+			out_size = sess->step_out_pos - sess->step_written;
+			if (sess->step_chunk < out_size)
+				out_size = sess->step_chunk;
+
+			/* The work buffer is shared with the client, it must still hold the output. */
+			res = fwu_digest_sha256((const uint8_t *)p[1].memref.buffer + sess->step_written, out_size, digest);
+			if (TEE_SUCCESS != res)
+				break;
+			if (0 != memcmp(digest, sess->step_digest[sess->step_written / sess->step_chunk], sizeof(digest)))
+			{
+				EMSG("The output has changed since its update.\n");
+				res = TEE_ERROR_SECURITY;
+				break;
+			}
+
+			res = fwu_preerase_write(&sess->step_erase, sess->step_written,
+									 (uintptr_t)p[1].memref.buffer + sess->step_written, out_size);
+			if (TEE_SUCCESS != res)
+			{
+				EMSG("fip_write error\n");
+				break;
+			}
+
+			sess->step_written += out_size;
+			if (sess->step_written == sess->step_out_pos)
+			{
+				res = fwu_slot_activate(p[1].memref.buffer, sess->step_written);
+				if (TEE_SUCCESS != res)
+					break;
+				sess->step_stage = FWU_STAGE_DONE;
+			}
+		}
+
+		if (fwu_elapsed_ms(&start) >= budget)
+			break;
+	}
+
+	if (TEE_SUCCESS != res)
+	{
+		fwu_step_reset(sess);
+		return res;
+	}
+
+	if (FWU_STAGE_DONE == sess->step_stage)
+	{
+		p[2].value.a = FWU_STEP_DONE;
+		p[2].value.b = sess->step_written;
+		fwu_step_reset(sess);
+	}
+	else
+	{
+		p[2].value.a = FWU_STEP_CONTINUE;
+		p[2].value.b = (FWU_STAGE_WRITE == sess->step_stage) ? sess->step_written : sess->step_load_pos;
+	}
+
+	return TEE_SUCCESS;
+}
+
+static void fwu_batch_reset(struct fwu_session *sess)
+{
+	sess->batch_count = 0;
+	sess->batch_out_size = 0;
+	sess->batch_tail = 0;
+	if (TEE_HANDLE_NULL != sess->batch_digest)
+		TEE_ResetOperation(sess->batch_digest);
+}
+
+/*
+ * Hash the output [start, end) with the END_OF_FILE flag of the FIP header
+ * at tail cleared
+ */
+static void fwu_batch_hash(TEE_OperationHandle op, uintptr_t start, uintptr_t tail, uintptr_t end)
+{
+	fip_toc_header_t hdr = *(const fip_toc_header_t *)tail;
+
+	hdr.flags &= ~((uint64_t)FIP_FLAGS_END_OF_FILE << 32);
+	TEE_DigestUpdate(op, (const void *)start, tail - start);
+	TEE_DigestUpdate(op, &hdr, sizeof(hdr));
+	TEE_DigestUpdate(op, (const void *)(tail + sizeof(hdr)), end - (tail + sizeof(hdr)));
+}
+
+static TEE_Result fwu_batch_add(struct fwu_session *sess, uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
+{
+	TEE_Result res = TEE_SUCCESS;
+	uintptr_t fip_load_addr, fip_load_max;
+	uintptr_t fip_out_addr, fip_out_max;
+	uintptr_t fip_tail = 0;
+	uintptr_t out_buff;
+	uint32_t load_size, out_size;
+	uint32_t fip_name, fip_flags;
+	fip_toc_header_t *prev_tail;
+	struct fip_out_place place;
+
+	uint32_t exp_type = TEE_PARAM_TYPES(TEE_PARAM_TYPE_MEMREF_INPUT,
+										TEE_PARAM_TYPE_MEMREF_INOUT,
+										TEE_PARAM_TYPE_VALUE_INOUT,
+										TEE_PARAM_TYPE_NONE);
+
+	DMSG("has been called");
+
+	if (type != exp_type)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	/* The first package starts a new batch. */
+	if (0 == p[2].value.a)
+		fwu_batch_reset(sess);
+	else if (sess->batch_count != p[2].value.a)
+		return TEE_ERROR_BAD_STATE;
+
+	if ((0 == p[0].memref.size) || (sess->batch_out_size >= p[1].memref.size))
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	out_buff = (uintptr_t)p[1].memref.buffer;
+	fip_load_addr = (uintptr_t)p[0].memref.buffer;
+	fip_load_max = fip_load_addr + p[0].memref.size - 1;
+	fip_out_addr = out_buff + sess->batch_out_size;
+	fip_out_max = out_buff + p[1].memref.size - 1;
+
+	res = fip_out_layout(fip_load_addr, p[0].memref.size, &place);
+	if (TEE_SUCCESS != res)
+	{
+		fwu_batch_reset(sess);
+		return res;
+	}
+
+	do
+	{
+		if ((fip_load_addr + sizeof(fip_toc_header_t)) >= fip_load_max)
+		{
+			EMSG("Loaded data doesn't match the FIP format\n");
+			res = TEE_ERROR_GENERIC;
+			break;
+		}
+
+		fip_name = ((fip_toc_header_t *)fip_load_addr)->name;
+		fip_flags = ((fip_toc_header_t *)fip_load_addr)->flags >> 32;
+		load_size = (fip_load_max + 1) - fip_load_addr;
+		out_size = (fip_out_max + 1) - fip_out_addr;
+		place.offset = fip_out_addr - out_buff;
+
+		res = fip_update(fip_name, fip_load_addr, &load_size, fip_out_addr, &out_size, &place, false);
+		if (TEE_SUCCESS != res)
+			break;
+
+		/* The directory FIP has no output, the tail is the last written FIP. */
+		if (0 != out_size)
+			fip_tail = fip_out_addr;
+		fip_load_addr += load_size;
+		fip_out_addr += out_size;
+
+		if (0 != (fip_flags & FIP_FLAGS_END_OF_FILE))
+			break;
+
+	} while (fip_load_addr < fip_load_max);
+
+	if ((TEE_SUCCESS == res) && (0 == fip_tail))
+	{
+		EMSG("The package has no output.\n");
+		res = TEE_ERROR_BAD_FORMAT;
+	}
+
+	if ((TEE_SUCCESS == res) && (TEE_HANDLE_NULL == sess->batch_digest))
+		res = TEE_AllocateOperation(&sess->batch_digest, TEE_ALG_SHA256, TEE_MODE_DIGEST, 0);
+
+	if (TEE_SUCCESS != res)
+	{
+		/* A failed package aborts the whole batch. */
+		fwu_batch_reset(sess);
+		return res;
+	}
+
+	/* Chain the package to the previous one. */
+	if (0 != sess->batch_count)
+	{
+		prev_tail = (fip_toc_header_t *)(out_buff + sess->batch_tail);
+		prev_tail->flags &= ~((uint64_t)FIP_FLAGS_END_OF_FILE << 32);
+	}
+
+	/* The last FIP header is hashed as it will be once the next package is chained. */
+	sess->batch_tail_hdr = *(const fip_toc_header_t *)fip_tail;
+	fwu_batch_hash(sess->batch_digest, out_buff + sess->batch_out_size, fip_tail, fip_out_addr);
+
+	sess->batch_count++;
+	sess->batch_tail = fip_tail - out_buff;
+	sess->batch_out_size = fip_out_addr - out_buff;
+
+	p[2].value.a = sess->batch_count;
+	p[2].value.b = sess->batch_out_size;
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result fwu_batch_commit(struct fwu_session *sess, uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
+{
+	TEE_Result res;
+	TEE_OperationHandle op = TEE_HANDLE_NULL;
+	uintptr_t out_buff;
+	uint8_t digest[FIP_DIR_DIGEST_SIZE];
+	uint8_t expect[FIP_DIR_DIGEST_SIZE];
+	size_t digest_size = sizeof(expect);
+
+	uint32_t exp_type = TEE_PARAM_TYPES(TEE_PARAM_TYPE_MEMREF_INPUT,
+										TEE_PARAM_TYPE_VALUE_OUTPUT,
+										TEE_PARAM_TYPE_NONE,
+										TEE_PARAM_TYPE_NONE);
+
+	DMSG("has been called");
+
+	if (type != exp_type)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	if (0 == sess->batch_count)
+		return TEE_ERROR_BAD_STATE;
+
+	if (sess->batch_out_size > p[0].memref.size)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	/* The buffer must still hold the output of FWU_CMD_BATCH_ADD. */
+	out_buff = (uintptr_t)p[0].memref.buffer;
+	res = TEE_DigestDoFinal(sess->batch_digest, NULL, 0, expect, &digest_size);
+	if (TEE_SUCCESS == res)
+		res = TEE_AllocateOperation(&op, TEE_ALG_SHA256, TEE_MODE_DIGEST, 0);
+	if (TEE_SUCCESS == res)
+	{
+		fwu_batch_hash(op, out_buff, out_buff + sess->batch_tail, out_buff + sess->batch_out_size);
+		res = TEE_DigestDoFinal(op, NULL, 0, digest, &digest_size);
+		TEE_FreeOperation(op);
+	}
+	if ((TEE_SUCCESS == res) &&
+		((0 != memcmp(digest, expect, sizeof(digest))) ||
+		 (0 != memcmp((const void *)(out_buff + sess->batch_tail), &sess->batch_tail_hdr, sizeof(sess->batch_tail_hdr)))))
+	{
+		EMSG("The batch output has changed since it was added.\n");
+		res = TEE_ERROR_SECURITY;
+	}
+	if (TEE_SUCCESS != res)
+	{
+		fwu_batch_reset(sess);
+		return res;
+	}
+
+	res = fip_write_fw(0, (uintptr_t)p[0].memref.buffer, sess->batch_out_size);
+	if (res == (TEE_Result)TEE_SUCCESS)
+		res = fwu_slot_activate(p[0].memref.buffer, sess->batch_out_size);
+	if (res != (TEE_Result)TEE_SUCCESS)
+		EMSG("fip_write error\n");
+	else
+	{
+		p[1].value.a = sess->batch_count;
+		p[1].value.b = sess->batch_out_size;
+	}
+
+	fwu_batch_reset(sess);
+
+	return res;
+}
+
+static TEE_Result fwu_get_mem_stats(uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
+{
+	uint32_t exp_type = TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_OUTPUT,
+										TEE_PARAM_TYPE_VALUE_OUTPUT,
+										TEE_PARAM_TYPE_NONE,
+										TEE_PARAM_TYPE_NONE);
+
+	DMSG("has been called");
+
+	if (type != exp_type)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	p[0].value.a = fwu_arena_high_water();
+	p[0].value.b = FWU_ARENA_SIZE;
+	p[1].value.a = fwu_stack_usage;
+	p[1].value.b = TA_STACK_SIZE;
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result fwu_get_storage_info(uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
+{
+	TEE_Result res;
+	struct fwu_storage_geometry geo;
+	uint32_t exp_type = TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_OUTPUT,
+										TEE_PARAM_TYPE_VALUE_OUTPUT,
+										TEE_PARAM_TYPE_VALUE_OUTPUT,
+										TEE_PARAM_TYPE_NONE);
+
+	DMSG("has been called");
+
+	if (type != exp_type)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	res = fwu_storage_info(&geo);
+	if (TEE_SUCCESS != res)
+		return res;
+
+	p[0].value.a = fwu_storage_get()->type;
+	p[0].value.b = geo.capacity;
+	p[1].value.a = geo.block_size;
+	p[1].value.b = geo.erase_size;
+	p[2].value.a = geo.max_transfer;
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result fwu_list_components(uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
+{
+	TEE_Result res = TEE_SUCCESS;
+	struct fwu_component_stats *stats;
+	uintptr_t fip_load_addr, fip_load_max;
+	uint32_t load_size, out_size, fip_name, fip_flags;
+	uint32_t count = 0;
+	struct fip_out_place place = { .offset = 0 };
+	uint32_t exp_type = TEE_PARAM_TYPES(TEE_PARAM_TYPE_MEMREF_INPUT,
+										TEE_PARAM_TYPE_MEMREF_OUTPUT,
+										TEE_PARAM_TYPE_VALUE_OUTPUT,
+										TEE_PARAM_TYPE_NONE);
+
+	DMSG("has been called");
+
+	if (type != exp_type)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	if (0 == p[0].memref.size)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	if ((sizeof(struct fwu_component_stats) * FWU_COMP_MAX) > p[1].memref.size)
+	{
+		p[1].memref.size = sizeof(struct fwu_component_stats) * FWU_COMP_MAX;
+		return TEE_ERROR_SHORT_BUFFER;
+	}
+
+	stats = (struct fwu_component_stats *)p[1].memref.buffer;
+	memset(stats, 0, sizeof(struct fwu_component_stats) * FWU_COMP_MAX);
+
+	fip_load_addr = (uintptr_t)p[0].memref.buffer;
+	fip_load_max = fip_load_addr + p[0].memref.size - 1;
+
+	res = fip_out_layout(fip_load_addr, p[0].memref.size, &place);
+	if (TEE_SUCCESS != res)
+		return res;
+
+	/* Only the sizing rules are used, nothing is re-encrypted. */
+	do
+	{
+		if ((fip_load_addr + sizeof(fip_toc_header_t)) >= fip_load_max)
+		{
+			EMSG("Loaded data doesn't match the FIP format\n");
+			res = TEE_ERROR_GENERIC;
+			break;
+		}
+
+		fip_name = ((fip_toc_header_t *)fip_load_addr)->name;
+		fip_flags = ((fip_toc_header_t *)fip_load_addr)->flags >> 32;
+
+		res = fip_calc_out_size(fip_name, fip_load_addr, fip_load_max, &place, &load_size, &out_size);
+		if (TEE_SUCCESS == res)
+			res = fip_components(fip_name, fip_load_addr, fip_load_max, stats);
+		if (TEE_SUCCESS != res)
+			break;
+
+		count++;
+		fip_load_addr += load_size;
+		place.offset += out_size;
+
+		if (0 != (fip_flags & FIP_FLAGS_END_OF_FILE))
+			break;
+
+	} while (fip_load_addr < fip_load_max);
+
+	if (TEE_SUCCESS != res)
+		return res;
+
+	p[1].memref.size = sizeof(struct fwu_component_stats) * FWU_COMP_MAX;
+	p[2].value.a = count;
+	p[2].value.b = FWU_COMP_MAX;
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result fwu_get_component_stats(uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
+{
+	uint32_t exp_type = TEE_PARAM_TYPES(TEE_PARAM_TYPE_MEMREF_OUTPUT,
+										TEE_PARAM_TYPE_VALUE_INOUT,
+										TEE_PARAM_TYPE_NONE,
+										TEE_PARAM_TYPE_NONE);
+
+	DMSG("has been called");
+
+	if (type != exp_type)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	if ((sizeof(struct fwu_component_stats) * FWU_COMP_MAX) > p[0].memref.size)
+	{
+		p[0].memref.size = sizeof(struct fwu_component_stats) * FWU_COMP_MAX;
+		return TEE_ERROR_SHORT_BUFFER;
+	}
+
+	fwu_component_get_stats((struct fwu_component_stats *)p[0].memref.buffer, 1 == p[1].value.a);
+	p[0].memref.size = sizeof(struct fwu_component_stats) * FWU_COMP_MAX;
+	p[1].value.a = FWU_COMP_MAX;
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result fwu_get_slot_info(uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
+{
+	TEE_Result res;
+	uint32_t exp_type = TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_OUTPUT,
+										TEE_PARAM_TYPE_VALUE_OUTPUT,
+										TEE_PARAM_TYPE_NONE,
+										TEE_PARAM_TYPE_NONE);
+
+	DMSG("has been called");
+
+	if (type != exp_type)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	res = fwu_slot_info(&p[0].value.a, &p[0].value.b, &p[1].value.a);
+	if (TEE_SUCCESS != res)
+		return res;
+
+	p[1].value.b = FWU_SLOT_SIZE;
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result fwu_dispatch(struct fwu_session *sess, uint32_t commandID,
+							   uint32_t ptypes, TEE_Param params[TEE_NUM_PARAMS])
+{
+	/* Nothing in the arena lives longer than a command. */
+	fwu_arena_reset();
+
+	switch (commandID)
+	{
+	case FWU_CMD_CALC_WORK_SIZE:
+		return fwu_calc_work_size(ptypes, params);
+	case FWU_CMD_FIRMWARE_UPDATE:
+		return fwu_firmware_update(ptypes, params);
+	case FWU_CMD_GET_SECTIONS:
+		return fwu_get_sections(sess, ptypes, params);
+	case FWU_CMD_UPDATE_SECTION:
+		return fwu_update_section(sess, ptypes, params);
+	case FWU_CMD_COMMIT:
+		return fwu_commit(sess, ptypes, params);
+	case FWU_CMD_UPDATE_STEP:
+		return fwu_update_step(sess, ptypes, params);
+	case FWU_CMD_GET_MEM_STATS:
+		return fwu_get_mem_stats(ptypes, params);
+	case FWU_CMD_GET_STORAGE_INFO:
+		return fwu_get_storage_info(ptypes, params);
+	case FWU_CMD_BATCH_ADD:
+		return fwu_batch_add(sess, ptypes, params);
+	case FWU_CMD_BATCH_COMMIT:
+		return fwu_batch_commit(sess, ptypes, params);
+	case FWU_CMD_LIST_COMPONENTS:
+		return fwu_list_components(ptypes, params);
+	case FWU_CMD_GET_COMPONENT_STATS:
+		return fwu_get_component_stats(ptypes, params);
+	case FWU_CMD_GET_SLOT_INFO:
+		return fwu_get_slot_info(ptypes, params);
+	default:
+		break;
+	}
+	return TEE_ERROR_NOT_IMPLEMENTED;
+}
+
+/*
+ * Get the parameters of a ring descriptor. The memrefs must be inside the
+ * data area of the ring, after the descriptors.
+ */
+static TEE_Result fwu_ring_params(uint8_t *ring, uint32_t ring_size, uint32_t data_offset,
+								  const struct fwu_ring_desc *desc, TEE_Param p[TEE_NUM_PARAMS])
+{
+	uint32_t i;
+
+	memset(p, 0, sizeof(TEE_Param) * TEE_NUM_PARAMS);
+
+	for (i = 0; i < TEE_NUM_PARAMS; i++)
+	{
+		switch (TEE_PARAM_TYPE_GET(desc->param_types, i))
+		{
+		case TEE_PARAM_TYPE_NONE:
+			break;
+		case TEE_PARAM_TYPE_VALUE_INPUT:
+		case TEE_PARAM_TYPE_VALUE_OUTPUT:
+		case TEE_PARAM_TYPE_VALUE_INOUT:
+			p[i].value.a = desc->param[i].a;
+			p[i].value.b = desc->param[i].b;
+			break;
+		case TEE_PARAM_TYPE_MEMREF_INPUT:
+		case TEE_PARAM_TYPE_MEMREF_OUTPUT:
+		case TEE_PARAM_TYPE_MEMREF_INOUT:
+			if ((data_offset > desc->param[i].a) || (ring_size < desc->param[i].a) ||
+				((ring_size - desc->param[i].a) < desc->param[i].b))
+			{
+				EMSG("The memref %u is outside of the ring data.\n", i);
+				return TEE_ERROR_BAD_PARAMETERS;
+			}
+			p[i].memref.buffer = ring + desc->param[i].a;
+			p[i].memref.size = desc->param[i].b;
+			break;
+		default:
+			return TEE_ERROR_BAD_PARAMETERS;
+		}
+	}
+
+	return TEE_SUCCESS;
+}
+
+/* Return the output parameters to a ring descriptor */
+static void fwu_ring_results(struct fwu_ring_desc *desc, const TEE_Param p[TEE_NUM_PARAMS])
+{
+	uint32_t i;
+
+	for (i = 0; i < TEE_NUM_PARAMS; i++)
+	{
+		switch (TEE_PARAM_TYPE_GET(desc->param_types, i))
+		{
+		case TEE_PARAM_TYPE_VALUE_OUTPUT:
+		case TEE_PARAM_TYPE_VALUE_INOUT:
+			desc->param[i].a = p[i].value.a;
+			desc->param[i].b = p[i].value.b;
+			break;
+		case TEE_PARAM_TYPE_MEMREF_OUTPUT:
+		case TEE_PARAM_TYPE_MEMREF_INOUT:
+			desc->param[i].b = p[i].memref.size;
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+static TEE_Result fwu_ring_submit(struct fwu_session *sess, uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
+{
+	TEE_Result res;
+	TEE_Param params[TEE_NUM_PARAMS];
+	struct fwu_ring_header hdr;
+	struct fwu_ring_header *ring_hdr;
+	struct fwu_ring_desc *ring_desc;
+	struct fwu_ring_desc desc;
+	uint8_t *ring;
+	uint32_t ring_size, data_offset;
+	uint32_t done = 0;
+	uint32_t exp_type = TEE_PARAM_TYPES(TEE_PARAM_TYPE_MEMREF_INOUT,
+										TEE_PARAM_TYPE_VALUE_OUTPUT,
+										TEE_PARAM_TYPE_NONE,
+										TEE_PARAM_TYPE_NONE);
+
+	DMSG("has been called");
+
+	if (type != exp_type)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	ring = (uint8_t *)p[0].memref.buffer;
+	ring_size = p[0].memref.size;
+	if (sizeof(hdr) > ring_size)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	/* The CA may change the ring meanwhile, only local copies are used. */
+	ring_hdr = (struct fwu_ring_header *)ring;
+	memcpy(&hdr, ring_hdr, sizeof(hdr));
+	if ((FWU_RING_MAGIC != hdr.magic) || (0 == hdr.entries) || (FWU_RING_ENTRY_MAX < hdr.entries) ||
+		(((ring_size - sizeof(hdr)) / sizeof(desc)) < hdr.entries) || (hdr.entries < (hdr.tail - hdr.head)))
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	ring_desc = (struct fwu_ring_desc *)(ring + sizeof(hdr));
+	data_offset = sizeof(hdr) + (hdr.entries * sizeof(desc));
+
+	for (; hdr.head != hdr.tail; hdr.head++)
+	{
+		memcpy(&desc, &ring_desc[hdr.head % hdr.entries], sizeof(desc));
+
+		if (FWU_CMD_RING_SUBMIT == desc.cmd)
+			res = TEE_ERROR_BAD_PARAMETERS;
+		else
+			res = fwu_ring_params(ring, ring_size, data_offset, &desc, params);
+
+		if (TEE_SUCCESS == res)
+		{
+			res = fwu_dispatch(sess, desc.cmd, desc.param_types, params);
+			fwu_ring_results(&desc, params);
+		}
+
+		desc.result = res;
+		memcpy(&ring_desc[hdr.head % hdr.entries], &desc, sizeof(desc));
+		done++;
+
+		if (TEE_SUCCESS != res)
+		{
+			hdr.head++;
+			break;
+		}
+	}
+
+	ring_hdr->head = hdr.head;
+	p[1].value.a = done;
+
+	return TEE_SUCCESS;
+}
+
+/*
+ * Trusted Application Entry Points
+ */
+
+TEE_Result TA_CreateEntryPoint(void)
+{
+	DMSG("has been called");
+	return TEE_SUCCESS;
+}
+
+void TA_DestroyEntryPoint(void)
+{
+	DMSG("has been called");
+}
+
+TEE_Result TA_OpenSessionEntryPoint(uint32_t paramTypes __unused,
+									TEE_Param __unused pParams[TEE_NUM_PARAMS], void **sessionContext)
+{
+	struct fwu_session *sess;
+
+	DMSG("has been called");
+
+	sess = TEE_Malloc(sizeof(struct fwu_session), TEE_MALLOC_FILL_ZERO);
+	if (NULL == sess)
+		return TEE_ERROR_OUT_OF_MEMORY;
+
+	*sessionContext = sess;
+
+	return TEE_SUCCESS;
+}
+
+void TA_CloseSessionEntryPoint(void *sessionContext)
+{
+	DMSG("has been called");
+
+	/* Abort the section update of this session. */
+	if (sessionContext == fwu_txn.owner)
+		memset(&fwu_txn, 0, sizeof(fwu_txn));
+
+	fwu_step_reset((struct fwu_session *)sessionContext);
+
+	if (TEE_HANDLE_NULL != ((struct fwu_session *)sessionContext)->batch_digest)
+		TEE_FreeOperation(((struct fwu_session *)sessionContext)->batch_digest);
+
+	TEE_Free(sessionContext);
+}
+
+TEE_Result TA_InvokeCommandEntryPoint(void *sessionContext, uint32_t commandID,
+									  uint32_t ptypes, TEE_Param params[TEE_NUM_PARAMS])
+{
+	struct fwu_session *sess = (struct fwu_session *)sessionContext;
+
+	if (FWU_CMD_RING_SUBMIT == commandID)
+		return fwu_ring_submit(sess, ptypes, params);
+
+	return fwu_dispatch(sess, commandID, ptypes, params);
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * Generate the perfect hash table of the component UUIDs (FWU_COMPONENTS)
+ * for ta/fwu_component.c. Built and run with the host compiler by
+ * ta/Makefile, the output is fwu_component_table.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "fwu_component.h"
+
+#define TABLE_SIZE_MAX 256
+#define SEED_MAX 100000
+
+#define FWU_COMPONENT_SLOT(id, name, uuid) { uuid, FWU_COMP_##id },
+
+static const struct fwu_component_slot components[] = {
+	FWU_COMPONENTS(FWU_COMPONENT_SLOT)
+};
+
+#define COMPONENT_COUNT (sizeof(components) / sizeof(components[0]))
+
+static int try_seed(uint32_t seed, uint32_t size, int *slot)
+{
+	uint32_t i, idx;
+
+	for (i = 0; i < size; i++)
+		slot[i] = -1;
+
+	for (i = 0; i < COMPONENT_COUNT; i++)
+	{
+		idx = fwu_component_hash(&components[i].uuid, seed) & (size - 1);
+		if (0 <= slot[idx])
+			return -1;
+		slot[idx] = (int)i;
+	}
+
+	return 0;
+}
+
+int main(void)
+{
+	int slot[TABLE_SIZE_MAX];
+	uint32_t size, seed = 0;
+	const uint8_t *u;
+	uint32_t i;
+	int found = 0;
+
+	for (size = 1; size < COMPONENT_COUNT; size <<= 1)
+		;
+
+	for (; (size <= TABLE_SIZE_MAX) && !found; size <<= 1)
+	{
+		for (seed = 0; seed < SEED_MAX; seed++)
+		{
+			if (0 == try_seed(seed, size, slot))
+			{
+				found = 1;
+				break;
+			}
+		}
+	}
+
+	if (!found)
+	{
+		fprintf(stderr, "gen_components: no perfect hash found\n");
+		return 1;
+	}
+	size >>= 1;
+
+	printf("/* Generated by ta/gen/gen_components.c, do not edit. */\n");
+	printf("#define FWU_COMPONENT_SEED (0x%08xU)\n", seed);
+	printf("#define FWU_COMPONENT_TABLE_SIZE (%u)\n\n", size);
+	printf("static const struct fwu_component_slot fwu_component_table[FWU_COMPONENT_TABLE_SIZE] = {\n");
+	for (i = 0; i < size; i++)
+	{
+		if (slot[i] < 0)
+			continue;
+
+		u = (const uint8_t *)&components[slot[i]].uuid;
+		printf("\t[%u] = { {{0x%02x, 0x%02x, 0x%02x, 0x%02x}, {0x%02x, 0x%02x}, {0x%02x, 0x%02x}, 0x%02x, 0x%02x, ",
+			i, u[0], u[1], u[2], u[3], u[4], u[5], u[6], u[7], u[8], u[9]);
+		printf("{0x%02x, 0x%02x, 0x%02x, 0x%02x, 0x%02x, 0x%02x} }, %u },\n",
+			u[10], u[11], u[12], u[13], u[14], u[15], components[slot[i]].id);
+	}
+	printf("};\n");
+
+	return 0;
+}
@@ -7,6 +7,8 @@
 #ifndef FLASH_PTA_H_
 #define FLASH_PTA_H_
 
+#include <stdint.h>
+
 #define FLASH_UUID                                         \
 	{                                                      \
 		0x2c0fca92, 0x5ab1, 0x11eb,                        \
@@ -24,4 +26,67 @@
  */
 #define FLASH_CMD_WRITE_SPI 1
 
+/*
+ * FLASH_CMD_GET_INFO - Get the geometry of SPI Flash
+ * param[0] (value) a: page size, b: erase sector size
+ * param[1] (value) a: maximum size of a FLASH_CMD_WRITE_SPI call, b: flash size
+ * param[2] unused
+ * param[3] unused
+ */
+#define FLASH_CMD_GET_INFO 2
+
+/*
+ * FLASH_CMD_ERASE_RANGE - Erase SPI Flash
+ * param[0] (value) a: spi offset address, b: size, aligned to the erase sector size
+ * param[1] unused
+ * param[2] unused
+ * param[3] unused
+ */
+#define FLASH_CMD_ERASE_RANGE 3
+
+/*
+ * FLASH_CMD_PROGRAM_SPI - Write data to erased SPI Flash without erasing it
+ * param[0] (value) spi save offset address
+ * param[1] (memref) Write data buffer
+ * param[2] unused
+ * param[3] unused
+ */
+#define FLASH_CMD_PROGRAM_SPI 4
+
+/*
+ * FLASH_CMD_READ_SPI - Read data from SPI Flash
+ * param[0] (value) spi offset address
+ * param[1] (memref) Read data buffer
+ * param[2] unused
+ * param[3] unused
+ */
+#define FLASH_CMD_READ_SPI 5
+
+/*
+ * FLASH_CMD_WRITE_SPI_VEC - Write several segments to SPI Flash in one call
+ * param[0] (memref) struct flash_spi_seg array, sorted by offset without overlap
+ * param[1] (memref) Data buffer 0
+ * param[2] (memref) Data buffer 1, or unused
+ * param[3] (value) a: FLASH_SPI_VEC_xxx flags
+ *
+ * The erase sectors of all segments are erased once, merged across the
+ * segments, before they are programmed, unless FLASH_SPI_VEC_PROGRAM is set.
+ * The total size of the segments is at most the maximum size of a
+ * FLASH_CMD_WRITE_SPI call.
+ */
+#define FLASH_CMD_WRITE_SPI_VEC 6
+
+/* Maximum number of segments of a FLASH_CMD_WRITE_SPI_VEC call */
+#define FLASH_SPI_VEC_MAX 32
+
+/* The sectors of the segments are erased already, only program them */
+#define FLASH_SPI_VEC_PROGRAM 0x1
+
+struct flash_spi_seg {
+	uint32_t offset;        /* spi offset address */
+	uint32_t buf;           /* 0: data in param[1], 1: data in param[2] */
+	uint32_t buf_offset;    /* Offset of the data in the buffer */
+	uint32_t size;
+};
+
 #endif /* FLASH_PTA_H_ */
\ No newline at end of file
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FWU_ARENA_H
+#define FWU_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fwu_board.h"
+
+/*
+ * Per-command memory of the TA.
+ * The arena is a fixed block in the TA data, all allocations are released
+ * at the start of each command, so an update never depends on the heap.
+ */
+#define FWU_ARENA_SIZE (4 * 1024)
+#define FWU_ARENA_ALIGN (8)
+
+/*
+ * Typed pools, reserved at the top of the arena for the objects an update
+ * needs in a number that depends on the package. Other allocations can not
+ * take their capacity, so the update does not run out of them half-way.
+ */
+enum fwu_pool_id {
+	FWU_POOL_PTA_DESC,      /* update_fw_t descriptors of the TSIP PTA */
+	FWU_POOL_TOC_INDEX,     /* struct fwu_storage_seg of the plain ToC entries and their write list */
+	FWU_POOL_COUNT,
+};
+
+/* Capacity of the pools in objects */
+#define FWU_POOL_PTA_DESC_MAX (2 * FWU_BOARD_TSIP_BATCH_MAX)
+#define FWU_POOL_TOC_INDEX_MAX (3 * 32 + 1)     /* 32 plain ToC entries of fwu_ta.c and the write list */
+
+/* Allocate zero-filled count objects of type from the arena */
+#define FWU_ARENA_NEW(type, count) \
+	((type *)fwu_arena_alloc(sizeof(type) * (size_t)(count)))
+
+/* Allocate zero-filled count objects of type from the pool id */
+#define FWU_POOL_NEW(id, type, count) \
+	((type *)fwu_pool_alloc((id), sizeof(type), (uint32_t)(count)))
+
+/* Usage of the arena and of its pools */
+struct fwu_arena_pos {
+	size_t used;
+	uint32_t pool_used[FWU_POOL_COUNT];
+};
+
+/* Release all allocations */
+void fwu_arena_reset(void);
+
+/* Current usage of the arena, to release the allocations made after it */
+void fwu_arena_mark(struct fwu_arena_pos *pos);
+
+/* Release all allocations made after fwu_arena_mark() returned pos */
+void fwu_arena_release(const struct fwu_arena_pos *pos);
+
+/* Allocate from a pool, size is the object size of the pool */
+void *fwu_pool_alloc(enum fwu_pool_id id, size_t size, uint32_t count);
+
+/* Allocate zero-filled memory, returns NULL if the arena is exhausted */
+void *fwu_arena_alloc(size_t size);
+
+/* Highest usage of the arena since the TA has been loaded */
+uint32_t fwu_arena_high_water(void);
+
+/* Upper bound of the stack used by the TA sources, from -fstack-usage (fwu_stack.c) */
+extern const uint32_t fwu_stack_usage;
+
+#endif /* FWU_ARENA_H */
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FWU_BOARD_H
+#define FWU_BOARD_H
+
+/*
+ * Board profiles, selected with FWU_BOARD in ta/Makefile. The host tools
+ * (fwu --plan) take the geometry of all profiles from FWU_BOARD_PROFILES.
+ *
+ * X(id, name, spi_package_offset, spi_end_offset, spi_page_size,
+ *   spi_erase_size, write_chunk_size, tsip_batch_max, tsip_chunk_size)
+ *
+ * spi_package_offset  top of the staging area in SPI flash
+ * spi_end_offset      end of the staging area
+ * spi_page_size       program page of the SPI flash
+ * spi_erase_size      erase sector of the SPI flash
+ * write_chunk_size    size of a write of FWU_CMD_UPDATE_STEP
+ * tsip_batch_max      number of data re-encrypted by one TSIP call
+ * tsip_chunk_size     larger data are re-encrypted in pieces of this size
+ *
+ * The flash PTA may still report another geometry (FLASH_CMD_GET_INFO).
+ */
+
+/* Settings usable on all boards, the geometry of the EK874 (RZ/G2E) */
+#define FWU_BOARD_PROFILE_GENERIC(X) \
+	X(GENERIC, "generic", (0x3000000), (0x4000000), (0x100), (0x10000), (0x40000), (16), (0x40000))
+
+/* HiHope RZ/G2[M,N,H], QSPI flash with 256 KB sectors */
+#define FWU_BOARD_PROFILE_HIHOPE_RZG2(X) \
+	X(HIHOPE_RZG2, "hihope-rzg2", (0x3000000), (0x4000000), (0x200), (0x40000), (0x100000), (16), (0x100000))
+
+#define FWU_BOARD_PROFILES(X) \
+	FWU_BOARD_PROFILE_GENERIC(X) \
+	FWU_BOARD_PROFILE_HIHOPE_RZG2(X)
+
+#define FWU_BOARD_ID_GENERIC 0
+#define FWU_BOARD_ID_HIHOPE_RZG2M 2
+#define FWU_BOARD_ID_HIHOPE_RZG2N 3
+#define FWU_BOARD_ID_HIHOPE_RZG2H 4
+
+#ifndef CFG_FWU_BOARD
+#define CFG_FWU_BOARD FWU_BOARD_ID_GENERIC
+#endif
+
+#if (CFG_FWU_BOARD == FWU_BOARD_ID_HIHOPE_RZG2M) || \
+	(CFG_FWU_BOARD == FWU_BOARD_ID_HIHOPE_RZG2N) || \
+	(CFG_FWU_BOARD == FWU_BOARD_ID_HIHOPE_RZG2H)
+#define FWU_BOARD_PROFILE FWU_BOARD_PROFILE_HIHOPE_RZG2
+#elif (CFG_FWU_BOARD == FWU_BOARD_ID_GENERIC)
+#define FWU_BOARD_PROFILE FWU_BOARD_PROFILE_GENERIC
+#else
+#error "Unknown board profile"
+#endif
+
+/* Fields of the selected profile */
+#define FWU_BOARD_X_NAME(id, name, o, e, p, s, w, b, c) name
+#define FWU_BOARD_X_SPI_PACKAGE_OFFSET(id, name, o, e, p, s, w, b, c) o
+#define FWU_BOARD_X_SPI_END_OFFSET(id, name, o, e, p, s, w, b, c) e
+#define FWU_BOARD_X_SPI_PAGE_SIZE(id, name, o, e, p, s, w, b, c) p
+#define FWU_BOARD_X_SPI_ERASE_SIZE(id, name, o, e, p, s, w, b, c) s
+#define FWU_BOARD_X_WRITE_CHUNK_SIZE(id, name, o, e, p, s, w, b, c) w
+#define FWU_BOARD_X_TSIP_BATCH_MAX(id, name, o, e, p, s, w, b, c) b
+#define FWU_BOARD_X_TSIP_CHUNK_SIZE(id, name, o, e, p, s, w, b, c) c
+
+#define FWU_BOARD_NAME FWU_BOARD_PROFILE(FWU_BOARD_X_NAME)
+#define FWU_BOARD_SPI_PACKAGE_OFFSET FWU_BOARD_PROFILE(FWU_BOARD_X_SPI_PACKAGE_OFFSET)
+#define FWU_BOARD_SPI_END_OFFSET FWU_BOARD_PROFILE(FWU_BOARD_X_SPI_END_OFFSET)
+#define FWU_BOARD_SPI_PAGE_SIZE FWU_BOARD_PROFILE(FWU_BOARD_X_SPI_PAGE_SIZE)
+#define FWU_BOARD_SPI_ERASE_SIZE FWU_BOARD_PROFILE(FWU_BOARD_X_SPI_ERASE_SIZE)
+#define FWU_BOARD_WRITE_CHUNK_SIZE FWU_BOARD_PROFILE(FWU_BOARD_X_WRITE_CHUNK_SIZE)
+#define FWU_BOARD_TSIP_BATCH_MAX FWU_BOARD_PROFILE(FWU_BOARD_X_TSIP_BATCH_MAX)
+#define FWU_BOARD_TSIP_CHUNK_SIZE FWU_BOARD_PROFILE(FWU_BOARD_X_TSIP_CHUNK_SIZE)
+
+#if (FWU_BOARD_SPI_END_OFFSET <= FWU_BOARD_SPI_PACKAGE_OFFSET)
+#error "The staging area is empty"
+#endif
+
+#if ((FWU_BOARD_SPI_PACKAGE_OFFSET % FWU_BOARD_SPI_ERASE_SIZE) != 0) || \
+	((FWU_BOARD_SPI_END_OFFSET % FWU_BOARD_SPI_ERASE_SIZE) != 0)
+#error "The staging area must be aligned to the erase sectors"
+#endif
+
+#if ((FWU_BOARD_SPI_ERASE_SIZE % FWU_BOARD_SPI_PAGE_SIZE) != 0) || \
+	((FWU_BOARD_WRITE_CHUNK_SIZE % FWU_BOARD_SPI_ERASE_SIZE) != 0)
+#error "The write chunk must be a multiple of the erase sector"
+#endif
+
+#if (FWU_BOARD_TSIP_BATCH_MAX < 1) || (FWU_BOARD_TSIP_BATCH_MAX > 16)
+#error "TSIP re-encrypts 1 to 16 data at once"
+#endif
+
+#if (FWU_BOARD_TSIP_CHUNK_SIZE < 0x1000) || ((FWU_BOARD_TSIP_CHUNK_SIZE % 16) != 0)
+#error "The TSIP pieces must be a multiple of the AES block"
+#endif
+
+#endif /* FWU_BOARD_H */
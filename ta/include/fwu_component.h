@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FWU_COMPONENT_H
+#define FWU_COMPONENT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "rzg_firmware_image_package.h"
+
+/* Reject unknown components outside of plain FIPs (FWU_STRICT_COMPONENTS=y) */
+#ifndef CFG_FWU_STRICT_COMPONENTS
+#define CFG_FWU_STRICT_COMPONENTS 0
+#endif
+
+/*
+ * Registry of the firmware components of the ToC entries.
+ * X(id, name, uuid) for every component UUID of rzg_firmware_image_package.h.
+ * The TA looks the UUIDs up in a perfect hash table generated from this list
+ * at build time (ta/gen/gen_components.c).
+ */
+#define FWU_COMPONENTS(X) \
+	X(NS_BL2U, "ns-bl2u", UUID_TRUSTED_UPDATE_FIRMWARE_NS_BL2U) \
+	X(BL2, "bl2", UUID_TRUSTED_BOOT_FIRMWARE_BL2) \
+	X(BL31, "bl31", UUID_EL3_RUNTIME_FIRMWARE_BL31) \
+	X(BL32, "bl32", UUID_SECURE_PAYLOAD_BL32) \
+	X(BL32_EXTRA1, "bl32-extra1", UUID_SECURE_PAYLOAD_BL32_EXTRA1) \
+	X(BL32_EXTRA2, "bl32-extra2", UUID_SECURE_PAYLOAD_BL32_EXTRA2) \
+	X(BL32_EXTRA3, "bl32-extra3", UUID_SECURE_PAYLOAD_BL32_EXTRA3) \
+	X(BL32_EXTRA4, "bl32-extra4", UUID_SECURE_PAYLOAD_BL32_EXTRA4) \
+	X(BL32_EXTRA5, "bl32-extra5", UUID_SECURE_PAYLOAD_BL32_EXTRA5) \
+	X(BL33, "bl33", UUID_NON_TRUSTED_FIRMWARE_BL33) \
+	X(BL33_EXTRA1, "bl33-extra1", UUID_NON_TRUSTED_FIRMWARE_BL33_EXTRA1) \
+	X(BL33_EXTRA2, "bl33-extra2", UUID_NON_TRUSTED_FIRMWARE_BL33_EXTRA2) \
+	X(BL33_EXTRA3, "bl33-extra3", UUID_NON_TRUSTED_FIRMWARE_BL33_EXTRA3) \
+	X(BL33_EXTRA4, "bl33-extra4", UUID_NON_TRUSTED_FIRMWARE_BL33_EXTRA4) \
+	X(BL33_EXTRA5, "bl33-extra5", UUID_NON_TRUSTED_FIRMWARE_BL33_EXTRA5) \
+	X(BL33_EXTRA6, "bl33-extra6", UUID_NON_TRUSTED_FIRMWARE_BL33_EXTRA6) \
+	X(BL33_EXTRA7, "bl33-extra7", UUID_NON_TRUSTED_FIRMWARE_BL33_EXTRA7) \
+	X(BL33_EXTRA8, "bl33-extra8", UUID_NON_TRUSTED_FIRMWARE_BL33_EXTRA8) \
+	X(TB_FW_CERT, "tb-fw-cert", UUID_TRUSTED_BOOT_FW_CERT) \
+	X(SOC_FW_CERT, "soc-fw-cert", UUID_SOC_FW_CONTENT_CERT) \
+	X(KEYRING, "keyring", UUID_TRUSTED_BOOT_KEYRING) \
+	X(SEC_MODULE, "sec-module", UUID_TRUSTED_BOOT_SEC_MODULE)
+
+#define FWU_COMPONENT_ENUM(id, name, uuid) FWU_COMP_##id,
+
+enum fwu_component_id {
+	FWU_COMP_UNKNOWN,
+	FWU_COMPONENTS(FWU_COMPONENT_ENUM)
+	FWU_COMP_MAX
+};
+
+struct fwu_component_slot {
+	uuid_t uuid;
+	uint32_t id;
+};
+
+/* Hash of the perfect hash table, the seed is chosen by the generator */
+static inline uint32_t fwu_component_hash(const uuid_t *uuid, uint32_t seed)
+{
+	const uint8_t *p = (const uint8_t *)uuid;
+	uint32_t h = seed ^ 2166136261U;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(uuid_t); i++)
+	{
+		h ^= p[i];
+		h *= 16777619U;
+	}
+
+	return h ^ (h >> 15);
+}
+
+struct fwu_component_stats;
+
+/* Component ID of a ToC entry UUID, FWU_COMP_UNKNOWN if it is not registered */
+uint32_t fwu_component_id(const uuid_t *uuid);
+
+/* Add the statistics of an updated FIP, time_ms is shared out by input size */
+void fwu_component_account(const struct fwu_component_stats *fip_stats, uint32_t time_ms);
+
+/* Copy the statistics (FWU_COMP_MAX entries) and optionally reset them */
+void fwu_component_get_stats(struct fwu_component_stats *stats, bool reset);
+
+#endif /* FWU_COMPONENT_H */
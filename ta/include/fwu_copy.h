@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef FWU_COPY_H
+#define FWU_COPY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Single pass copy of the FIP data with the CRC-32 (IEEE 802.3) of the
+ * copied bytes, so that the data of a plain FIP is only read once.
+ * Uses NEON loads and the CRC32 instructions of the Cortex-A53/A57 when
+ * the compiler targets them (__ARM_NEON, __ARM_FEATURE_CRC32), plain C
+ * otherwise. Does not depend on the TEE, the host tools build it as well.
+ */
+
+/*
+ * Copy size bytes from src to dst and return the CRC-32 of the data, crc is
+ * the CRC-32 of the previous data (0 for the first call). dst and src may
+ * overlap if dst is before src.
+ */
+uint32_t fwu_copy_crc32(void *dst, const void *src, size_t size, uint32_t crc);
+
+/* CRC-32 of size bytes at src, crc is the CRC-32 of the previous data */
+uint32_t fwu_crc32(const void *src, size_t size, uint32_t crc);
+
+#endif /* FWU_COPY_H */
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef FWU_DIGEST_H
+#define FWU_DIGEST_H
+
+#include <tee_internal_api.h>
+#include <stdint.h>
+
+/*
+ * Digests of the package directory.
+ *
+ * With a segmented directory (FIP_DIR_FLAGS_SEGMENT_MASK), the host can hash
+ * the segments of the FIPs on its own cores and pass the segment digests
+ * with the package. The TA hashes the digest list to check it against the
+ * directory, and re-hashes every segment against the list. With
+ * CFG_FWU_DIGEST_SPOT set, it only re-hashes that many segments picked at
+ * random in every FIP: a modified segment is then only found by chance.
+ * Without a list, the TA hashes all segments.
+ */
+
+/* Number of segments checked per FIP against the host digests, 0: all */
+#ifndef CFG_FWU_DIGEST_SPOT
+#define CFG_FWU_DIGEST_SPOT 0
+#endif
+
+/*
+ * Check the FIP against the directory digest. shift is the log2 segment
+ * size of the directory (0: SHA-256 of the FIP), list has the segment
+ * digests from the host or is NULL.
+ */
+TEE_Result fwu_digest_check(const void *fip, uint32_t size, const uint8_t *digest, uint32_t shift,
+							const uint8_t *list, uint32_t list_size);
+
+/* SHA-256 of size bytes at data, digest has FIP_DIR_DIGEST_SIZE bytes */
+TEE_Result fwu_digest_sha256(const void *data, uint32_t size, uint8_t *digest);
+
+#endif /* FWU_DIGEST_H */
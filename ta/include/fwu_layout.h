@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FWU_LAYOUT_H
+#define FWU_LAYOUT_H
+
+#include <stdint.h>
+
+#include "rzg_firmware_image_package.h"
+
+/*
+ * Sizes of the re-encrypted data, shared by the size calculation and the
+ * update of the FIPs.
+ */
+
+/* Keyring in the KEYRING FIP */
+#define INPUT_KEYRING_SIZE (0x2B0)
+#define OUTPUT_KEYRING_SIZE (0x510)
+
+/* Re-encrypted data of the BOOT_FW and NS_BL2U FIPs */
+#define REENC_SIZE_FIELD (8)     /* Re-encrypted size in front of the data */
+#define REENC_MAC_SIZE (16)
+#define REENC_BOOT_HEADER (48)   /* Only in front of the first data */
+
+/* Size added by TSIP to the first and to the other data */
+#define REENC_TSIP_FIRST (REENC_MAC_SIZE + REENC_BOOT_HEADER)
+#define REENC_TSIP_NEXT (REENC_MAC_SIZE)
+
+/* Size added to the output FIP, including the size field */
+#define REENC_OUT_FIRST (REENC_SIZE_FIELD + REENC_TSIP_FIRST)
+#define REENC_OUT_NEXT (REENC_SIZE_FIELD + REENC_TSIP_NEXT)
+
+/* Padding of the data in an updated FIP, align is a power of 2 */
+#define FIP_OUT_PAD_BYTE (0xFF)
+#define FIP_OUT_ALIGN_UP(pos, align) (((pos) + ((align) - 1)) & ~((align) - 1))
+
+/*
+ * Size of an A/B staging slot (fwu_slot.h) in the SPI window from spi_offset
+ * to spi_end, which holds two slots and two metadata erase sectors
+ */
+#define FWU_SLOT_SIZE_OF(spi_offset, spi_end, erase_size) \
+	(((((spi_end) - (spi_offset)) - (2 * (erase_size))) / 2) & ~(uint32_t)((erase_size) - 1))
+
+/* Alignment of the headroom in front of the input of the in-place update */
+#define INPLACE_ALIGN (8)
+
+/*
+ * Output size of the data of a ToC entry without the alignment padding,
+ * first is set for the first ToC entry of the FIP. Shared by the TA and the
+ * host tools, so that the offline plan matches FWU_CMD_CALC_WORK_SIZE.
+ */
+static inline uint32_t fwu_layout_entry_size(uint32_t fip_name, uint64_t size, int first)
+{
+	if (TOC_HEADER_NAME_PLAIN == fip_name)
+		return (uint32_t)size;
+
+	if (TOC_HEADER_NAME_KEYRING == fip_name)
+		return (INPUT_KEYRING_SIZE <= size) ? OUTPUT_KEYRING_SIZE : 0;
+
+	if (0 == size)
+		return 0;
+
+	if (first)
+		/*output_size = 8(Re-encrypted size) + input_size + 16(MAC size) + 48(boot header) */
+		return (uint32_t)size + REENC_OUT_FIRST;
+
+	/*output_size = 8(Re-encrypted size) + input_size + 16(MAC size) */
+	return (uint32_t)size + REENC_OUT_NEXT;
+}
+
+/* Log2 of the digest segment size of a package directory, 0 if not segmented */
+static inline uint32_t fwu_layout_segment_shift(const fip_dir_header_t *dir)
+{
+	return (uint32_t)((dir->toc.flags >> 32) & FIP_DIR_FLAGS_SEGMENT_MASK) >> FIP_DIR_FLAGS_SEGMENT_SHIFT;
+}
+
+/*
+ * Log2 of the alignment of the updated FIP data of a package directory. The
+ * alignment applies to the offset in the staging area, the TA only accepts
+ * one that divides the offset of the staging area (and of the slots).
+ */
+static inline uint32_t fwu_layout_align_shift(const fip_dir_header_t *dir)
+{
+	return (uint32_t)(dir->toc.flags >> 32) & FIP_DIR_FLAGS_ALIGN_MASK;
+}
+
+/* Number of digest segments of a FIP of size bytes */
+static inline uint32_t fwu_layout_segments(uint32_t size, uint32_t shift)
+{
+	return (uint32_t)(((uint64_t)size + ((1ULL << shift) - 1)) >> shift);
+}
+
+#if (OUTPUT_KEYRING_SIZE < INPUT_KEYRING_SIZE)
+#error "The output keyring must not be smaller than the input keyring"
+#endif
+
+#endif /* FWU_LAYOUT_H */
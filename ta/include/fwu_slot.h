@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FWU_SLOT_H
+#define FWU_SLOT_H
+
+#include <tee_internal_api.h>
+#include <stdint.h>
+
+#include "fwu_board.h"
+#include "fwu_layout.h"
+#include "fwu_storage.h"
+
+/*
+ * A/B staging slots (FWU_AB=y in ta/Makefile).
+ *
+ * The SPI window of the board profile is split into two slots and two
+ * metadata sectors at its end:
+ *
+ *   FWU_BOARD_SPI_PACKAGE_OFFSET  slot 0
+ *                   + SLOT_SIZE   slot 1
+ *               + 2 * SLOT_SIZE   metadata sector 0, record in its first page
+ *   + 2 * SLOT_SIZE + ERASE_SIZE  metadata sector 1, record in its first page
+ *
+ * The update is written to the slot that is not active (slot 1 if there is
+ * no valid record, slot 0 then holds the image in place), read back and
+ * compared, then a record with the next sequence number is written to the
+ * metadata sector that does not hold the current record. The valid record
+ * with the highest sequence number selects the active slot, so a torn
+ * record write leaves the previous slot active. The boot loader selects the
+ * slot with the same rule.
+ */
+
+#ifndef CFG_FWU_AB
+#define CFG_FWU_AB 0
+#endif
+
+#define FWU_SLOT_META_SIZE (2 * FWU_BOARD_SPI_ERASE_SIZE)
+#define FWU_SLOT_SIZE \
+	FWU_SLOT_SIZE_OF(FWU_BOARD_SPI_PACKAGE_OFFSET, FWU_BOARD_SPI_END_OFFSET, FWU_BOARD_SPI_ERASE_SIZE)
+#define FWU_SLOT_META_OFFSET (2 * FWU_SLOT_SIZE)
+
+#define FWU_SLOT_MAGIC 0x544f4c53 /* "SLOT" */
+
+struct fwu_slot_record {
+	uint32_t magic;         /* FWU_SLOT_MAGIC */
+	uint32_t sequence;      /* Incremented by each update */
+	uint32_t slot;          /* Active slot, 0 or 1 */
+	uint32_t length;        /* Size of the package in the slot */
+	uint8_t digest[32];     /* SHA-256 of the package in the slot */
+	uint32_t reserved[3];
+	uint32_t check;         /* ~(sum of the other 32-bit words) */
+};
+
+#if CFG_FWU_AB
+
+#if (CFG_FWU_STORAGE != FWU_STORAGE_SPI)
+#error "The A/B slots need the SPI flash storage"
+#endif
+
+#if (FWU_BOARD_SPI_PAGE_SIZE < 64)
+#error "The slot record must fit in a SPI flash page"
+#endif
+
+/* Offset of the slot the next update is written to */
+TEE_Result fwu_slot_target(uint32_t *offset);
+
+/* Verify the package written to the target slot and make it the active slot */
+TEE_Result fwu_slot_activate(const void *buf, uint32_t size);
+
+/* Get the active slot (FWU_SLOT_NONE if none), its sequence number and length */
+TEE_Result fwu_slot_info(uint32_t *slot, uint32_t *sequence, uint32_t *length);
+
+#else
+
+static inline TEE_Result fwu_slot_activate(const void *buf __unused, uint32_t size __unused)
+{
+	return TEE_SUCCESS;
+}
+
+static inline TEE_Result fwu_slot_info(uint32_t *slot __unused, uint32_t *sequence __unused,
+									   uint32_t *length __unused)
+{
+	return TEE_ERROR_NOT_SUPPORTED;
+}
+
+#endif /* CFG_FWU_AB */
+
+#endif /* FWU_SLOT_H */
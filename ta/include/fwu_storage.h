@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FWU_STORAGE_H
+#define FWU_STORAGE_H
+
+#include <tee_internal_api.h>
+#include <stdint.h>
+
+#include "fwu_ta.h"
+
+/* Backend selected at build time (FWU_STORAGE in ta/Makefile) */
+#ifndef CFG_FWU_STORAGE
+#define CFG_FWU_STORAGE FWU_STORAGE_SPI
+#endif
+
+#if (CFG_FWU_STORAGE != FWU_STORAGE_SPI) && (CFG_FWU_STORAGE != FWU_STORAGE_FILE)
+#error "Unknown FWU_STORAGE backend"
+#endif
+
+struct fwu_storage_geometry {
+	uint32_t capacity;     /* size of the staging area in bytes */
+	uint32_t block_size;   /* smallest unit of a write */
+	uint32_t erase_size;   /* erase granularity */
+	uint32_t max_transfer; /* largest write passed to the backend at once */
+};
+
+/* Maximum number of segments passed to the backend at once */
+#define FWU_STORAGE_VEC_MAX 16
+
+/* Segment of a vectored write, the data is at buf_offset of the buffer buf */
+struct fwu_storage_seg {
+	uint32_t offset;       /* offset in the staging area */
+	uint32_t buf;          /* index of the buffer, 0 or 1 */
+	uint32_t buf_offset;
+	uint32_t size;
+};
+
+struct fwu_storage_ops {
+	uint32_t type;
+	const char *name;
+	/* Open the backend and get its geometry */
+	TEE_Result (*open)(struct fwu_storage_geometry *geo);
+	/* Write size bytes at offset of the staging area, size <= max_transfer */
+	TEE_Result (*write)(uint32_t offset, const void *buf, uint32_t size);
+	/* Erase [offset, offset + size), aligned to erase_size (NULL: not needed) */
+	TEE_Result (*erase)(uint32_t offset, uint32_t size);
+	/* Write to an erased area without erasing it (NULL: use write) */
+	TEE_Result (*program)(uint32_t offset, const void *buf, uint32_t size);
+	/* Read size bytes at offset, size <= max_transfer (NULL: not supported) */
+	TEE_Result (*read)(uint32_t offset, void *buf, uint32_t size);
+	/*
+	 * Write count <= FWU_STORAGE_VEC_MAX sorted segments of at most
+	 * max_transfer bytes in total, program: the area is erased already
+	 * (NULL: not supported)
+	 */
+	TEE_Result (*write_vec)(const struct fwu_storage_seg *seg, uint32_t count,
+							void *const buf[2], const uint32_t buf_size[2], bool program);
+	void (*close)(void);
+};
+
+/* The backend the update package is written to */
+const struct fwu_storage_ops *fwu_storage_get(void);
+
+/* Get the geometry of the backend, the capacity is the size of a slot with FWU_AB */
+TEE_Result fwu_storage_info(struct fwu_storage_geometry *geo);
+
+/*
+ * Write to the staging area in transfers of the backend geometry. With
+ * FWU_AB, the offsets of fwu_storage_write(), _erase() and _program() are
+ * in the slot that is not active.
+ */
+TEE_Result fwu_storage_write(uint32_t offset, const void *buf, uint32_t size);
+
+/*
+ * Erase the staging area ahead of the write, returns TEE_ERROR_NOT_SUPPORTED
+ * if the backend can not erase separately
+ */
+TEE_Result fwu_storage_erase(uint32_t offset, uint32_t size);
+
+/* Write to the staging area erased by fwu_storage_erase() */
+TEE_Result fwu_storage_program(uint32_t offset, const void *buf, uint32_t size);
+
+/*
+ * Write the segments, sorted by offset without overlap, from the two
+ * buffers with as few backend calls as possible. program is set if the
+ * area has been erased by fwu_storage_erase(). Returns
+ * TEE_ERROR_NOT_SUPPORTED before writing anything if the backend can not
+ * write segments, the caller then writes a contiguous buffer.
+ */
+TEE_Result fwu_storage_write_vec(const struct fwu_storage_seg *seg, uint32_t count,
+								 void *const buf[2], const uint32_t buf_size[2], bool program);
+
+/*
+ * Read and write the whole staging area, without the offset of the A/B slot
+ * (fwu_slot.c)
+ */
+TEE_Result fwu_storage_area_read(uint32_t offset, void *buf, uint32_t size);
+TEE_Result fwu_storage_area_write(uint32_t offset, const void *buf, uint32_t size);
+
+/*
+ * Compare the staging area at offset with buf, read back in one backend
+ * session through tmp, in transfers of at most tmp_size bytes
+ */
+TEE_Result fwu_storage_area_compare(uint32_t offset, const void *buf, uint32_t size, void *tmp, uint32_t tmp_size);
+
+/*
+ * Add the size of each transfer written to the staging area to *written,
+ * NULL stops counting
+ */
+void fwu_storage_set_progress(uint32_t *written);
+
+/* Round a chunk size down to the erase granularity of the backend */
+uint32_t fwu_storage_chunk_size(const struct fwu_storage_geometry *geo, uint32_t size);
+
+#endif /* FWU_STORAGE_H */
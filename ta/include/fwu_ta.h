@@ -27,6 +27,8 @@
 #ifndef FWU_TA_H
 #define FWU_TA_H
 
+#include <stdint.h>
+
 /* This UUID is generated with uuidgen
    the ITU-T UUID generator at http://www.itu.int/ITU-T/asn1/uuid.html */
 
@@ -43,7 +45,8 @@
 /*
  * FWU_CMD_CALC_WORK_SIZE - calculate work ram size
  * param[0] (memref) Input data 
- * param[1] (value) work size
+ * param[1] (value) a: work size
+ *                  b: single buffer size for the in-place update
  * param[2] unused
  * param[3] unused
  */
@@ -55,8 +58,246 @@
  * param[1] (memref) work buffer
  * param[2] unused
  * param[3] unused
+ *
+ * In-place mode (input loaded at the tail of the work buffer)
+ * param[0] (value) a: offset of the input data in the work buffer
+ *                  b: input data size
+ * param[1] (memref) work buffer (single buffer size from FWU_CMD_CALC_WORK_SIZE)
+ * param[2] unused
+ * param[3] unused
+ *
+ * param[2] may be a (memref) struct fwu_progress in registered shared memory,
+ * which the TA keeps up to date while the command runs.
+ * param[3] may be a (memref) input with the segment digests of all FIPs of a
+ * package with a segmented directory (FIP_DIR_FLAGS_SEGMENT_MASK), in the
+ * order of the directory. The TA checks them against the directory before
+ * the update starts.
+ * The command can be cancelled between FIPs, until the flash write starts.
+ *
+ * Once the FIP headers and sizes of the whole package are validated, the
+ * staging area is erased ahead of the write while the FIPs are updated. A
+ * later failure (e.g. of the TSIP) or a cancellation leaves the erased part
+ * of the staging area erased, the package staged before is lost. With
+ * FWU_AB, only the slot that is not active is erased.
  */
 #define FWU_CMD_FIRMWARE_UPDATE 2
 
+/* Stages of FWU_CMD_FIRMWARE_UPDATE */
+#define FWU_STAGE_IDLE 0
+#define FWU_STAGE_UPDATE 1
+#define FWU_STAGE_WRITE 2
+#define FWU_STAGE_DONE 3
+
+/* Progress of FWU_CMD_FIRMWARE_UPDATE */
+struct fwu_progress {
+	uint32_t stage;         /* FWU_STAGE_xxx */
+	uint32_t fip_count;     /* Number of processed FIPs */
+	uint32_t input_size;    /* Input data size */
+	uint32_t input_done;    /* Processed input data size */
+	uint32_t output_done;   /* Re-encrypted output data size */
+	uint32_t written;       /* Data size written to SPI flash */
+};
+
+
+/*
+ * FWU_CMD_GET_SECTIONS - Get the FIP sections of the package and start
+ *                        a section update owned by this session
+ * param[0] (memref) Input data
+ * param[1] (memref) struct fwu_section array (FWU_SECTION_MAX entries)
+ * param[2] (value) a: number of sections
+ *                  b: work size
+ * param[3] unused
+ */
+#define FWU_CMD_GET_SECTIONS 3
+
+/*
+ * FWU_CMD_UPDATE_SECTION - Update one FIP section, may be called from any session
+ * param[0] (memref) Input data of the section (in_size)
+ * param[1] (memref) Work buffer of the section (out_size)
+ * param[2] (value) a: section index
+ * param[3] unused, or (memref) input with the segment digests of the section
+ *          if the directory is segmented
+ */
+#define FWU_CMD_UPDATE_SECTION 4
+
+/*
+ * FWU_CMD_COMMIT - Save the updated sections to SPI flash
+ * param[0] (memref) Work buffer (work size)
+ * param[1] unused
+ * param[2] unused
+ * param[3] unused
+ *
+ * Fails with TEE_ERROR_SECURITY, without writing, if a section of the work
+ * buffer differs from the output of its FWU_CMD_UPDATE_SECTION.
+ */
+#define FWU_CMD_COMMIT 5
+
+/*
+ * FWU_CMD_UPDATE_STEP - Update Firmware data and save to SPI flash within
+ *                       a time budget per call, repeat until FWU_STEP_DONE
+ * param[0] (memref) Input data (same buffer for all calls)
+ * param[1] (memref) work buffer (same buffer for all calls)
+ * param[2] (value) a: [in] time budget in ms (0: default)
+ *                     [out] FWU_STEP_CONTINUE or FWU_STEP_DONE
+ *                  b: [out] processed input size while updating,
+ *                           written size while writing to SPI flash
+ * param[3] unused
+ *
+ * The staging area is erased ahead of the write as with FWU_CMD_FIRMWARE_UPDATE.
+ * The output is hashed at the end of the update, each chunk is checked
+ * against it before it is written (TEE_ERROR_SECURITY if the work buffer
+ * has changed). A package without output is rejected (TEE_ERROR_BAD_FORMAT).
+ */
+#define FWU_CMD_UPDATE_STEP 6
+
+#define FWU_STEP_DONE 0
+#define FWU_STEP_CONTINUE 1
+
+/*
+ * FWU_CMD_GET_MEM_STATS - Get the memory usage of the TA
+ * param[0] (value) a: arena high-water mark, b: arena size
+ * param[1] (value) a: stack usage (upper bound from -fstack-usage), b: stack size
+ * param[2] unused
+ * param[3] unused
+ */
+#define FWU_CMD_GET_MEM_STATS 7
+
+/*
+ * FWU_CMD_GET_STORAGE_INFO - Get the storage backend of the update package
+ * param[0] (value) a: backend (FWU_STORAGE_xxx), b: capacity of the staging area
+ * param[1] (value) a: block size, b: erase size
+ * param[2] (value) a: maximum transfer size
+ * param[3] unused
+ */
+#define FWU_CMD_GET_STORAGE_INFO 8
+
+/*
+ * FWU_CMD_BATCH_ADD - Update a package and append it to the batch output
+ * param[0] (memref) Input package
+ * param[1] (memref) Batch output buffer, the same for all packages
+ * param[2] (value) a: index of the package in the batch (0 starts a new
+ *                     batch), out: number of queued packages
+ *                  b: out: combined output size
+ * param[3] unused
+ *
+ * The END_OF_FILE flag of the previous package is cleared so that the
+ * packages form a single chain of FIPs. A failure aborts the batch.
+ */
+#define FWU_CMD_BATCH_ADD 9
+
+/*
+ * FWU_CMD_BATCH_COMMIT - Save the batch output to the storage at once
+ * param[0] (memref) Batch output buffer
+ * param[1] (value) a: number of packages, b: written size
+ * param[2] unused
+ * param[3] unused
+ *
+ * Fails with TEE_ERROR_SECURITY, without writing, if the buffer differs
+ * from the output of FWU_CMD_BATCH_ADD. The batch is aborted.
+ */
+#define FWU_CMD_BATCH_COMMIT 10
+
+/*
+ * FWU_CMD_LIST_COMPONENTS - Get the components of the ToC entries of a
+ *                           package, without updating it
+ * param[0] (memref) Input data
+ * param[1] (memref) struct fwu_component_stats array, indexed by the
+ *                   component ID of fwu_component.h (FWU_COMP_MAX entries),
+ *                   time_ms is 0
+ * param[2] (value) a: number of FIPs
+ *                  b: number of components (FWU_COMP_MAX)
+ * param[3] unused
+ *
+ * Unknown UUIDs are counted as FWU_COMP_UNKNOWN. With
+ * CFG_FWU_STRICT_COMPONENTS, they are rejected in the FIPs other than the
+ * plain FIPs, as the update does.
+ */
+#define FWU_CMD_LIST_COMPONENTS 11
+
+/*
+ * FWU_CMD_GET_COMPONENT_STATS - Get the update statistics per component
+ * param[0] (memref) struct fwu_component_stats array (FWU_COMP_MAX entries)
+ * param[1] (value) a: [in] 1: reset the statistics after reading
+ *                     [out] number of components (FWU_COMP_MAX)
+ * param[2] unused
+ * param[3] unused
+ */
+#define FWU_CMD_GET_COMPONENT_STATS 12
+
+/*
+ * FWU_CMD_RING_SUBMIT - Execute the ready descriptors of a command ring
+ * param[0] (memref) Ring: struct fwu_ring_header, struct fwu_ring_desc
+ *                   array and the data of the memref parameters
+ * param[1] (value) a: number of executed descriptors
+ * param[2] unused
+ * param[3] unused
+ *
+ * The descriptors from head to tail are executed in order, as if each of
+ * them was invoked on this session, and head is advanced. The execution
+ * stops after a descriptor that fails. The memref parameters of a
+ * descriptor are offsets into the ring after the descriptor array.
+ */
+#define FWU_CMD_RING_SUBMIT 13
+
+/*
+ * FWU_CMD_GET_SLOT_INFO - Get the active A/B staging slot (TA built with FWU_AB=y)
+ * param[0] (value) a: active slot (0, 1 or FWU_SLOT_NONE), b: sequence number
+ * param[1] (value) a: package size in the active slot, b: slot size
+ * param[2] unused
+ * param[3] unused
+ *
+ * Returns TEE_ERROR_NOT_SUPPORTED without the A/B slots.
+ */
+#define FWU_CMD_GET_SLOT_INFO 14
+
+/* No slot is active yet */
+#define FWU_SLOT_NONE 0xFFFFFFFF
+
+/* Storage backends of the update package */
+#define FWU_STORAGE_SPI 0  /* SPI flash through the flash PTA */
+#define FWU_STORAGE_FILE 2 /* REE file system through tee-supplicant (for tests) */
+
+/* Maximum number of FIPs in a package for the section update */
+#define FWU_SECTION_MAX 16
+
+/* FIP section of FWU_CMD_GET_SECTIONS */
+struct fwu_section {
+	uint32_t name;          /* TOC_HEADER_NAME_xxx */
+	uint32_t in_offset;     /* Offset in the input data */
+	uint32_t in_size;
+	uint32_t out_offset;    /* Offset in the work buffer */
+	uint32_t out_size;
+};
+
+/* Statistics of a component of FWU_CMD_LIST_COMPONENTS and FWU_CMD_GET_COMPONENT_STATS */
+struct fwu_component_stats {
+	uint32_t count;         /* Number of ToC entries */
+	uint32_t time_ms;       /* Update time, the time of a FIP is shared out by input size */
+	uint64_t in_bytes;      /* Size in the package */
+	uint64_t out_bytes;     /* Size after the update, without the alignment padding */
+};
+
+#define FWU_RING_MAGIC 0x52555746 /* "FWUR" */
+#define FWU_RING_ENTRY_MAX 256
+
+struct fwu_ring_header {
+	uint32_t magic;         /* FWU_RING_MAGIC */
+	uint32_t entries;       /* Number of descriptors after the header */
+	uint32_t head;          /* Next descriptor to execute, advanced by the TA */
+	uint32_t tail;          /* Next free descriptor, advanced by the CA */
+};
+
+struct fwu_ring_param {
+	uint32_t a;             /* value.a, or offset of a memref in the ring */
+	uint32_t b;             /* value.b, or size of a memref */
+};
+
+struct fwu_ring_desc {
+	uint32_t cmd;           /* FWU_CMD_xxx */
+	uint32_t param_types;   /* TEE_PARAM_TYPES(), temporary memrefs only */
+	uint32_t result;        /* TEE_Result of the command, written by the TA */
+	uint32_t reserved;
+	struct fwu_ring_param param[4];
+};
 
 #endif /* FWU_TA_H */
@@ -29,6 +29,7 @@ typedef struct uuid uuid_t;
 #define TOC_HEADER_NAME_KEYRING     (0xAA640002)
 #define TOC_HEADER_NAME_BOOT_FW     (0xAA640003)
 #define TOC_HEADER_NAME_NS_BL2U     (0xAA640004)
+#define TOC_HEADER_NAME_DIRECTORY   (0xAA640005)
 
 /* ToC Entry UUIDs */
 #define UUID_TRUSTED_UPDATE_FIRMWARE_NS_BL2U \
@@ -79,6 +80,20 @@ typedef struct uuid uuid_t;
 #define UUID_TRUSTED_BOOT_SEC_MODULE \
 	{{0x86, 0x7e, 0xcf, 0xd1}, {0xd8, 0x26}, {0x42, 0x93}, 0xb2, 0xe3, {0x9a, 0x1a, 0x5a, 0x77, 0x4c, 0x11} }
 
+/*
+ * Platform flags (bits 63:32 of fip_toc_header_t.flags)
+ * [15]  : END_OF_FILE, the last FIP of the package
+ */
+#define FIP_FLAGS_END_OF_FILE		(0x8000)
+
+/*
+ * ToC entry flags of a plain FIP in a package with FIP_DIR_FLAGS_CRC
+ * [32]   : CRC_VALID, the TA checks the data of the entry against the CRC
+ * [31:0] : CRC-32 (IEEE 802.3) of the data of the entry
+ */
+#define TOC_ENTRY_FLAGS_CRC_VALID	(1ULL << 32)
+#define TOC_ENTRY_FLAGS_CRC_MASK	(0xFFFFFFFFULL)
+
 typedef struct fip_toc_header {
 	uint32_t	name;
 	uint32_t	serial_number;
@@ -93,5 +108,48 @@ typedef struct fip_toc_entry {
 	uint64_t	nvm_offset;
 } fip_toc_entry_t;
 
+/*
+ * Package directory: an optional first FIP that lists the other FIPs of the
+ * package. It is followed by "count" fip_dir_entry_t and is not written to
+ * flash.
+ */
+#define FIP_DIR_ENTRY_MAX	64
+#define FIP_DIR_DIGEST_SIZE	32	/* SHA-256 */
+
+/*
+ * Directory flags (bits 63:32 of fip_dir_header_t.toc.flags)
+ * [12:8] : log2 of the digest segment size (0: the digest is the SHA-256 of
+ *          the FIP). Otherwise the digest is the SHA-256 of the SHA-256
+ *          digests of the segments of the FIP, the last segment may be
+ *          shorter.
+ * [5]    : CRC, the ToC entry flags of the plain FIPs hold the CRC-32 of
+ *          their data (TOC_ENTRY_FLAGS_CRC_*). Otherwise the TA ignores
+ *          these flags.
+ * [4:0]  : log2 of the alignment of the data of the updated keyring and
+ *          re-encrypted FIPs in the staging area (0: packed). The data and
+ *          the end of these FIPs are padded with 0xFF.
+ */
+#define FIP_DIR_FLAGS_SEGMENT_MASK	(0x1F00)
+#define FIP_DIR_FLAGS_SEGMENT_SHIFT	(8)
+#define FIP_DIR_FLAGS_CRC		(0x0020)
+#define FIP_DIR_FLAGS_ALIGN_MASK	(0x001F)
+#define FIP_DIR_ALIGN_SHIFT_MAX		(18)
+#define FIP_DIR_SEGMENT_SHIFT_MIN	(12)
+#define FIP_DIR_SEGMENT_SHIFT_MAX	(24)
+
+typedef struct fip_dir_header {
+	fip_toc_header_t	toc;	/* name is TOC_HEADER_NAME_DIRECTORY */
+	uint32_t	count;
+	uint32_t	size;		/* Size of the directory FIP */
+} fip_dir_header_t;
+
+typedef struct fip_dir_entry {
+	uint32_t	name;		/* TOC_HEADER_NAME_xxx of the FIP */
+	uint32_t	offset;		/* Offset of the FIP in the package */
+	uint32_t	size;		/* Size of the FIP in the package */
+	uint32_t	out_size;	/* Size of the updated FIP */
+	uint8_t		digest[FIP_DIR_DIGEST_SIZE];	/* Digest of the FIP in the package */
+} fip_dir_entry_t;
+
 #endif /* RZG_FIRMWARE_IMAGE_PACKAGE_H */
 
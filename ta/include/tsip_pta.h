@@ -33,6 +33,40 @@
  */
 #define TSIP_CMD_UPDATE_FIRMWARE 2
 
+/*
+ * Chunked re-encryption of one firmware data, the output is the same as the
+ * one of TSIP_CMD_UPDATE_FIRMWARE for this data. INIT starts the data, UPDATE
+ * is called with its consecutive pieces and FINAL appends the MAC. One data
+ * at a time per session, closing the session discards an unfinished one.
+ * The PTA sets the size of the output memref to the number of bytes written,
+ * the caller appends them to the output data.
+ *
+ * TSIP_CMD_UPDATE_FIRMWARE_INIT - Start the re-encryption of a data
+ * param[0] (value) a: Firmware data index number (0: first data), b: Input data size
+ * param[1] unused
+ * param[2] (memref) Output boot header (48 bytes for the first data, none for the others)
+ * param[3] unused
+ */
+#define TSIP_CMD_UPDATE_FIRMWARE_INIT 3
+
+/*
+ * TSIP_CMD_UPDATE_FIRMWARE_UPDATE - Re-encrypt a piece of the data
+ * param[0] unused
+ * param[1] (memref) Input Temp-Encrypt piece, a multiple of 16 bytes but the last one
+ * param[2] (memref) Output Re-Encrypt piece
+ * param[3] unused
+ */
+#define TSIP_CMD_UPDATE_FIRMWARE_UPDATE 4
+
+/*
+ * TSIP_CMD_UPDATE_FIRMWARE_FINAL - Finish the re-encryption of the data
+ * param[0] unused
+ * param[1] unused
+ * param[2] (memref) Output MAC (16 bytes)
+ * param[3] unused
+ */
+#define TSIP_CMD_UPDATE_FIRMWARE_FINAL 5
+
 /*
  * Input/Output structure for TSIP_CMD_UPDATE_FIRMWARE
  * [Input]
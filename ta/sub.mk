@@ -1,2 +1,9 @@
 global-incdirs-y += include
 srcs-y += fwu_ta.c
+srcs-y += fwu_arena.c
+srcs-y += fwu_storage.c
+srcs-y += fwu_component.c
+srcs-y += fwu_digest.c
+srcs-y += fwu_copy.c
+srcs-y += fwu_stack.c
+srcs-$(FWU_AB) += fwu_slot.c
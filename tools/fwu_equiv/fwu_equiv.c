@@ -0,0 +1,420 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * fwu_equiv - run FWU_CMD_CALC_WORK_SIZE and FWU_CMD_FIRMWARE_UPDATE of the
+ * TA sources on the host against the PTA stand-ins
+ *
+ * fwu_equiv [-s] [-r REPEAT] [-t MAX_TRANSFER] [-n FEATURE]... [-o IMAGE]
+ *           [-l LOG] [-v]... PACKAGE
+ *
+ * The package is updated like the fwu command does it: in-place when the
+ * TA reports a single buffer size, with separate input and work buffers
+ * otherwise or with -s. The update is run REPEAT times, each in a child
+ * process that starts from the TA state after FWU_CMD_CALC_WORK_SIZE and
+ * from an erased storage, and the time is the fastest run. The result is
+ * printed on one line:
+ *
+ *   res=0x00000000 input=... work=... inplace=... mode=inplace time_us=...
+ *   arena=... heap=... calls=... written=... erased=... overwritten=...
+ *   image=SHA-256
+ *
+ * arena is the arena high-water mark from FWU_CMD_GET_MEM_STATS (0 if the
+ * TA has no such command), heap the TEE_Malloc() high-water mark, image the
+ * digest of the storage after the update. -o saves the storage image and -l
+ * the log of the storage accesses of the first run.
+ */
+
+#include <err.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <fwu_ta.h>
+#include <sha256.h>
+
+#include "fwu_equiv.h"
+
+#ifndef CFG_FWU_STORAGE
+#define CFG_FWU_STORAGE 0
+#endif
+
+/* The SPI backend sees the whole flash, the others the staging object. */
+#if (0 == CFG_FWU_STORAGE)
+#define EQUIV_STORAGE_SIZE (pta_stub_geometry.spi_end)
+#else
+#define EQUIV_STORAGE_SIZE (pta_stub_geometry.spi_end - pta_stub_geometry.spi_offset)
+#endif
+
+/* Content of the work buffer before each run */
+#define EQUIV_WORK_FILL (0x5A)
+
+struct equiv_plan
+{
+	uint32_t res;
+	uint32_t work_size;
+	uint32_t inplace_size;
+	int inplace;
+};
+
+/* Result of a run, sent by the child process */
+struct equiv_run
+{
+	uint32_t res;
+	uint64_t time_us;
+	uint32_t arena;
+	size_t heap;
+	uint32_t calls;
+	uint64_t written;
+	uint64_t erased;
+	uint64_t overwritten;
+	uint8_t image[SHA256_DIGEST_SIZE];
+};
+
+static void usage(void)
+{
+	(void)fprintf(stderr, "usage: fwu_equiv [-s] [-r REPEAT] [-t MAX_TRANSFER] [-n FEATURE]... [-o IMAGE] [-l LOG] [-v]... PACKAGE\n");
+	(void)fprintf(stderr, "       FEATURE: info, erase-range, program, read, vec or chunked\n");
+	exit(2);
+}
+
+static uint8_t *read_package(const char *path, uint32_t *size)
+{
+	FILE *fp;
+	uint8_t *buf;
+	long len;
+
+	fp = fopen(path, "rb");
+	if (NULL == fp)
+		err(2, "%s", path);
+
+	if ((0 != fseek(fp, 0, SEEK_END)) || (0 > (len = ftell(fp))) || (0 != fseek(fp, 0, SEEK_SET)))
+		err(2, "%s", path);
+
+	if ((0 == len) || (UINT32_MAX < (unsigned long)len))
+		errx(2, "%s: bad package size", path);
+
+	buf = malloc((size_t)len);
+	if (NULL == buf)
+		err(2, "malloc");
+
+	if (1 != fread(buf, (size_t)len, 1, fp))
+		err(2, "%s", path);
+
+	(void)fclose(fp);
+	*size = (uint32_t)len;
+
+	return buf;
+}
+
+static uint64_t now_us(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((uint64_t)ts.tv_sec * 1000000) + ((uint64_t)ts.tv_nsec / 1000);
+}
+
+static void calc_work_size(void *sess, uint8_t *pkg, uint32_t size, struct equiv_plan *plan)
+{
+	TEE_Param params[TEE_NUM_PARAMS];
+	uint32_t type = TEE_PARAM_TYPES(TEE_PARAM_TYPE_MEMREF_INPUT, TEE_PARAM_TYPE_VALUE_OUTPUT,
+									TEE_PARAM_TYPE_NONE, TEE_PARAM_TYPE_NONE);
+
+	(void)memset(params, 0, sizeof(params));
+	params[0].memref.buffer = pkg;
+	params[0].memref.size = size;
+
+	plan->res = TA_InvokeCommandEntryPoint(sess, FWU_CMD_CALC_WORK_SIZE, type, params);
+	plan->work_size = params[1].value.a;
+	plan->inplace_size = params[1].value.b;
+	if ((TEE_SUCCESS == plan->res) && (0 == plan->work_size))
+		plan->res = TEE_ERROR_BAD_FORMAT;
+}
+
+static uint32_t arena_peak(void *sess)
+{
+#ifdef FWU_CMD_GET_MEM_STATS
+	TEE_Param params[TEE_NUM_PARAMS];
+	uint32_t type = TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_OUTPUT, TEE_PARAM_TYPE_VALUE_OUTPUT,
+									TEE_PARAM_TYPE_NONE, TEE_PARAM_TYPE_NONE);
+
+	(void)memset(params, 0, sizeof(params));
+	if (TEE_SUCCESS == TA_InvokeCommandEntryPoint(sess, FWU_CMD_GET_MEM_STATS, type, params))
+		return params[0].value.a;
+#else
+	(void)sess;
+#endif
+
+	return 0;
+}
+
+/* One FWU_CMD_FIRMWARE_UPDATE on an erased storage, like fwu_client_update() */
+static void firmware_update(void *sess, const uint8_t *pkg, uint32_t size, const struct equiv_plan *plan,
+							struct equiv_run *run)
+{
+	TEE_Param params[TEE_NUM_PARAMS];
+	uint8_t *input = NULL;
+	uint8_t *work;
+	uint32_t work_size;
+	uint32_t type;
+	uint64_t start;
+
+	work_size = plan->inplace ? plan->inplace_size : plan->work_size;
+	work = malloc(work_size);
+	if (NULL == work)
+		err(2, "malloc");
+	(void)memset(work, EQUIV_WORK_FILL, work_size);
+
+	(void)memset(params, 0, sizeof(params));
+	if (plan->inplace)
+	{
+		(void)memcpy(work + (work_size - size), pkg, size);
+		type = TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT, TEE_PARAM_TYPE_MEMREF_INOUT,
+							   TEE_PARAM_TYPE_NONE, TEE_PARAM_TYPE_NONE);
+		params[0].value.a = work_size - size;
+		params[0].value.b = size;
+	}
+	else
+	{
+		input = malloc(size);
+		if (NULL == input)
+			err(2, "malloc");
+		(void)memcpy(input, pkg, size);
+		type = TEE_PARAM_TYPES(TEE_PARAM_TYPE_MEMREF_INPUT, TEE_PARAM_TYPE_MEMREF_INOUT,
+							   TEE_PARAM_TYPE_NONE, TEE_PARAM_TYPE_NONE);
+		params[0].memref.buffer = input;
+		params[0].memref.size = size;
+	}
+	params[1].memref.buffer = work;
+	params[1].memref.size = work_size;
+
+	/* Also copies the shared storage pages of the child before the timing */
+	fwu_equiv_storage_reset();
+	tee_stub_reset();
+
+	start = now_us();
+	run->res = TA_InvokeCommandEntryPoint(sess, FWU_CMD_FIRMWARE_UPDATE, type, params);
+	run->time_us = now_us() - start;
+
+	run->arena = arena_peak(sess);
+	run->heap = tee_stub_heap_peak();
+	run->calls = fwu_equiv_storage.calls;
+	run->written = fwu_equiv_storage.written;
+	run->erased = fwu_equiv_storage.erased;
+	run->overwritten = fwu_equiv_storage.overwritten;
+	sha256(fwu_equiv_storage.image, fwu_equiv_storage.size, run->image);
+
+	free(input);
+	free(work);
+}
+
+static void save_image(const char *path)
+{
+	FILE *fp = fopen(path, "wb");
+
+	if ((NULL == fp) ||
+		(1 != fwrite(fwu_equiv_storage.image, fwu_equiv_storage.size, 1, fp)) ||
+		(0 != fclose(fp)))
+		err(2, "%s", path);
+}
+
+/*
+ * Run the update in a child process, so that every run starts from the
+ * same TA state (the A/B slot, the statistics, the arena high-water mark).
+ * The first run saves the storage log and image.
+ */
+static void run_child(void *sess, const uint8_t *pkg, uint32_t size, const struct equiv_plan *plan,
+					  const char *log, const char *image, struct equiv_run *run)
+{
+	int fd[2];
+	int status;
+	pid_t pid;
+
+	if (0 != pipe(fd))
+		err(2, "pipe");
+
+	(void)fflush(NULL);
+	pid = fork();
+	if (0 > pid)
+		err(2, "fork");
+
+	if (0 == pid)
+	{
+		(void)close(fd[0]);
+		if (NULL != log)
+		{
+			fwu_equiv_storage.log = fopen(log, "w");
+			if (NULL == fwu_equiv_storage.log)
+				err(2, "%s", log);
+		}
+
+		firmware_update(sess, pkg, size, plan, run);
+
+		if ((NULL != fwu_equiv_storage.log) && (0 != fclose(fwu_equiv_storage.log)))
+			err(2, "%s", log);
+		if (NULL != image)
+			save_image(image);
+		if (sizeof(*run) != write(fd[1], run, sizeof(*run)))
+			err(2, "write");
+		_exit(0);
+	}
+
+	(void)close(fd[1]);
+	if (sizeof(*run) != read(fd[0], run, sizeof(*run)))
+		errx(2, "The run has been aborted");
+	(void)close(fd[0]);
+
+	if ((pid != waitpid(pid, &status, 0)) || (!WIFEXITED(status)) || (0 != WEXITSTATUS(status)))
+		errx(2, "The run has been aborted");
+}
+
+int main(int argc, char *argv[])
+{
+	struct equiv_plan plan;
+	struct equiv_run run;
+	struct equiv_run first;
+	const char *image = NULL;
+	const char *log = NULL;
+	uint32_t max_transfer = pta_stub_geometry.write_chunk;
+	uint32_t size;
+	uint8_t *pkg;
+	void *sess;
+	int split = 0;
+	int repeat = 1;
+	int opt;
+	int i;
+
+	while (-1 != (opt = getopt(argc, argv, "sr:t:n:o:l:v")))
+	{
+		switch (opt)
+		{
+		case 's':
+			split = 1;
+			break;
+		case 'r':
+			repeat = atoi(optarg);
+			if (1 > repeat)
+				usage();
+			break;
+		case 't':
+			max_transfer = (uint32_t)strtoul(optarg, NULL, 0);
+			if (0 == max_transfer)
+				usage();
+			break;
+		case 'n':
+			if (0 != pta_stub_disable(optarg))
+				usage();
+			break;
+		case 'o':
+			image = optarg;
+			break;
+		case 'l':
+			log = optarg;
+			break;
+		case 'v':
+			tee_stub_trace_level++;
+			break;
+		default:
+			usage();
+		}
+	}
+
+	if ((optind + 1) != argc)
+		usage();
+
+	pkg = read_package(argv[optind], &size);
+	if (0 != fwu_equiv_storage_init(EQUIV_STORAGE_SIZE, max_transfer))
+		err(2, "malloc");
+
+	if ((TEE_SUCCESS != TA_CreateEntryPoint()) ||
+		(TEE_SUCCESS != TA_OpenSessionEntryPoint(0, NULL, &sess)))
+		errx(2, "Can not open a TA session");
+
+	(void)memset(&plan, 0, sizeof(plan));
+	(void)memset(&first, 0, sizeof(first));
+	calc_work_size(sess, pkg, size, &plan);
+	plan.inplace = (!split) && (plan.inplace_size >= size);
+
+	if (TEE_SUCCESS != plan.res)
+	{
+		/* Nothing is written, the result is the one of FWU_CMD_CALC_WORK_SIZE. */
+		first.res = plan.res;
+		first.heap = tee_stub_heap_peak();
+		sha256(fwu_equiv_storage.image, fwu_equiv_storage.size, first.image);
+		if (NULL != image)
+			save_image(image);
+		if (NULL != log)
+		{
+			FILE *fp = fopen(log, "w");
+
+			if ((NULL == fp) || (0 != fclose(fp)))
+				err(2, "%s", log);
+		}
+	}
+
+	for (i = 0; (TEE_SUCCESS == plan.res) && (i < repeat); i++)
+	{
+		(void)memset(&run, 0, sizeof(run));
+		run_child(sess, pkg, size, &plan, (0 == i) ? log : NULL, (0 == i) ? image : NULL, &run);
+
+		if (0 == i)
+		{
+			first = run;
+		}
+		else
+		{
+			/* The runs must not depend on each other. */
+			if ((first.res != run.res) || (0 != memcmp(first.image, run.image, sizeof(first.image))))
+				errx(3, "run %d wrote another image than the first run", i + 1);
+			if (first.time_us > run.time_us)
+				first.time_us = run.time_us;
+		}
+	}
+
+	TA_CloseSessionEntryPoint(sess);
+	TA_DestroyEntryPoint();
+
+	(void)printf("res=0x%08x input=%u work=%u inplace=%u mode=%s time_us=%llu arena=%u heap=%zu "
+				 "calls=%u written=%llu erased=%llu overwritten=%llu image=",
+				 first.res, size, plan.work_size, plan.inplace_size, plan.inplace ? "inplace" : "split",
+				 (unsigned long long)first.time_us, first.arena, first.heap, first.calls,
+				 (unsigned long long)first.written, (unsigned long long)first.erased,
+				 (unsigned long long)first.overwritten);
+	for (i = 0; i < SHA256_DIGEST_SIZE; i++)
+		(void)printf("%02x", first.image[i]);
+	(void)printf("\n");
+
+	free(pkg);
+
+	return (TEE_SUCCESS == first.res) ? 0 : 1;
+}
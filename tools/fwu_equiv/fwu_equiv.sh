@@ -0,0 +1,168 @@
+#!/bin/sh
+#
+# Copyright (c) 2021, Renesas Electronics Corporation. All rights reserved.
+#
+# SPDX-License-Identifier: BSD-3-Clause
+#
+# fwu_equiv.sh - compare the storage written by FWU_CMD_FIRMWARE_UPDATE of
+# the TA sources of BASE_REF (base) and of the working tree (cand)
+#
+# usage: fwu_equiv.sh [-b BASE_REF] [-r REPEAT] [-n FEATURE]... [-s] [-G] [PACKAGE|DIRECTORY]...
+#
+#   -b  git ref of the base TA sources (7b54023, the baseline)
+#   -r  runs per package and build, the time is the fastest run (3)
+#   -n  PTA command missing in the stand-ins, see fwu_equiv -n
+#   -s  separate input and work buffers instead of the in-place update
+#   -G  no generated packages, only the given ones
+#
+# The packages are the given ones (*.pkg and *.bin files of a directory)
+# and the packages generated with fwu_pack under $O/corpus. For each
+# package the storage images of both builds are compared byte by byte,
+# with the result code of the update. The speedup is base time / cand time,
+# the memory columns are the cand - base difference of the work buffer and
+# of the arena and heap high-water marks. The exit status is 1 if a
+# package gives another result or image.
+#
+# The TA options (FWU_BOARD, FWU_STORAGE, FWU_AB, FWU_DIGEST_SPOT,
+# FWU_STRICT_COMPONENTS) are taken from the environment, as for make in ta/.
+
+set -e
+
+cd "$(dirname "$0")"
+O=${O:-out}
+BASE_REF=7b54023
+REPEAT=3
+RUN_OPTS=
+GENERATE=1
+
+usage()
+{
+	sed -n 's/^# usage: /usage: /p' "$0" >&2
+	exit 2
+}
+
+while getopts b:r:n:sG opt; do
+	case $opt in
+	b) BASE_REF=$OPTARG ;;
+	r) REPEAT=$OPTARG ;;
+	n) RUN_OPTS="$RUN_OPTS -n $OPTARG" ;;
+	s) RUN_OPTS="$RUN_OPTS -s" ;;
+	G) GENERATE=0 ;;
+	*) usage ;;
+	esac
+done
+shift $((OPTIND - 1))
+
+make -s O="$O" BASE_REF="$BASE_REF"
+
+# Generated packages: keyring, boot firmware with a component larger than
+# a TSIP piece and NS-BL2U FIPs, plain FIPs, with and without a package
+# directory (packed or aligned), and a truncated package that both builds
+# must reject.
+generate()
+{
+	dir=$O/corpus
+	src=$dir/src
+	pack=$O/fwu_pack
+
+	rm -rf "$dir"
+	mkdir -p "$src"
+	for comp in bl2:40000 bl31:100000 bl32:600000 bl33:2500000 keyring:688 ns-bl2u:70000 cert:1500; do
+		head -c "${comp#*:}" /dev/urandom > "$src/${comp%:*}"
+	done
+
+	exec 3>&1 1>/dev/null
+	$pack -t keyring -o "$src/keyring.fip" keyring="$src/keyring"
+	$pack -t bootfw -o "$src/bootfw.fip" bl2="$src/bl2" bl31="$src/bl31" bl32="$src/bl32" bl33="$src/bl33"
+	$pack -t nsbl2u -e -o "$src/nsbl2u.fip" ns-bl2u="$src/ns-bl2u"
+	$pack -t plain -e -o "$dir/plain.pkg" bl2="$src/bl2" bl31="$src/bl31" bl33="$src/bl33" tb-fw-cert="$src/cert"
+	$pack -t plain -a 65536 -e -o "$src/plain-crc.fip" bl2="$src/bl2" bl32="$src/bl32" bl33="$src/bl33"
+	$pack -c -o "$dir/plain-crc.pkg" "$src/plain-crc.fip"
+
+	cat "$src/keyring.fip" "$src/bootfw.fip" "$src/nsbl2u.fip" > "$dir/boot.pkg"
+	$pack -o "$dir/boot-dir.pkg" "$dir/boot.pkg"
+	$pack -a 4096 -o "$dir/boot-aligned.pkg" "$dir/boot.pkg"
+	$pack -g 65536 -o "$dir/boot-seg.pkg" "$dir/boot.pkg"
+	head -c 1000000 "$dir/boot.pkg" > "$dir/truncated.pkg"
+	exec 1>&3 3>&-
+}
+
+# Value of key in a result line of fwu_equiv
+field()
+{
+	echo "$1" | sed -n "s/.* $2=\([^ ]*\).*/\1/p; s/^$2=\([^ ]*\).*/\1/p"
+}
+
+PACKAGES=
+if [ 1 = "$GENERATE" ]; then
+	generate
+	PACKAGES=$(ls "$O"/corpus/*.pkg)
+fi
+for arg in "$@"; do
+	if [ -d "$arg" ]; then
+		PACKAGES="$PACKAGES $(ls "$arg"/*.pkg "$arg"/*.bin 2>/dev/null || true)"
+	else
+		PACKAGES="$PACKAGES $arg"
+	fi
+done
+[ -n "$PACKAGES" ] || usage
+
+mkdir -p "$O/run"
+status=0
+printf '%-24s %10s %10s %10s %8s %10s %10s  %s\n' package input base_us cand_us speedup work_diff peak_diff result
+for pkg in $PACKAGES; do
+	# The runs of both builds alternate, so that both see the same load.
+	round=1
+	while [ "$round" -le "$REPEAT" ]; do
+		for build in base cand; do
+			out="-o $O/run/$build.img -l $O/run/$build.log"
+			[ 1 = "$round" ] || out=
+			set +e
+			line=$("$O/$build/fwu_equiv" $RUN_OPTS $out "$pkg")
+			rc=$?
+			set -e
+			[ 1 -ge $rc ] || { echo "$pkg: $build failed ($rc)" >&2; exit 2; }
+			if [ 1 = "$round" ]; then
+				eval "${build}_line=\$line"
+			else
+				eval "best=\$${build}_line"
+				if [ "$(field "$line" image)" != "$(field "$best" image)" ]; then
+					echo "$pkg: $build wrote another image in run $round" >&2
+					exit 2
+				fi
+				if [ "$(field "$line" time_us)" -lt "$(field "$best" time_us)" ]; then
+					eval "${build}_line=\$line"
+				fi
+			fi
+		done
+		round=$((round + 1))
+	done
+
+	result=SAME
+	if [ "$(field "$base_line" res)" != "$(field "$cand_line" res)" ]; then
+		result="DIFF result $(field "$base_line" res) -> $(field "$cand_line" res)"
+	elif ! diff=$(cmp "$O/run/base.img" "$O/run/cand.img" 2>&1); then
+		byte=$(echo "$diff" | sed -n 's/.* differ: [a-z]* \([0-9]*\).*/\1/p')
+		result=$(printf 'DIFF image at 0x%08x' $((byte - 1)))
+	elif [ 0x00000000 != "$(field "$cand_line" res)" ]; then
+		result="SAME (both $(field "$cand_line" res))"
+	fi
+	case $result in
+	DIFF*)
+		status=1
+		cp "$O/run/base.log" "$O/run/$(basename "$pkg").base.log"
+		cp "$O/run/cand.log" "$O/run/$(basename "$pkg").cand.log"
+		;;
+	esac
+
+	base_us=$(field "$base_line" time_us)
+	cand_us=$(field "$cand_line" time_us)
+	work_diff=$(($(field "$cand_line" work) - $(field "$base_line" work)))
+	peak_diff=$(($(field "$cand_line" arena) + $(field "$cand_line" heap) - $(field "$base_line" arena) - $(field "$base_line" heap)))
+	speedup=$(awk "BEGIN { printf \"%.2f\", ($cand_us > 0) ? $base_us / $cand_us : 0 }")
+	printf '%-24s %10s %10s %10s %8s %10s %10s  %s\n' "$(basename "$pkg")" "$(field "$cand_line" input)" \
+		"$base_us" "$cand_us" "$speedup" "$work_diff" "$peak_diff" "$result"
+done
+
+rm -f "$O/run/base.img" "$O/run/cand.img"
+exit $status
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * fwu_equiv - host harness of the TA sources: stand-ins of the TEE Internal
+ * Core API (tee_stub.c), of the flash and TSIP PTAs (pta_stub.c), and the
+ * driver (fwu_equiv.c)
+ */
+
+#ifndef FWU_EQUIV_H
+#define FWU_EQUIV_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <tee_internal_api.h>
+
+/* Stand-in of a pseudo TA */
+struct pta_stub
+{
+	TEE_UUID uuid;
+	const char *name;
+	TEE_Result (*invoke)(uint32_t cmd, uint32_t type, TEE_Param p[TEE_NUM_PARAMS]);
+	void (*close)(void);
+};
+
+const struct pta_stub *pta_stub_find(const TEE_UUID *uuid);
+
+/*
+ * Flash geometry of the stand-in flash PTA. The stand-ins are built once for
+ * both builds, so the driver takes the geometry from here and not from the
+ * TA sources, which may predate the board profiles.
+ */
+struct pta_stub_geometry
+{
+	uint32_t spi_offset;    /* Staging area of the package */
+	uint32_t spi_end;
+	uint32_t page_size;
+	uint32_t erase_size;
+	uint32_t write_chunk;   /* Default maximum transfer of FLASH_CMD_GET_INFO */
+};
+
+extern const struct pta_stub_geometry pta_stub_geometry;
+
+/*
+ * Optional PTA commands, disabled with fwu_equiv -n NAME to run the fallback
+ * of the TA: info, erase-range, program, read, vec or chunked
+ */
+int pta_stub_disable(const char *name);
+
+/*
+ * Storage of the update package: the whole SPI flash, or the staging object
+ * of the file backend
+ */
+struct fwu_equiv_storage
+{
+	uint8_t *image;
+	uint32_t size;
+	uint32_t max_transfer;  /* Reported by FLASH_CMD_GET_INFO */
+	FILE *log;              /* One line per access, or NULL */
+	uint32_t calls;         /* Write, erase and read accesses */
+	uint64_t written;       /* Programmed bytes */
+	uint64_t erased;        /* Erased bytes */
+	uint64_t overwritten;   /* Bytes programmed without an erase before */
+};
+
+extern struct fwu_equiv_storage fwu_equiv_storage;
+
+int fwu_equiv_storage_init(uint32_t size, uint32_t max_transfer);
+void fwu_equiv_storage_reset(void);
+void fwu_equiv_storage_program(uint32_t offset, const uint8_t *data, uint32_t size);
+void fwu_equiv_storage_erase(uint32_t offset, uint32_t size);
+void fwu_equiv_storage_log(const char *op, uint32_t offset, const void *data, uint32_t size);
+
+/* Host TEE state */
+extern int tee_stub_trace_level;
+
+void tee_stub_reset(void);
+size_t tee_stub_heap_peak(void);
+
+#endif /* FWU_EQUIV_H */
@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Host stand-in of the TEE Internal Core API used by the TA sources, for
+ * tools/fwu_equiv only (tee_stub.c)
+ */
+
+#ifndef TEE_INTERNAL_API_H
+#define TEE_INTERNAL_API_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef uint32_t TEE_Result;
+
+typedef struct
+{
+	uint32_t timeLow;
+	uint16_t timeMid;
+	uint16_t timeHiAndVersion;
+	uint8_t clockSeqAndNode[8];
+} TEE_UUID;
+
+typedef union
+{
+	struct
+	{
+		void *buffer;
+		size_t size;
+	} memref;
+	struct
+	{
+		uint32_t a;
+		uint32_t b;
+	} value;
+} TEE_Param;
+
+typedef struct
+{
+	uint32_t seconds;
+	uint32_t millis;
+} TEE_Time;
+
+typedef struct tee_stub_session *TEE_TASessionHandle;
+typedef struct tee_stub_operation *TEE_OperationHandle;
+typedef struct tee_stub_object *TEE_ObjectHandle;
+
+#define TEE_NUM_PARAMS 4
+#define TEE_HANDLE_NULL NULL
+
+#define TEE_SUCCESS 0x00000000
+#define TEE_ERROR_GENERIC 0xFFFF0000
+#define TEE_ERROR_ACCESS_DENIED 0xFFFF0001
+#define TEE_ERROR_CANCEL 0xFFFF0002
+#define TEE_ERROR_BAD_FORMAT 0xFFFF0005
+#define TEE_ERROR_BAD_PARAMETERS 0xFFFF0006
+#define TEE_ERROR_BAD_STATE 0xFFFF0007
+#define TEE_ERROR_ITEM_NOT_FOUND 0xFFFF0008
+#define TEE_ERROR_NOT_IMPLEMENTED 0xFFFF0009
+#define TEE_ERROR_NOT_SUPPORTED 0xFFFF000A
+#define TEE_ERROR_OUT_OF_MEMORY 0xFFFF000C
+#define TEE_ERROR_BUSY 0xFFFF000D
+#define TEE_ERROR_SECURITY 0xFFFF000F
+#define TEE_ERROR_SHORT_BUFFER 0xFFFF0010
+#define TEE_ERROR_STORAGE_NO_SPACE 0xFFFF3041
+
+#define TEE_PARAM_TYPE_NONE 0
+#define TEE_PARAM_TYPE_VALUE_INPUT 1
+#define TEE_PARAM_TYPE_VALUE_OUTPUT 2
+#define TEE_PARAM_TYPE_VALUE_INOUT 3
+#define TEE_PARAM_TYPE_MEMREF_INPUT 5
+#define TEE_PARAM_TYPE_MEMREF_OUTPUT 6
+#define TEE_PARAM_TYPE_MEMREF_INOUT 7
+
+#define TEE_PARAM_TYPES(t0, t1, t2, t3) \
+	((t0) | ((t1) << 4) | ((t2) << 8) | ((t3) << 12))
+#define TEE_PARAM_TYPE_GET(t, i) ((((uint32_t)(t)) >> ((i) * 4)) & 0xF)
+
+#define TEE_ALG_SHA256 0x50000004
+#define TEE_MODE_DIGEST 5
+
+#define TEE_STORAGE_PRIVATE 0x00000001
+#define TEE_STORAGE_PRIVATE_REE 0x80000000
+#define TEE_STORAGE_PRIVATE_RPMB 0x80000100
+
+#define TEE_DATA_FLAG_ACCESS_READ 0x00000001
+#define TEE_DATA_FLAG_ACCESS_WRITE 0x00000002
+#define TEE_DATA_FLAG_ACCESS_WRITE_META 0x00000004
+#define TEE_DATA_FLAG_OVERWRITE 0x00000400
+#define TEE_DATA_SEEK_SET 0
+
+#define TEE_MALLOC_FILL_ZERO 0x00000000
+#define TEE_MALLOC_NO_FILL 0x00000001
+
+#define TA_FLAG_SINGLE_INSTANCE (1 << 2)
+#define TA_FLAG_MULTI_SESSION (1 << 3)
+#define TA_FLAG_INSTANCE_KEEP_ALIVE (1 << 4)
+#define TA_FLAG_EXEC_DDR 0
+
+#define __unused __attribute__((unused))
+#define __maybe_unused __attribute__((unused))
+
+#define COMPILE_TIME_ASSERT(x) _Static_assert(x, #x)
+
+/* Trace of the TA to stderr, the level is set with fwu_equiv -v */
+void tee_stub_trace(int level, const char *func, int line, const char *fmt, ...)
+	__attribute__((format(printf, 4, 5)));
+
+#define EMSG(...) tee_stub_trace(1, __func__, __LINE__, __VA_ARGS__)
+#define IMSG(...) tee_stub_trace(2, __func__, __LINE__, __VA_ARGS__)
+#define DMSG(...) tee_stub_trace(3, __func__, __LINE__, __VA_ARGS__)
+#define FMSG(...) tee_stub_trace(4, __func__, __LINE__, __VA_ARGS__)
+
+TEE_Result TEE_OpenTASession(const TEE_UUID *destination, uint32_t cancellationRequestTimeout,
+							 uint32_t paramTypes, TEE_Param params[TEE_NUM_PARAMS],
+							 TEE_TASessionHandle *session, uint32_t *returnOrigin);
+void TEE_CloseTASession(TEE_TASessionHandle session);
+TEE_Result TEE_InvokeTACommand(TEE_TASessionHandle session, uint32_t cancellationRequestTimeout,
+							   uint32_t commandID, uint32_t paramTypes,
+							   TEE_Param params[TEE_NUM_PARAMS], uint32_t *returnOrigin);
+
+void *TEE_Malloc(size_t size, uint32_t hint);
+void TEE_Free(void *buffer);
+void *TEE_MemMove(void *dest, const void *src, size_t size);
+
+void TEE_GetSystemTime(TEE_Time *time);
+bool TEE_GetCancellationFlag(void);
+bool TEE_UnmaskCancellation(void);
+bool TEE_MaskCancellation(void);
+void TEE_GenerateRandom(void *randomBuffer, size_t randomBufferLen);
+
+TEE_Result TEE_AllocateOperation(TEE_OperationHandle *operation, uint32_t algorithm,
+								 uint32_t mode, uint32_t maxKeySize);
+void TEE_FreeOperation(TEE_OperationHandle operation);
+void TEE_ResetOperation(TEE_OperationHandle operation);
+void TEE_DigestUpdate(TEE_OperationHandle operation, const void *chunk, size_t chunkSize);
+TEE_Result TEE_DigestDoFinal(TEE_OperationHandle operation, const void *chunk, size_t chunkLen,
+							 void *hash, size_t *hashLen);
+
+TEE_Result TEE_CreatePersistentObject(uint32_t storageID, const void *objectID, size_t objectIDLen,
+									  uint32_t flags, TEE_ObjectHandle attributes,
+									  const void *initialData, size_t initialDataLen,
+									  TEE_ObjectHandle *object);
+TEE_Result TEE_OpenPersistentObject(uint32_t storageID, const void *objectID, size_t objectIDLen,
+									uint32_t flags, TEE_ObjectHandle *object);
+TEE_Result TEE_WriteObjectData(TEE_ObjectHandle object, const void *buffer, size_t size);
+TEE_Result TEE_SeekObjectData(TEE_ObjectHandle object, int32_t offset, int whence);
+void TEE_CloseObject(TEE_ObjectHandle object);
+
+/* Entry points of the TA */
+TEE_Result TA_CreateEntryPoint(void);
+void TA_DestroyEntryPoint(void);
+TEE_Result TA_OpenSessionEntryPoint(uint32_t paramTypes, TEE_Param params[TEE_NUM_PARAMS],
+									void **sessionContext);
+void TA_CloseSessionEntryPoint(void *sessionContext);
+TEE_Result TA_InvokeCommandEntryPoint(void *sessionContext, uint32_t commandID,
+									  uint32_t paramTypes, TEE_Param params[TEE_NUM_PARAMS]);
+
+#endif /* TEE_INTERNAL_API_H */
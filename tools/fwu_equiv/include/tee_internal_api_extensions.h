@@ -0,0 +1,8 @@
+/* Host stand-in for tools/fwu_equiv, see tee_internal_api.h */
+
+#ifndef TEE_INTERNAL_API_EXTENSIONS_H
+#define TEE_INTERNAL_API_EXTENSIONS_H
+
+#include <tee_internal_api.h>
+
+#endif /* TEE_INTERNAL_API_EXTENSIONS_H */
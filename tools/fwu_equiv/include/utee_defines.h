@@ -0,0 +1,8 @@
+/* Host stand-in for tools/fwu_equiv, see tee_internal_api.h */
+
+#ifndef UTEE_DEFINES_H
+#define UTEE_DEFINES_H
+
+#include <tee_internal_api.h>
+
+#endif /* UTEE_DEFINES_H */
@@ -0,0 +1,586 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Stand-ins of the flash and TSIP PTAs
+ *
+ * The flash PTA keeps the whole SPI flash in memory with NOR semantics:
+ * an erase sets the sectors to 0xFF and a program can only clear bits.
+ * FLASH_CMD_WRITE_SPI erases the sectors it covers before it programs them.
+ * Every access is appended to the storage log.
+ *
+ * The TSIP PTA does not encrypt anything. It derives the output of a data
+ * from its index and input with a keystream and a SHA-256 based MAC, with
+ * the layout of the real TSIP output: boot header (first data only), data,
+ * MAC. The one-shot and the chunked commands give the same output, so that
+ * the output written to flash only depends on what the TA passes to TSIP.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <flash_pta.h>
+#include <fwu_layout.h>
+#include <sha256.h>
+#include <tsip_pta.h>
+
+#include "fwu_equiv.h"
+
+/* Without the board profiles, the SPI window and sectors of the first TA sources */
+#if __has_include(<fwu_board.h>)
+#include <fwu_board.h>
+#else
+#define FWU_BOARD_SPI_PACKAGE_OFFSET (0x3000000)
+#define FWU_BOARD_SPI_END_OFFSET (0x4000000)
+#define FWU_BOARD_SPI_PAGE_SIZE (0x100)
+#define FWU_BOARD_SPI_ERASE_SIZE (0x10000)
+#define FWU_BOARD_WRITE_CHUNK_SIZE (0x40000)
+#endif
+
+const struct pta_stub_geometry pta_stub_geometry = {
+	.spi_offset = FWU_BOARD_SPI_PACKAGE_OFFSET,
+	.spi_end = FWU_BOARD_SPI_END_OFFSET,
+	.page_size = FWU_BOARD_SPI_PAGE_SIZE,
+	.erase_size = FWU_BOARD_SPI_ERASE_SIZE,
+	.write_chunk = FWU_BOARD_WRITE_CHUNK_SIZE,
+};
+
+/* Optional commands */
+struct pta_stub_feature
+{
+	const char *name;
+	const char *pta;
+	uint32_t cmd;
+	int disabled;
+};
+
+static struct pta_stub_feature pta_stub_features[] = {
+	{ "info", "flash", FLASH_CMD_GET_INFO, 0 },
+	{ "erase-range", "flash", FLASH_CMD_ERASE_RANGE, 0 },
+	{ "program", "flash", FLASH_CMD_PROGRAM_SPI, 0 },
+	{ "read", "flash", FLASH_CMD_READ_SPI, 0 },
+	{ "vec", "flash", FLASH_CMD_WRITE_SPI_VEC, 0 },
+	{ "chunked", "tsip", TSIP_CMD_UPDATE_FIRMWARE_INIT, 0 },
+	{ "chunked", "tsip", TSIP_CMD_UPDATE_FIRMWARE_UPDATE, 0 },
+	{ "chunked", "tsip", TSIP_CMD_UPDATE_FIRMWARE_FINAL, 0 },
+};
+
+#define PTA_STUB_FEATURES (sizeof(pta_stub_features) / sizeof(pta_stub_features[0]))
+
+struct fwu_equiv_storage fwu_equiv_storage;
+
+/* The TA has read the maximum transfer with FLASH_CMD_GET_INFO */
+static int flash_info_read;
+
+int pta_stub_disable(const char *name)
+{
+	size_t i;
+	int found = 0;
+
+	for (i = 0; i < PTA_STUB_FEATURES; i++)
+	{
+		if (0 == strcmp(pta_stub_features[i].name, name))
+		{
+			pta_stub_features[i].disabled = 1;
+			found = 1;
+		}
+	}
+
+	return found ? 0 : -1;
+}
+
+static int pta_stub_disabled(const char *pta, uint32_t cmd)
+{
+	size_t i;
+
+	for (i = 0; i < PTA_STUB_FEATURES; i++)
+	{
+		if ((cmd == pta_stub_features[i].cmd) && (0 == strcmp(pta_stub_features[i].pta, pta)))
+			return pta_stub_features[i].disabled;
+	}
+
+	return 0;
+}
+
+/******************************************************************************/
+/* Storage                                                                    */
+/******************************************************************************/
+void fwu_equiv_storage_reset(void)
+{
+	(void)memset(fwu_equiv_storage.image, 0xFF, fwu_equiv_storage.size);
+	fwu_equiv_storage.calls = 0;
+	fwu_equiv_storage.written = 0;
+	fwu_equiv_storage.erased = 0;
+	fwu_equiv_storage.overwritten = 0;
+}
+
+int fwu_equiv_storage_init(uint32_t size, uint32_t max_transfer)
+{
+	fwu_equiv_storage.image = malloc(size);
+	if (NULL == fwu_equiv_storage.image)
+		return -1;
+
+	fwu_equiv_storage.size = size;
+	fwu_equiv_storage.max_transfer = max_transfer;
+	fwu_equiv_storage_reset();
+
+	return 0;
+}
+
+void fwu_equiv_storage_program(uint32_t offset, const uint8_t *data, uint32_t size)
+{
+	uint8_t *dst = fwu_equiv_storage.image + offset;
+	uint32_t i;
+
+	for (i = 0; i < size; i++)
+	{
+		if (0xFF != dst[i])
+			fwu_equiv_storage.overwritten++;
+		dst[i] &= data[i];
+	}
+
+	fwu_equiv_storage.written += size;
+}
+
+void fwu_equiv_storage_erase(uint32_t offset, uint32_t size)
+{
+	(void)memset(fwu_equiv_storage.image + offset, 0xFF, size);
+	fwu_equiv_storage.erased += size;
+}
+
+void fwu_equiv_storage_log(const char *op, uint32_t offset, const void *data, uint32_t size)
+{
+	uint8_t digest[SHA256_DIGEST_SIZE];
+	int i;
+
+	fwu_equiv_storage.calls++;
+	if (NULL == fwu_equiv_storage.log)
+		return;
+
+	(void)fprintf(fwu_equiv_storage.log, "%s 0x%08x 0x%08x", op, offset, size);
+	if (NULL != data)
+	{
+		sha256(data, size, digest);
+		(void)fputc(' ', fwu_equiv_storage.log);
+		for (i = 0; i < 8; i++)
+			(void)fprintf(fwu_equiv_storage.log, "%02x", digest[i]);
+	}
+	(void)fputc('\n', fwu_equiv_storage.log);
+}
+
+/******************************************************************************/
+/* Flash PTA                                                                  */
+/******************************************************************************/
+static int flash_range_ok(uint32_t offset, size_t size)
+{
+	return (offset <= fwu_equiv_storage.size) && (size <= (fwu_equiv_storage.size - offset));
+}
+
+static int flash_transfer_ok(size_t size)
+{
+	/*
+	 * Without FLASH_CMD_GET_INFO the TA has no limit to follow, as the TA
+	 * sources before the command that write the package in one call.
+	 */
+	if (pta_stub_disabled("flash", FLASH_CMD_GET_INFO) || (!flash_info_read))
+		return 1;
+
+	return size <= fwu_equiv_storage.max_transfer;
+}
+
+/* Erase the sectors of [offset, offset + size) */
+static void flash_erase_sectors(uint32_t offset, uint32_t size)
+{
+	uint32_t top = offset - (offset % FWU_BOARD_SPI_ERASE_SIZE);
+	uint32_t end = offset + size;
+
+	end += (FWU_BOARD_SPI_ERASE_SIZE - (end % FWU_BOARD_SPI_ERASE_SIZE)) % FWU_BOARD_SPI_ERASE_SIZE;
+	if (end > fwu_equiv_storage.size)
+		end = fwu_equiv_storage.size;
+
+	fwu_equiv_storage_erase(top, end - top);
+}
+
+static TEE_Result flash_write(uint32_t type, TEE_Param p[TEE_NUM_PARAMS], int erase)
+{
+	if ((TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT, TEE_PARAM_TYPE_MEMREF_INPUT,
+						 TEE_PARAM_TYPE_NONE, TEE_PARAM_TYPE_NONE) != type) ||
+		(0 == p[1].memref.size) || (!flash_range_ok(p[0].value.a, p[1].memref.size)) ||
+		(!flash_transfer_ok(p[1].memref.size)))
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	fwu_equiv_storage_log(erase ? "write" : "program", p[0].value.a, p[1].memref.buffer, p[1].memref.size);
+	if (erase)
+		flash_erase_sectors(p[0].value.a, p[1].memref.size);
+	fwu_equiv_storage_program(p[0].value.a, p[1].memref.buffer, p[1].memref.size);
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result flash_erase_range(uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
+{
+	if ((TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT, TEE_PARAM_TYPE_NONE,
+						 TEE_PARAM_TYPE_NONE, TEE_PARAM_TYPE_NONE) != type) ||
+		(0 != (p[0].value.a % FWU_BOARD_SPI_ERASE_SIZE)) ||
+		(0 != (p[0].value.b % FWU_BOARD_SPI_ERASE_SIZE)) ||
+		(!flash_range_ok(p[0].value.a, p[0].value.b)))
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	fwu_equiv_storage_log("erase", p[0].value.a, NULL, p[0].value.b);
+	fwu_equiv_storage_erase(p[0].value.a, p[0].value.b);
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result flash_read(uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
+{
+	if ((TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT, TEE_PARAM_TYPE_MEMREF_OUTPUT,
+						 TEE_PARAM_TYPE_NONE, TEE_PARAM_TYPE_NONE) != type) ||
+		(!flash_range_ok(p[0].value.a, p[1].memref.size)))
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	fwu_equiv_storage_log("read", p[0].value.a, NULL, p[1].memref.size);
+	(void)memcpy(p[1].memref.buffer, fwu_equiv_storage.image + p[0].value.a, p[1].memref.size);
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result flash_write_vec(uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
+{
+	const struct flash_spi_seg *seg = p[0].memref.buffer;
+	uint32_t count = p[0].memref.size / sizeof(struct flash_spi_seg);
+	uint32_t end = 0;
+	uint64_t total = 0;
+	uint32_t i;
+
+	if ((TEE_PARAM_TYPE_MEMREF_INPUT != TEE_PARAM_TYPE_GET(type, 0)) ||
+		(TEE_PARAM_TYPE_MEMREF_INPUT != TEE_PARAM_TYPE_GET(type, 1)) ||
+		(TEE_PARAM_TYPE_VALUE_INPUT != TEE_PARAM_TYPE_GET(type, 3)) ||
+		(0 == count) || (FLASH_SPI_VEC_MAX < count) ||
+		(0 != (p[0].memref.size % sizeof(struct flash_spi_seg))))
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	/* Sorted, without overlap and inside of their buffer */
+	for (i = 0; i < count; i++)
+	{
+		uint32_t buf = seg[i].buf;
+
+		if ((1 < buf) || ((1 == buf) && (TEE_PARAM_TYPE_MEMREF_INPUT != TEE_PARAM_TYPE_GET(type, 2))) ||
+			(0 == seg[i].size) || (seg[i].offset < end) ||
+			(!flash_range_ok(seg[i].offset, seg[i].size)) ||
+			(seg[i].buf_offset > p[1 + buf].memref.size) ||
+			(seg[i].size > (p[1 + buf].memref.size - seg[i].buf_offset)))
+			return TEE_ERROR_BAD_PARAMETERS;
+
+		end = seg[i].offset + seg[i].size;
+		total += seg[i].size;
+	}
+
+	if (!flash_transfer_ok(total))
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	if (0 == (p[3].value.a & FLASH_SPI_VEC_PROGRAM))
+	{
+		for (i = 0; i < count; i++)
+			flash_erase_sectors(seg[i].offset, seg[i].size);
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		const uint8_t *data = (const uint8_t *)p[1 + seg[i].buf].memref.buffer + seg[i].buf_offset;
+
+		fwu_equiv_storage_log((0 != (p[3].value.a & FLASH_SPI_VEC_PROGRAM)) ? "vec-program" : "vec-write",
+							  seg[i].offset, data, seg[i].size);
+		fwu_equiv_storage_program(seg[i].offset, data, seg[i].size);
+	}
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result flash_invoke(uint32_t cmd, uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
+{
+	if (pta_stub_disabled("flash", cmd))
+		return TEE_ERROR_NOT_IMPLEMENTED;
+
+	switch (cmd)
+	{
+	case FLASH_CMD_WRITE_SPI:
+		return flash_write(type, p, 1);
+	case FLASH_CMD_GET_INFO:
+		if (TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_OUTPUT, TEE_PARAM_TYPE_VALUE_OUTPUT,
+							TEE_PARAM_TYPE_NONE, TEE_PARAM_TYPE_NONE) != type)
+			return TEE_ERROR_BAD_PARAMETERS;
+		p[0].value.a = FWU_BOARD_SPI_PAGE_SIZE;
+		p[0].value.b = FWU_BOARD_SPI_ERASE_SIZE;
+		p[1].value.a = fwu_equiv_storage.max_transfer;
+		p[1].value.b = fwu_equiv_storage.size;
+		flash_info_read = 1;
+		return TEE_SUCCESS;
+	case FLASH_CMD_ERASE_RANGE:
+		return flash_erase_range(type, p);
+	case FLASH_CMD_PROGRAM_SPI:
+		return flash_write(type, p, 0);
+	case FLASH_CMD_READ_SPI:
+		return flash_read(type, p);
+	case FLASH_CMD_WRITE_SPI_VEC:
+		return flash_write_vec(type, p);
+	default:
+		return TEE_ERROR_NOT_IMPLEMENTED;
+	}
+}
+
+/******************************************************************************/
+/* TSIP PTA                                                                   */
+/******************************************************************************/
+#define TSIP_PARAMS_KEYRING TEE_PARAM_TYPES(TEE_PARAM_TYPE_MEMREF_INPUT, TEE_PARAM_TYPE_MEMREF_OUTPUT, \
+											TEE_PARAM_TYPE_NONE, TEE_PARAM_TYPE_NONE)
+#define TSIP_PARAMS_FIRMWARE TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT, TEE_PARAM_TYPE_MEMREF_INPUT, \
+											 TEE_PARAM_TYPE_MEMREF_INOUT, TEE_PARAM_TYPE_NONE)
+#define TSIP_PARAMS_INIT TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT, TEE_PARAM_TYPE_NONE, \
+										 TEE_PARAM_TYPE_MEMREF_OUTPUT, TEE_PARAM_TYPE_NONE)
+#define TSIP_PARAMS_UPDATE TEE_PARAM_TYPES(TEE_PARAM_TYPE_NONE, TEE_PARAM_TYPE_MEMREF_INPUT, \
+										   TEE_PARAM_TYPE_MEMREF_OUTPUT, TEE_PARAM_TYPE_NONE)
+#define TSIP_PARAMS_FINAL TEE_PARAM_TYPES(TEE_PARAM_TYPE_NONE, TEE_PARAM_TYPE_NONE, \
+										  TEE_PARAM_TYPE_MEMREF_OUTPUT, TEE_PARAM_TYPE_NONE)
+
+/* Chunked re-encryption in progress */
+static struct
+{
+	int active;
+	uint32_t index;
+	uint32_t size;          /* Input size of the data */
+	uint32_t pos;           /* Input bytes re-encrypted */
+	struct sha256_ctx mac;
+} tsip_chunk;
+
+static void tsip_header(uint32_t index, uint32_t size, uint8_t *out)
+{
+	uint8_t seed[8];
+	uint8_t digest[SHA256_DIGEST_SIZE];
+	int i;
+
+	for (i = 0; i < 4; i++)
+	{
+		seed[i] = (uint8_t)(index >> (8 * i));
+		seed[4 + i] = (uint8_t)(size >> (8 * i));
+	}
+	sha256(seed, sizeof(seed), digest);
+
+	for (i = 0; i < REENC_BOOT_HEADER; i++)
+		out[i] = digest[i % SHA256_DIGEST_SIZE] ^ (uint8_t)i;
+}
+
+static void tsip_mac_init(struct sha256_ctx *mac, uint32_t index, uint32_t size)
+{
+	uint8_t seed[8];
+	int i;
+
+	for (i = 0; i < 4; i++)
+	{
+		seed[i] = (uint8_t)(index >> (8 * i));
+		seed[4 + i] = (uint8_t)(size >> (8 * i));
+	}
+	sha256_init(mac);
+	sha256_update(mac, seed, sizeof(seed));
+}
+
+/* Re-encrypt size bytes at position pos of data index */
+static void tsip_crypt(uint32_t index, uint32_t pos, const uint8_t *in, uint8_t *out, uint32_t size,
+					   struct sha256_ctx *mac)
+{
+	uint32_t i;
+
+	for (i = 0; i < size; i++)
+		out[i] = in[i] ^ (uint8_t)(((pos + i) * 0x9E3779B1u) >> 24) ^ (uint8_t)index;
+
+	sha256_update(mac, out, size);
+}
+
+static void tsip_mac_final(struct sha256_ctx *mac, uint8_t *out)
+{
+	uint8_t digest[SHA256_DIGEST_SIZE];
+
+	sha256_final(mac, digest);
+	(void)memcpy(out, digest, REENC_MAC_SIZE);
+}
+
+static TEE_Result tsip_keyring(uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
+{
+	const uint8_t *in = p[0].memref.buffer;
+	uint8_t *out = p[1].memref.buffer;
+	uint32_t i;
+
+	if ((TSIP_PARAMS_KEYRING != type) ||
+		(INPUT_KEYRING_SIZE != p[0].memref.size) || (OUTPUT_KEYRING_SIZE > p[1].memref.size))
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	for (i = 0; i < OUTPUT_KEYRING_SIZE; i++)
+		out[i] = in[i % INPUT_KEYRING_SIZE] ^ (uint8_t)((i * 29) + 0xA5);
+	p[1].memref.size = OUTPUT_KEYRING_SIZE;
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result tsip_firmware(uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
+{
+	const update_fw_t *in = p[1].memref.buffer;
+	const update_fw_t *out = p[2].memref.buffer;
+	struct sha256_ctx mac;
+	uint32_t count = p[0].value.a;
+	uint32_t i;
+
+	if ((TSIP_PARAMS_FIRMWARE != type) || (0 == count) || (16 < count) ||
+		((count * sizeof(update_fw_t)) > p[1].memref.size) ||
+		((count * sizeof(update_fw_t)) > p[2].memref.size))
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	for (i = 0; i < count; i++)
+	{
+		uint32_t extra = (0 == i) ? REENC_TSIP_FIRST : REENC_TSIP_NEXT;
+
+		if ((0 != in[i].size) &&
+			((NULL == in[i].data) || (NULL == out[i].data) || ((in[i].size + extra) != out[i].size)))
+			return TEE_ERROR_BAD_PARAMETERS;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		uint8_t *dst = out[i].data;
+
+		if (0 == in[i].size)
+			continue;
+
+		if (0 == i)
+		{
+			tsip_header(i, in[i].size, dst);
+			dst += REENC_BOOT_HEADER;
+		}
+
+		tsip_mac_init(&mac, i, in[i].size);
+		tsip_crypt(i, 0, in[i].data, dst, in[i].size, &mac);
+		tsip_mac_final(&mac, dst + in[i].size);
+	}
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result tsip_firmware_init(uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
+{
+	uint32_t header = (0 == p[0].value.a) ? REENC_BOOT_HEADER : 0;
+
+	if ((TSIP_PARAMS_INIT != type) || (tsip_chunk.active) || (16 <= p[0].value.a) ||
+		(0 == p[0].value.b) || (header > p[2].memref.size))
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	tsip_chunk.active = 1;
+	tsip_chunk.index = p[0].value.a;
+	tsip_chunk.size = p[0].value.b;
+	tsip_chunk.pos = 0;
+	tsip_mac_init(&tsip_chunk.mac, tsip_chunk.index, tsip_chunk.size);
+
+	if (0 != header)
+		tsip_header(tsip_chunk.index, tsip_chunk.size, p[2].memref.buffer);
+	p[2].memref.size = header;
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result tsip_firmware_update(uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
+{
+	uint32_t size = p[1].memref.size;
+
+	/* Pieces of whole AES blocks but the last one */
+	if ((TSIP_PARAMS_UPDATE != type) || (!tsip_chunk.active) || (0 == size) ||
+		(size > (tsip_chunk.size - tsip_chunk.pos)) || (size > p[2].memref.size) ||
+		((0 != (size % 16)) && (size != (tsip_chunk.size - tsip_chunk.pos))))
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	tsip_crypt(tsip_chunk.index, tsip_chunk.pos, p[1].memref.buffer, p[2].memref.buffer, size, &tsip_chunk.mac);
+	tsip_chunk.pos += size;
+	p[2].memref.size = size;
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result tsip_firmware_final(uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
+{
+	if ((TSIP_PARAMS_FINAL != type) || (!tsip_chunk.active) ||
+		(tsip_chunk.pos != tsip_chunk.size) || (REENC_MAC_SIZE > p[2].memref.size))
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	tsip_mac_final(&tsip_chunk.mac, p[2].memref.buffer);
+	tsip_chunk.active = 0;
+	p[2].memref.size = REENC_MAC_SIZE;
+
+	return TEE_SUCCESS;
+}
+
+static TEE_Result tsip_invoke(uint32_t cmd, uint32_t type, TEE_Param p[TEE_NUM_PARAMS])
+{
+	if (pta_stub_disabled("tsip", cmd))
+		return TEE_ERROR_NOT_IMPLEMENTED;
+
+	switch (cmd)
+	{
+	case TSIP_CMD_UPDATE_KEYRING:
+		return tsip_keyring(type, p);
+	case TSIP_CMD_UPDATE_FIRMWARE:
+		return tsip_firmware(type, p);
+	case TSIP_CMD_UPDATE_FIRMWARE_INIT:
+		return tsip_firmware_init(type, p);
+	case TSIP_CMD_UPDATE_FIRMWARE_UPDATE:
+		return tsip_firmware_update(type, p);
+	case TSIP_CMD_UPDATE_FIRMWARE_FINAL:
+		return tsip_firmware_final(type, p);
+	default:
+		return TEE_ERROR_NOT_IMPLEMENTED;
+	}
+}
+
+/* Closing the session discards an unfinished chunked re-encryption. */
+static void tsip_close(void)
+{
+	tsip_chunk.active = 0;
+}
+
+static const struct pta_stub pta_stubs[] = {
+	{ FLASH_UUID, "flash", flash_invoke, NULL },
+	{ TSIP_UUID, "tsip", tsip_invoke, tsip_close },
+};
+
+const struct pta_stub *pta_stub_find(const TEE_UUID *uuid)
+{
+	size_t i;
+
+	for (i = 0; i < (sizeof(pta_stubs) / sizeof(pta_stubs[0])); i++)
+	{
+		if (0 == memcmp(&pta_stubs[i].uuid, uuid, sizeof(TEE_UUID)))
+			return &pta_stubs[i];
+	}
+
+	return NULL;
+}
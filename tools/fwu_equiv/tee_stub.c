@@ -0,0 +1,329 @@
+/*
+ * Copyright (c) 2021, Renesas Electronics Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Stand-in of the TEE Internal Core API used by the TA sources
+ *
+ * TA sessions go to the PTA stand-ins of pta_stub.c, the secure storage
+ * object of the file backend is the storage image, the random
+ * numbers are the same in every run and TEE_Malloc() keeps track of the
+ * heap high-water mark.
+ */
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <sha256.h>
+
+#include "fwu_equiv.h"
+
+struct tee_stub_session
+{
+	const struct pta_stub *pta;
+};
+
+struct tee_stub_operation
+{
+	struct sha256_ctx ctx;
+};
+
+struct tee_stub_object
+{
+	uint32_t pos;
+};
+
+/* Header of a TEE_Malloc() block */
+struct tee_stub_block
+{
+	size_t size;
+	max_align_t align;
+};
+
+int tee_stub_trace_level;
+
+static size_t tee_stub_heap;
+static size_t tee_stub_heap_max;
+static uint64_t tee_stub_random;
+static int tee_stub_object_exists;
+
+void tee_stub_reset(void)
+{
+	tee_stub_heap_max = tee_stub_heap;
+	tee_stub_random = 0x9E3779B97F4A7C15ULL;
+	tee_stub_object_exists = 0;
+}
+
+size_t tee_stub_heap_peak(void)
+{
+	return tee_stub_heap_max;
+}
+
+void tee_stub_trace(int level, const char *func, int line, const char *fmt, ...)
+{
+	va_list ap;
+
+	if (level > tee_stub_trace_level)
+		return;
+
+	(void)fprintf(stderr, "%c/TA: %s:%d ", "-EIDF"[level], func, line);
+	va_start(ap, fmt);
+	(void)vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	if ((0 == *fmt) || ('\n' != fmt[strlen(fmt) - 1]))
+		(void)fputc('\n', stderr);
+}
+
+/******************************************************************************/
+/* TA sessions                                                                */
+/******************************************************************************/
+TEE_Result TEE_OpenTASession(const TEE_UUID *destination, uint32_t cancellationRequestTimeout __unused,
+							 uint32_t paramTypes __unused, TEE_Param params[TEE_NUM_PARAMS] __unused,
+							 TEE_TASessionHandle *session, uint32_t *returnOrigin __unused)
+{
+	const struct pta_stub *pta = pta_stub_find(destination);
+
+	if (NULL == pta)
+		return TEE_ERROR_ITEM_NOT_FOUND;
+
+	*session = malloc(sizeof(struct tee_stub_session));
+	if (NULL == *session)
+		return TEE_ERROR_OUT_OF_MEMORY;
+
+	(*session)->pta = pta;
+
+	return TEE_SUCCESS;
+}
+
+void TEE_CloseTASession(TEE_TASessionHandle session)
+{
+	if (NULL == session)
+		return;
+
+	if (NULL != session->pta->close)
+		session->pta->close();
+	free(session);
+}
+
+TEE_Result TEE_InvokeTACommand(TEE_TASessionHandle session, uint32_t cancellationRequestTimeout __unused,
+							   uint32_t commandID, uint32_t paramTypes,
+							   TEE_Param params[TEE_NUM_PARAMS], uint32_t *returnOrigin __unused)
+{
+	if (NULL == session)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	return session->pta->invoke(commandID, paramTypes, params);
+}
+
+/******************************************************************************/
+/* Memory, time, cancellation and random numbers                              */
+/******************************************************************************/
+void *TEE_Malloc(size_t size, uint32_t hint)
+{
+	struct tee_stub_block *block = malloc(sizeof(struct tee_stub_block) + size);
+
+	if (NULL == block)
+		return NULL;
+
+	if (TEE_MALLOC_NO_FILL != hint)
+		(void)memset(block + 1, 0, size);
+
+	block->size = size;
+	tee_stub_heap += size;
+	if (tee_stub_heap_max < tee_stub_heap)
+		tee_stub_heap_max = tee_stub_heap;
+
+	return block + 1;
+}
+
+void TEE_Free(void *buffer)
+{
+	struct tee_stub_block *block = (struct tee_stub_block *)buffer - 1;
+
+	if (NULL == buffer)
+		return;
+
+	tee_stub_heap -= block->size;
+	free(block);
+}
+
+void *TEE_MemMove(void *dest, const void *src, size_t size)
+{
+	return memmove(dest, src, size);
+}
+
+void TEE_GetSystemTime(TEE_Time *time)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	time->seconds = (uint32_t)ts.tv_sec;
+	time->millis = (uint32_t)(ts.tv_nsec / 1000000);
+}
+
+bool TEE_GetCancellationFlag(void)
+{
+	return false;
+}
+
+bool TEE_UnmaskCancellation(void)
+{
+	return true;
+}
+
+bool TEE_MaskCancellation(void)
+{
+	return false;
+}
+
+/* xorshift64*, reset by tee_stub_reset() so that all runs are the same */
+void TEE_GenerateRandom(void *randomBuffer, size_t randomBufferLen)
+{
+	uint8_t *out = randomBuffer;
+	size_t i;
+
+	for (i = 0; i < randomBufferLen; i++)
+	{
+		tee_stub_random ^= tee_stub_random >> 12;
+		tee_stub_random ^= tee_stub_random << 25;
+		tee_stub_random ^= tee_stub_random >> 27;
+		out[i] = (uint8_t)((tee_stub_random * 0x2545F4914F6CDD1DULL) >> 56);
+	}
+}
+
+/******************************************************************************/
+/* SHA-256                                                                    */
+/******************************************************************************/
+TEE_Result TEE_AllocateOperation(TEE_OperationHandle *operation, uint32_t algorithm,
+								 uint32_t mode, uint32_t maxKeySize __unused)
+{
+	if ((TEE_ALG_SHA256 != algorithm) || (TEE_MODE_DIGEST != mode))
+		return TEE_ERROR_NOT_SUPPORTED;
+
+	*operation = malloc(sizeof(struct tee_stub_operation));
+	if (NULL == *operation)
+		return TEE_ERROR_OUT_OF_MEMORY;
+
+	sha256_init(&(*operation)->ctx);
+
+	return TEE_SUCCESS;
+}
+
+void TEE_FreeOperation(TEE_OperationHandle operation)
+{
+	free(operation);
+}
+
+void TEE_ResetOperation(TEE_OperationHandle operation)
+{
+	sha256_init(&operation->ctx);
+}
+
+void TEE_DigestUpdate(TEE_OperationHandle operation, const void *chunk, size_t chunkSize)
+{
+	sha256_update(&operation->ctx, chunk, chunkSize);
+}
+
+TEE_Result TEE_DigestDoFinal(TEE_OperationHandle operation, const void *chunk, size_t chunkLen,
+							 void *hash, size_t *hashLen)
+{
+	if (SHA256_DIGEST_SIZE > *hashLen)
+		return TEE_ERROR_SHORT_BUFFER;
+
+	sha256_update(&operation->ctx, chunk, chunkLen);
+	sha256_final(&operation->ctx, hash);
+	sha256_init(&operation->ctx);
+	*hashLen = SHA256_DIGEST_SIZE;
+
+	return TEE_SUCCESS;
+}
+
+/******************************************************************************/
+/* Secure storage: a single object, kept in the storage image                 */
+/******************************************************************************/
+static TEE_Result tee_stub_object_new(TEE_ObjectHandle *object)
+{
+	*object = malloc(sizeof(struct tee_stub_object));
+	if (NULL == *object)
+		return TEE_ERROR_OUT_OF_MEMORY;
+
+	(*object)->pos = 0;
+
+	return TEE_SUCCESS;
+}
+
+TEE_Result TEE_CreatePersistentObject(uint32_t storageID __unused, const void *objectID __unused,
+									  size_t objectIDLen __unused, uint32_t flags __unused,
+									  TEE_ObjectHandle attributes __unused,
+									  const void *initialData __unused, size_t initialDataLen __unused,
+									  TEE_ObjectHandle *object)
+{
+	fwu_equiv_storage_log("create", 0, NULL, 0);
+	fwu_equiv_storage_erase(0, fwu_equiv_storage.size);
+	tee_stub_object_exists = 1;
+
+	return tee_stub_object_new(object);
+}
+
+TEE_Result TEE_OpenPersistentObject(uint32_t storageID __unused, const void *objectID __unused,
+									size_t objectIDLen __unused, uint32_t flags __unused,
+									TEE_ObjectHandle *object)
+{
+	if (!tee_stub_object_exists)
+		return TEE_ERROR_ITEM_NOT_FOUND;
+
+	return tee_stub_object_new(object);
+}
+
+TEE_Result TEE_WriteObjectData(TEE_ObjectHandle object, const void *buffer, size_t size)
+{
+	if ((object->pos > fwu_equiv_storage.size) || (size > (fwu_equiv_storage.size - object->pos)))
+		return TEE_ERROR_STORAGE_NO_SPACE;
+
+	fwu_equiv_storage_log("object-write", object->pos, buffer, size);
+	(void)memcpy(fwu_equiv_storage.image + object->pos, buffer, size);
+	fwu_equiv_storage.written += size;
+	object->pos += size;
+
+	return TEE_SUCCESS;
+}
+
+TEE_Result TEE_SeekObjectData(TEE_ObjectHandle object, int32_t offset, int whence)
+{
+	if ((TEE_DATA_SEEK_SET != whence) || (0 > offset))
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	object->pos = (uint32_t)offset;
+
+	return TEE_SUCCESS;
+}
+
+void TEE_CloseObject(TEE_ObjectHandle object)
+{
+	free(object);
+}